@@ -7,7 +7,7 @@ template <class T> int EEPROM_writeStruct(int address, const T& value)
     const byte* p = (const byte*)(const void*)&value;
     unsigned int i;
     for (i = 0; i < sizeof(value); i++)
-		  eeprom_write_byte((unsigned char *)address++, *p++);  
+		  eeprom_write_byte((unsigned char *)(uintptr_t)address++, *p++);  
     return i;
 }
 
@@ -16,6 +16,6 @@ template <class T> int EEPROM_readStruct(int address, T& value)
     byte* p = (byte*)(void*)&value;
     unsigned int i;
     for (i = 0; i < sizeof(value); i++)
-          *p++ = eeprom_read_byte((unsigned char *)address++);
+          *p++ = eeprom_read_byte((unsigned char *)(uintptr_t)address++);
     return i;
 }
@@ -29,6 +29,12 @@
  On the sd card can be a file named config.dat.
  First line is the baudrate of the NMEA A Port,
  Second line is the baudrate of the NMEA B Port
+ Third line are the outputs (1 = vcc, 2 = gyro, 4 = binary data file)
+ Fourth line is the vessel id (hex)
+ Fifth line is the flush interval in seconds (1..250, default 60)
+ Sixth line is the motion rate, samples per second of gyro and acc (4..100, 0 = once a second, default)
+ Seventh line is the attitude rate, roll, pitch and heave (POSMATT) per second, calculated from the motion samples
+ instead of writing them (1..motion rate, 0 = off, default)
 
  If there ist no file, the default value will be used. Which is, both serial are active with
  standart NMEA0183 protokoll (4800, 8N1);
@@ -45,6 +51,39 @@
 
  To Load firmware to OSM Lodder rename hex file to OSMFIRMW.HEX and put it on a FAT16 formatted SD card.
  */
+// WKLA 20261017
+// - hardware independent functions (NMEA checksum) moved to osmfunctions.h
+// - timestamp is advanced incremental, no more sprintf for every line
+// - data file is preallocated and written in complete blocks (block writer)
+// - the block writer stays inside the preallocated size. The rest of the last cluster was written too and
+//   then overwritten by the normal writes after the preallocated file was full.
+// - size of the preallocated file depends on the baudrates, new message with the block write times
+// - flushing the file with sync, no more close/open. Flush interval can be set in the config file (5. line)
+// - a flush of the preallocated file writes the size into the directory entry, after a crash the file ends there.
+//   Only the blocks of the last interval are pre erased again after a flush.
+// - next data file number with one pass over the root directory, no more probing of every filename on startup
+// - with data9999.dat on the card the numbers of deleted files are used again, the lowest first (two more passes)
+// - without a free file number or on a full card the logger blinks the error, no more new file in every pass of the loop
+// - seatalk datagrams are assembled in the serial interrupt, the loop only gets complete datagrams
+// - optional binary data file (outputs bit 4), decoder in Tools/osmdecode
+// - checkNMEAData with length, hex digits of the checksum were parsed wrong
+// - NMEA checksum is checked while receiving, lines with a wrong checksum get a lower case channel marker (a;/b;)
+// - statistic of the serial channels every minute (POSMSTAT)
+// - one receive arena for the serial rings and line buffers, split by the baudrates. 38400 baud on NMEA A works now.
+// - the time of a line is the receive time of its first byte, taken in the serial interrupts, not the time the loop sees it.
+// - high rate motion logging (POSMMOT), the MPU6050 samples into its FIFO, the rate is the sixth line of the config file
+// - the gyro is read asynchronously by the TWI interrupt, the loop doesn't wait for the I2C bus anymore
+// - a gyro transfer running longer than 20 ms resets the TWI, a hung I2C bus doesn't stop the gyro data forever
+// - roll, pitch and heave calculated from the motion samples (POSMATT), the rate is the seventh line of the config file
+// - main loop with a task table (runTasks), the voltage is read without waiting, max. runtime of the tasks (POSMTSK)
+// - supply voltage monitored by the ADC interrupt, the loop only checks the brown out flag
+// - power fail: only the partial block and the size in the directory entry are written, shutdown time (POSMPF)
+// - the next start frees the preallocated rest of the last data file of a power fail or a crash
+// - free cluster count is kept by the volume (FAT32 FSINFO or one scan), no FAT scan on every new file
+// - the search for free clusters starts at a saved hint (FAT32 FSINFO, FAT16 eeprom), not at the start of the card
+// - no waiting for the card at the end of a block, lines and gyro data wait in their buffers until the card is ready
+// - free RAM at the deepest stack every minute (POSMRAM)
+// - the receivers start after the first data file is created, creating the preallocated file overflowed the rings
 // WKLA 20141006 V0.1.15
 // - adding right bootloader constant
 // - some testing with and without NMEA check
@@ -112,6 +151,10 @@
 // checking a NMEA datagram before writing, if ok, channel LED will lite up.
 #define checkNMEA
 
+// define for writing the data file as a preallocated contiguous file with the block writer.
+// Otherwise every cluster of the data file is allocated while logging.
+#define preallocateFile
+
 #ifdef freemem
 #include <MemoryFree.h>
 #endif
@@ -120,6 +163,9 @@
 #include <Wire.h>
 #include <I2Cdev.h>
 #include <MPU6050.h>
+extern "C" {
+#include <utility/twi.h>
+}
 #endif
 
 #include "messages.h"
@@ -133,13 +179,17 @@
 
 #include <EEPROM.h>
 #include "EEPROMStruct.h"
-#include "osmfunctions.c"
+#include "osmfunctions.h"
+#include "blockwriter.h"
 
 #include <avr/pgmspace.h>
 #include <util/crc16.h>
 
 SdFat sd;
+// the data file, written by the block writer (blockwriter.h)
 SdFile dataFile;
+// size of the preallocated file
+unsigned long preallocateSize = PREALLOCATE_MIN_SIZE;
 
 // actual activation state of the channel
 boolean firstSerial = true;
@@ -147,6 +197,7 @@ boolean secondSerial = true;
 boolean seatalkActive = false;
 boolean outputGyro = true;
 boolean outputVcc = false;
+boolean binaryFormat = false;
 
 // Port for NMEA B
 AltSoftSerial mySerial;
@@ -158,10 +209,60 @@ MPU6050 accelgyro (MPU6050_ADDRESS_AD0_LOW);
 #endif
 
 byte indexA, indexB;
+// receive arena, split between the receive rings and the line buffers in initSerials()
+byte rxArena[RX_ARENA_SIZE];
+byte* bufferA;
+byte* bufferB;
+byte lineSizeA, lineSizeB;
+// baudrates of the active channels, the receivers start after the first data file is created (startSerials())
+word rateA = 0;
+word rateB = 0;
+boolean serialsStarted = false;
 
 char filename[13];
-unsigned long lastMillis;
 int normVoltage;
+// supply voltage, exponential moving average of the raw ADC values of the 1.1V reference, scaled by
+// VCC_FILTER_SAMPLES (ADC interrupt). brownOut is set by the interrupt as long as the voltage is below
+// normVoltage (filtered value above brownOutLevel).
+volatile word vccFiltered;
+volatile boolean brownOut = false;
+word brownOutLevel;
+// interval for flushing the data file in seconds
+byte flushInterval = DEFAULT_FLUSH_INTERVAL;
+// samples per second of the high rate motion logging, 0 = off
+byte motionRate = 0;
+boolean motionActive = false;
+unsigned long lastMotion;
+// the gyro is read by the TWI interrupt (twi_readRegisterAsync), the loop only starts the transfers.
+// Motion samples are read alternating into the 2 buffers, one is written while the other is read.
+byte gyroState = GYRO_IDLE;
+byte gyroBuffer[2][MOTION_BURST_SAMPLES * MOTION_SAMPLE_SIZE];
+byte gyroFill;
+byte gyroSamples;
+word motionPending;
+boolean gyroRequest = false;
+unsigned long gyroTime;
+// start of the running transfer, for the timeout
+unsigned long gyroStart;
+// roll, pitch and heave per second, calculated from the motion samples, 0 = off
+byte attitudeRate = 0;
+byte attitudeCount;
+Attitude attitude;
+
+/**
+ * task table of the main loop, in the order of priority (see runTasks() in osmfunctions.h).
+ * The serial channels and the gyro are polled in every pass, they only take
+ * what's ready. Flush, new file and statistic are background tasks, one per pass.
+ **/
+const byte TASK_COUNT = 5;
+Task tasks[TASK_COUNT] = {
+  // run, period ms, deadline ms, flags
+  { taskSerial, 0, 0, 0 },
+  { pollGyro, 0, 0, 0 },
+  { taskSecond, 1000, 100, 0 },
+  { taskFile, 1000, 1000, TASK_BACKGROUND },
+  { taskStatistic, 60000U, 1000, TASK_BACKGROUND }
+};
 
 void setup() {
 
@@ -246,6 +347,7 @@ void setup() {
   initGyro();
   delay(500);
   LEDAllOff();
+  taskStart(tasks, TASK_COUNT, millis());
 }
 
 /**
@@ -254,10 +356,10 @@ void setup() {
 inline void waitCapLoad() {
   dbgOutLn(F("CAP-load"));
   // save time for cap loading...
-  lastMillis = millis() + GOLDCAP_LOADING_TIME;
+  unsigned long loadedTime = millis() + GOLDCAP_LOADING_TIME;
   byte count = 0;
   unsigned long sumVoltage = 0;
-  while (millis() < lastMillis) {
+  while (millis() < loadedTime) {
     sumVoltage += readVcc();
     count++;
     LEDOn(LED_POWER);
@@ -266,6 +368,7 @@ inline void waitCapLoad() {
     delay(500);
   }
   normVoltage = (sumVoltage / count) - VCC_GOLDCAP;
+  startVccMonitor(sumVoltage / count);
 }
 
 /**
@@ -305,6 +408,9 @@ void getParameters() {
   byte outputs = EEPROM.read(EEPROM_OUTPUT);
   unsigned long vesselID = 0;
   EEPROM_readStruct(EEPROM_VESSELID, vesselID);
+  flushInterval = EEPROM.read(EEPROM_FLUSH_INTERVAL);
+  motionRate = EEPROM.read(EEPROM_MOTION_RATE);
+  attitudeRate = EEPROM.read(EEPROM_ATTITUDE_RATE);
 
   byte bootloaderVersion = EEPROM.read(EEPROM_BOOTLOADER_VERSION);
   if (bootloaderVersion > 10) {
@@ -415,22 +521,48 @@ void getParameters() {
           }
           if (paramCount == 4) {
             // read vesselID
-            vesselID = 0;
-            byte pos = 0;
-            filename[pos++] = readValue;
-            while (dataFile.available()) {
-              readValue = dataFile.read();
-              if ((readValue == 0x0D) || (readValue == 0x0A)) {
-                break;
-              }
-              filename[pos++] = readValue;
-            }
-            filename[pos] = 0;
+            readConfigValue(readValue);
             vesselID = strtoul(filename, NULL, 16);
             dbgOut(F("Vesselid:"));
             dbgOutLn2(vesselID, HEX);
             EEPROM_writeStruct(EEPROM_VESSELID, vesselID);
           }
+          if (paramCount == 5) {
+            // read flush interval in seconds
+            readConfigValue(readValue);
+            byte fflush = atoi(filename);
+            dbgOut(F("Flush readed:"));
+            dbgOutLn(fflush);
+            if (fflush != flushInterval) {
+              dbgOutLn(F("EEPROM write Flush:"));
+              EEPROM.write(EEPROM_FLUSH_INTERVAL, fflush);
+            }
+            flushInterval = fflush;
+          }
+          if (paramCount == 6) {
+            // read motion rate in samples per second
+            readConfigValue(readValue);
+            byte frate = atoi(filename);
+            dbgOut(F("Motion readed:"));
+            dbgOutLn(frate);
+            if (frate != motionRate) {
+              dbgOutLn(F("EEPROM write Motion:"));
+              EEPROM.write(EEPROM_MOTION_RATE, frate);
+            }
+            motionRate = frate;
+          }
+          if (paramCount == 7) {
+            // read attitude rate in messages per second
+            readConfigValue(readValue);
+            byte frate = atoi(filename);
+            dbgOut(F("Attitude readed:"));
+            dbgOutLn(frate);
+            if (frate != attitudeRate) {
+              dbgOutLn(F("EEPROM write Attitude:"));
+              EEPROM.write(EEPROM_ATTITUDE_RATE, frate);
+            }
+            attitudeRate = frate;
+          }
         }
       }
       dataFile.close();
@@ -440,6 +572,20 @@ void getParameters() {
   if (outputs < 0x80) {
     outputVcc = (outputs & 0x01) > 0;
     outputGyro = (outputs & 0x02) > 0;
+    binaryFormat = (outputs & 0x04) > 0;
+  }
+
+  if ((flushInterval == 0) || (flushInterval > MAX_FLUSH_INTERVAL)) {
+    flushInterval = DEFAULT_FLUSH_INTERVAL;
+  }
+
+  if (motionRate > MAX_MOTION_RATE) {
+    motionRate = 0;
+  } else if ((motionRate > 0) && (motionRate < MIN_MOTION_RATE)) {
+    motionRate = MIN_MOTION_RATE;
+  }
+  if (attitudeRate > motionRate) {
+    attitudeRate = motionRate;
   }
 
   outputParameter(baudA, baudB, outputs, vesselID, bootloaderVersion, crc);
@@ -470,66 +616,150 @@ inline void outputParameter(byte baudA, byte baudB, byte outputs, unsigned long
   dataFile.println(normVoltage);
   dataFile.println(bootloaderVersion);
   dataFile.println(crc, HEX);
+  dataFile.println(flushInterval);
+  dataFile.println(motionRate);
+  dataFile.println(attitudeRate);
 
   dataFile.close();
 }
 
 /**
- * initialsie the serial communication hardware.
- * For seatalk we need the 9N1 Protokoll. Otherwise we initialise with 8N1.
+ * reading the rest of the actual line of the config file into the filename buffer.
+ **/
+void readConfigValue(byte readValue) {
+  byte pos = 0;
+  filename[pos++] = readValue;
+  while (dataFile.available()) {
+    readValue = dataFile.read();
+    if ((readValue == 0x0D) || (readValue == 0x0A)) {
+      break;
+    }
+    if (pos < (sizeof(filename) - 1)) {
+      filename[pos++] = readValue;
+    }
+  }
+  filename[pos] = 0;
+}
+
+/**
+ * splitting the receive arena. Every active channel gets its line buffer (a seatalk datagram is smaller),
+ * the rest is split between the receive rings in relation to the baudrates.
+ * So a 38400 baud channel A with channel B switched off gets nearly the whole arena.
+ * A switched off channel keeps the small default buffer of the serial library.
+ **/
+void splitRxArena(word rateA, word rateB) {
+  byte* pos = rxArena;
+  lineSizeA = 0;
+  lineSizeB = 0;
+  if (rateA > 0) {
+    lineSizeA = seatalkActive ? SEATALK_MAX_DATAGRAM : MAX_NMEA_BUFFER;
+  }
+  if (rateB > 0) {
+    lineSizeB = MAX_NMEA_BUFFER;
+  }
+  bufferA = pos;
+  pos += lineSizeA;
+  bufferB = pos;
+  pos += lineSizeB;
+
+  word rest = RX_ARENA_SIZE - lineSizeA - lineSizeB;
+  word ringA = 0;
+  word ringB = 0;
+  if ((rateA + (unsigned long) rateB) > 0) {
+    ringA = ((unsigned long) rest * rateA) / (rateA + (unsigned long) rateB);
+    ringB = rest - ringA;
+  }
+  if (ringA > MAX_RX_RING_SIZE) {
+    ringA = MAX_RX_RING_SIZE;
+  }
+  if (ringB > MAX_RX_RING_SIZE) {
+    ringB = MAX_RX_RING_SIZE;
+  }
+  // seatalk only reads complete datagrams, so no 9th bits needed
+  Serial.setRxBuffer(ringA > 0 ? pos : 0, ringA, false);
+  pos += ringA;
+  mySerial.setRxBuffer(ringB > 0 ? pos : 0, ringB);
+}
+
+/**
+ * initialsie the serial communication: baudrates, split of the receive arena and size of the data file.
  * For seatalk we only have a baudrate of 4800.
  * For NMEA we  can use other.
+ * The receivers are started later by startSerials().
  **/
 inline void initSerials(byte baudA, byte baudB) {
   dbgOutLn(F("Init Searials"));
-  word baud = 0;
-  if (baudA < 0x06) {
-
-    baud = BAUDRATES[baudA];
+  rateA = 0;
+  rateB = 0;
+  unsigned long bytesPerSecond = INTERNAL_BYTES_PER_SECOND;
+  if ((baudA > 0) && (baudA <= 0x06)) {
+    // for seatalk we only have 4800 baud
+    rateA = seatalkActive ? 4800 : BAUDRATES[baudA];
+  }
+  if ((baudB > 0) && (baudB < 0x04)) {
+    rateB = BAUDRATES[baudB];
+  }
 
 #ifdef debug
-    if (seatalkActive) {
-      dbgOut(F("E SK:"));
-    }
-    else {
-      dbgOut(F("E NA:"));
-    }
-    Serial.println(baud, DEC);
-#endif
-    Serial.end();
-
-    // init serial channel a
-    if (baudA > 0) {
-      firstSerial = true;
-      // for seatalk we need another initialisation
-      if (seatalkActive) {
-        Serial.begin(4800, SERIAL_9N1);
-      } else {
-        Serial.begin(baud, SERIAL_8N1);
-      }
-    }
+  if (seatalkActive) {
+    dbgOut(F("E SK:"));
   }
+  else {
+    dbgOut(F("E NA:"));
+  }
+  Serial.println(rateA, DEC);
+  dbgOut(F("E NB:"));
+  Serial.println(rateB, DEC);
+#endif
 
-
-  // init serial for channel b
+  Serial.end();
   mySerial.end();
-  if (baudB < 0x04) {
-    baud = BAUDRATES[baudB];
+  splitRxArena(rateA, rateB);
 
-#ifdef debug
-    dbgOut(F("E NB:"));
-    Serial.println(baud, DEC);
-#endif
+  // channel a
+  if (rateA > 0) {
+    firstSerial = true;
+    bytesPerSecond += rateA / 5;
+  }
 
-    if (baud > 0) {
-      secondSerial = true;
-      mySerial.begin(baud);
+  // channel b
+  if (rateB > 0) {
+    secondSerial = true;
+    bytesPerSecond += rateB / 5;
+  }
+
+  // the preallocated data file should hold one hour of data.
+  // 10 bits per byte, but every received byte can take 2 bytes in the file (timestamp, marker, seatalk hex)
+  preallocateSize = bytesPerSecond * 3600L;
+  if (preallocateSize < PREALLOCATE_MIN_SIZE) {
+    preallocateSize = PREALLOCATE_MIN_SIZE;
+  }
+}
+
+/**
+ * starting the receivers of the active channels (initSerials()).
+ * For seatalk we need the 9N1 Protokoll. Otherwise we initialise with 8N1.
+ * This is done after the first data file is created, creating the preallocated file takes some 100 ms
+ * (Tools/osmsim), a 38400 baud channel would lose the bytes of this time in the middle of its lines.
+ **/
+void startSerials() {
+  if (rateA > 0) {
+    // for seatalk we need another initialisation
+    if (seatalkActive) {
+      Serial.beginSeaTalk();
+    } else {
+      Serial.begin(rateA, SERIAL_8N1);
     }
   }
+  if (rateB > 0) {
+    mySerial.begin(rateB);
+  }
+  serialsStarted = true;
 }
 
 /**
  * Initialise the gyro and acc. For gyro we take 250°/sec, for the acc we use 2g
+ * With a motion rate the MPU6050 takes the samples itself into the FIFO.
  **/
 inline void initGyro() {
   //--- init MPU6050 ---
@@ -545,6 +775,7 @@ inline void initGyro() {
     dbgOutLn(F("MPU6050 successful"));
     accelgyro.setFullScaleAccelRange(0);
     accelgyro.setFullScaleGyroRange(0);
+    initMotion();
   }
   else {
     LEDOff(LED_RX_B);
@@ -553,6 +784,39 @@ inline void initGyro() {
 #endif
 }
 
+/**
+ * configuring the FIFO of the MPU6050 for the high rate motion logging.
+ * The sample rate is 1 kHz / (1 + divider), the low pass filter is set below the half sample rate.
+ * acc and gyro (12 bytes) are written into the FIFO, without a motion rate the FIFO is switched off.
+ **/
+void initMotion() {
+#ifdef doOutputGyro
+  motionActive = outputGyro && (motionRate > 0);
+  accelgyro.setFIFOEnabled(false);
+  accelgyro.setAccelFIFOEnabled(motionActive);
+  accelgyro.setXGyroFIFOEnabled(motionActive);
+  accelgyro.setYGyroFIFOEnabled(motionActive);
+  accelgyro.setZGyroFIFOEnabled(motionActive);
+  if (motionActive) {
+    byte bandwidth = MPU6050_DLPF_BW_5;
+    if (motionRate >= 84) {
+      bandwidth = MPU6050_DLPF_BW_42;
+    } else if (motionRate >= 40) {
+      bandwidth = MPU6050_DLPF_BW_20;
+    } else if (motionRate >= 20) {
+      bandwidth = MPU6050_DLPF_BW_10;
+    }
+    accelgyro.setDLPFMode(bandwidth);
+    accelgyro.setRate((1000 / motionRate) - 1);
+    accelgyro.resetFIFO();
+    accelgyro.setFIFOEnabled(true);
+    lastMotion = millis();
+    attitudeStart(&attitude, motionRate);
+    attitudeCount = 0;
+  }
+#endif
+}
+
 /**
  * calcualting the 16 bit checksum of a part of the flash memory.
  **/
@@ -566,7 +830,7 @@ static word CalculateChecksum (word addr, word size) {
   */
   word endCrc = addr + size;
   for (word i = addr; i < endCrc; ++i) {
-    crc = _crc16_update(crc, pgm_read_byte((void *)i));
+    crc = _crc16_update(crc, pgm_read_byte((void *)(uintptr_t)i));
   }
   
   return crc;
@@ -583,13 +847,19 @@ unsigned long lastW;
 unsigned long vccTime;
 unsigned long startA, startB;
 
-// the 3 buffers for transfering data.
-byte bufferA[MAX_NMEA_BUFFER];
-byte bufferB[MAX_NMEA_BUFFER];
+// buffer for the messages of the logger, the line buffers of the channels are in the rxArena.
 char linedata[MAX_NMEA_BUFFER];
-char timedata[15];
 
-byte lastFlush = 0;
+unsigned long lastFlush = 0;
+
+// statistic of a serial channel, written every minute with the POSMSTAT message
+struct ChannelStatistic {
+  unsigned long bytes;
+  unsigned long lines;
+  word checksumErrors;
+  word truncated;
+};
+ChannelStatistic statisticA, statisticB;
 
 /**
  * main loop.
@@ -599,23 +869,21 @@ void loop() {
   long now = millis();
   checkLEDState(now);
 
-  // read power supply
-  vcc = readVcc();
   // if the voltage drops below 4V7 we are on Cappower, so we must close all files and wait.
-  if ((vcc < normVoltage) || (digitalRead(SW_STOP) == 0)) {
+  if (brownOut || (digitalRead(SW_STOP) == 0)) {
     // Alle LED's aus, Strom sparen
     LEDAllOff();
 
     if (dataFile.isOpen()) {
-
-      writeVCC();
-      if (vcc < normVoltage) {
-        strcpy_P(linedata, REASON_VCC_MESSAGE);
+      if (brownOut) {
+        powerFail();
       } else {
+        updateVcc();
+        writeVCC();
         strcpy_P(linedata, REASON_SWITCH_MESSAGE);
+        writeData(millis(), CHANNEL_I_IDENTIFIER, linedata);  // write data to card
+        stopLogger();
       }
-      writeData(millis(), CHANNEL_I_IDENTIFIER, linedata);  // write data to card
-      stopLogger();
       dbgOutLn(F("Shutdown detected, datafile closed"));
     }
     // switch on all LED's, to unload the gold cap.
@@ -623,39 +891,111 @@ void loop() {
     delay(10000);
   }
   else {
-    if (!dataFile.isOpen()) {
+    // after an error (card full, no file number left) no new file is tried in every pass
+    if (!dataFile.isOpen() && !error) {
       newFile();
     }
+    if (!serialsStarted) {
+      startSerials();
+    }
+
+    runTasks(tasks, TASK_COUNT, now, micros);
+  }
+}
 
-    testSerialA();
-    testSerialB();
+/**
+ * power fail: the gold cap has to hold until the data file is consistent, so only the minimum is done.
+ * The LEDs are off, the pending partial block is written and only the size in the directory entry is
+ * updated. No truncate, the rest of the preallocated clusters is freed by the next start (freeFileTail()),
+ * no vcc and block messages.
+ * The time needed and the voltage before and after are stored in the eeprom, the next file gets them (POSMPF).
+ * This is done after the file is closed, 8 bytes take 26 ms. The time is written last, a record cut off by
+ * the empty gold cap has no time and is ignored (Tools/osmsim -z, make cutoff).
+ **/
+void powerFail() {
+  unsigned long startTime = micros();
+  updateVcc();
+  word startVcc = vcc;
+  strcpy_P(linedata, REASON_VCC_MESSAGE);
+  writeData(millis(), CHANNEL_I_IDENTIFIER, linedata);
+  LEDAllOff();
+  if (blockWriter) {
+    syncDataBlock();
+    blockWriter = false;
+    dataFile.setSize(((actBlock - firstBlock) << 9) + blockIndex);
+  } else {
+    dataFile.sync();
+  }
+  dataFile.close();
+  unsigned long shutdownTime = micros() - startTime;
+
+  // the file is consistent now, the rest is only for the statistic
+  updateVcc();
+  EEPROM_writeStruct(EEPROM_SHUTDOWN_VCC, startVcc);
+  EEPROM_writeStruct(EEPROM_SHUTDOWN_VCC + 2, vcc);
+  EEPROM_writeStruct(EEPROM_SHUTDOWN_TIME, shutdownTime);
+}
 
-    // check the gyro only once in a second
-    //now = millis();
-    if ((now - 1000) > lastMillis) {
-      outputFreeMem('L');
-      lastMillis = now;
+/**
+ * writing the shutdown time and voltages of the last power fail, only once.
+ * The high byte of the time is written last (little endian), if it's still erased the record isn't complete.
+ **/
+void outputPowerFail() {
+  unsigned long shutdownTime;
+  EEPROM_readStruct(EEPROM_SHUTDOWN_TIME, shutdownTime);
+  if ((shutdownTime >> 24) == 0xFF) {
+    return;
+  }
+  word startVcc, endVcc;
+  EEPROM_readStruct(EEPROM_SHUTDOWN_VCC, startVcc);
+  EEPROM_readStruct(EEPROM_SHUTDOWN_VCC + 2, endVcc);
+  sprintf_P(linedata, POWERFAIL_MESSAGE, shutdownTime, startVcc, endVcc);
+  writeData(millis(), CHANNEL_I_IDENTIFIER, linedata);
+  shutdownTime = 0xFFFFFFFF;
+  EEPROM_writeStruct(EEPROM_SHUTDOWN_TIME, shutdownTime);
+}
 
-      writeGyroData();
-      writeVCC();
+void taskSerial(unsigned long now) {
+  testSerialA();
+  testSerialB();
+}
 
-      byte nowFlush = (now / 60000L) % 256L;
-      word nowCount = (now / 1000L) / 3600L;
+/**
+ * once a second: free memory, gyro (without motion rate) and voltage.
+ **/
+void taskSecond(unsigned long now) {
+  outputFreeMem('L');
+  if (outputGyro && !motionActive) {
+    gyroRequest = true;
+  }
+  updateVcc();
+  writeVCC();
+}
 
-      // testing the needing of a new file
-      if (nowCount > fileCount) {
-        strcpy_P(linedata, REASON_TIME_MESSAGE);
-        writeData(millis(), CHANNEL_I_IDENTIFIER, linedata);  // write data to card
-        newFile();
-        fileCount++;
-      } else if (nowFlush != lastFlush) {
-        flushFile();
-        lastFlush = nowFlush;
-      }
-    }
+/**
+ * testing the needing of a new file, else flushing every flush interval.
+ **/
+void taskFile(unsigned long now) {
+  word nowCount = (now / 1000L) / 3600L;
+  if (nowCount > fileCount) {
+    strcpy_P(linedata, REASON_TIME_MESSAGE);
+    writeData(millis(), CHANNEL_I_IDENTIFIER, linedata);  // write data to card
+    newFile();
+    fileCount++;
+  } else if ((now - lastFlush) >= (flushInterval * 1000L)) {
+    flushFile();
+    lastFlush = now;
   }
 }
 
+/**
+ * every minute: statistic of the serial channels and of the tasks.
+ **/
+void taskStatistic(unsigned long now) {
+  writeStatistic();
+  writeTaskStatistic();
+}
+
 /**
  * checking the state of all LED's.
  * On error blink with the power LED (2Hz)
@@ -694,6 +1034,52 @@ inline void checkLEDState(long now) {
   }
 }
 
+/**
+ * starting the supply monitor with the mean voltage in mV of the cap loading.
+ * The ADC measures the 1.1V reference against AVcc, started by the timer 0 overflow (about 1 kHz).
+ * Free running (9.6 kHz with the slowest ADC clock) would cost 10 times the interrupt load for nothing.
+ * The brown out level is the raw value of normVoltage, the ADC value rises when the voltage drops.
+ **/
+void startVccMonitor(word voltage) {
+  brownOutLevel = (VCC_FILTER_SAMPLES * 1126400L) / normVoltage;
+  vccFiltered = (VCC_FILTER_SAMPLES * 1126400L) / voltage;
+  brownOut = false;
+  // Read 1.1V reference against AVcc, the reference is settled by readVcc()
+  ADMUX = _BV(REFS0) | _BV(MUX3) | _BV(MUX2) | _BV(MUX1);
+  ADCSRB = _BV(ADTS2);
+  ADCSRA = _BV(ADEN) | _BV(ADATE) | _BV(ADIE) | _BV(ADIF) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+}
+
+/**
+ * one conversion of the supply monitor: exponential moving average and the brown out flag.
+ * filtered is VCC_FILTER_SAMPLES times the average, every conversion moves it by 1/VCC_FILTER_SAMPLES of the
+ * difference to the new value (time constant 4 conversions, one per timer 0 overflow, 1.024 ms).
+ * After a voltage step from raw a0 to a1 the flag is set after n conversions with
+ * (3/4)^n < (a1 - norm) / (a1 - a0). From 5.0 V (raw 225) with a norm of 4.8 V (raw 235):
+ * a drop to 4.5 V trips after 2 conversions, to 4.7 V after 4, to 4.78 V after 10, a lost supply after 1.
+ * The integer division lets filtered settle up to 3 above 4 * raw, about 15 mV low at 5 V.
+ **/
+ISR(ADC_vect) {
+  word filtered = vccFiltered;
+  filtered += ADC - (filtered / VCC_FILTER_SAMPLES);
+  vccFiltered = filtered;
+  brownOut = filtered > brownOutLevel;
+}
+
+/**
+ * taking the filtered voltage of the supply monitor in mV.
+ **/
+void updateVcc() {
+  uint8_t oldSREG = SREG;
+  cli();
+  word filtered = vccFiltered;
+  SREG = oldSREG;
+  vcc = (VCC_FILTER_SAMPLES * 1126400L) / filtered; // Back-calculate AVcc in mV
+#ifdef doOutputVcc
+  vccTime = millis();
+#endif
+}
+
 /**
  * reading the actual voltage of the board.
  **/
@@ -719,6 +1105,14 @@ word readVcc() {
 inline void writeVCC() {
 #ifdef doOutputVcc
   if (outputVcc) {
+    if (binaryFormat) {
+      if (dataFile.isOpen()) {
+        writeRecordHeader(vccTime, BINARY_VCC_RECORD, 4);
+        logWrite(&vcc, 2);
+        logWrite(&normVoltage, 2);
+      }
+      return;
+    }
     sprintf_P(linedata, VCC_MESSAGE, vcc, normVoltage);
     writeData(vccTime, CHANNEL_I_IDENTIFIER, linedata);
   }
@@ -726,21 +1120,245 @@ inline void writeVCC() {
 }
 
 /**
- * writing gyro data to the sd card.
+ * writing the statistic of the active serial channels.
+ **/
+void writeStatistic() {
+  unsigned long startTime = millis();
+  if (firstSerial) {
+    sprintf_P(linedata, STAT_MESSAGE, CHANNEL_A_IDENTIFIER, statisticA.bytes, statisticA.lines,
+              statisticA.checksumErrors, statisticA.truncated, Serial.overflowCount(), Serial.datagramErrors());
+    writeData(startTime, CHANNEL_I_IDENTIFIER, linedata);
+  }
+  if (secondSerial) {
+    sprintf_P(linedata, STAT_MESSAGE, CHANNEL_B_IDENTIFIER, statisticB.bytes, statisticB.lines,
+              statisticB.checksumErrors, statisticB.truncated, mySerial.overflowCount(), 0);
+    writeData(startTime, CHANNEL_I_IDENTIFIER, linedata);
+  }
+}
+
+/**
+ * writing the max. runtime (µs) and the missed deadlines of every task, then they start again.
+ * On the avr the stack headroom follows (POSMRAM).
  **/
-inline void writeGyroData() {
+void writeTaskStatistic() {
+  unsigned long startTime = millis();
+  for (byte i = 0; i < TASK_COUNT; i++) {
+    sprintf_P(linedata, TASK_MESSAGE, i, (unsigned long) tasks[i].maxRuntime, tasks[i].misses);
+    writeData(startTime, CHANNEL_I_IDENTIFIER, linedata);
+  }
+  taskReset(tasks, TASK_COUNT);
+#ifdef __AVR__
+  sprintf_P(linedata, RAM_MESSAGE, unusedStack());
+  writeData(startTime, CHANNEL_I_IDENTIFIER, linedata);
+#endif
+}
+
+#ifdef __AVR__
+// the RAM between the variables and the stack is painted before the constructors run (.init3),
+// there is no heap. The stack overwrites the paint, the paint left at the bottom was never used.
+#define STACK_PAINT 0xC5
+extern uint8_t __bss_end;
+
+void paintStack() __attribute__((naked, used, section(".init3")));
+
+void paintStack() {
+  for (uint8_t* p = &__bss_end; p < (uint8_t*) SP; p++) {
+    *p = STACK_PAINT;
+  }
+}
+
+/**
+ * free RAM at the deepest stack since the start: the painted bytes above the variables.
+ **/
+word unusedStack() {
+  const uint8_t* p = &__bss_end;
+  while ((p < (const uint8_t*) SP) && (*p == STACK_PAINT)) {
+    p++;
+  }
+  return p - &__bss_end;
+}
+#endif
+
+/**
+ * reading the gyro without waiting for the I2C bus, called in every loop.
+ * A finished transfer is written to the data file and the next one is started, the TWI interrupt does the rest.
+ * Once a second (gyroRequest) acc, temperature and gyro (14 bytes) are read.
+ * With a motion rate every MOTION_READ_INTERVAL the FIFO count is read, then the samples in bursts.
+ **/
+void pollGyro(unsigned long now) {
 #ifdef doOutputGyro
-  if (outputGyro) {
-    unsigned long startTime = millis();
-    accelgyro.getRotation(&ax, &ay, &az);
+  if (gyroState == GYRO_IDLE) {
+    if (motionActive) {
+      if ((now - lastMotion) >= MOTION_READ_INTERVAL) {
+        if (twi_readRegisterAsync(MPU6050_ADDRESS_AD0_LOW, MPU6050_RA_FIFO_COUNTH, gyroBuffer[0], 2)) {
+          gyroState = GYRO_COUNT;
+          lastMotion = now;
+          gyroStart = now;
+        }
+      }
+    } else if (gyroRequest) {
+      if (twi_readRegisterAsync(MPU6050_ADDRESS_AD0_LOW, MPU6050_RA_ACCEL_XOUT_H, gyroBuffer[0], 14)) {
+        gyroState = GYRO_AXES;
+        gyroTime = now;
+        gyroStart = now;
+        gyroRequest = false;
+      }
+    }
+    return;
+  }
+
+  if ((gyroState != GYRO_COUNT) && !logReady(GYRO_WRITE_RESERVE)) {
+    // the transfer ends in the background, the data is written when the card has finished the last block
+    return;
+  }
+  byte status = twi_asyncStatus();
+  if (status == TWI_ASYNC_ERROR) {
+    gyroState = GYRO_IDLE;
+    return;
+  }
+  if (status != TWI_ASYNC_DONE) {
+    if ((now - gyroStart) >= GYRO_TIMEOUT) {
+      // hung bus (no interrupt anymore, the gyro holds SDA), starting the TWI again
+      dbgOutLn(F("TWI timeout"));
+      twi_disable();
+      twi_init();
+      if (gyroState != GYRO_AXES) {
+        // a FIFO read stopped somewhere in a sample, the FIFO isn't aligned to the samples anymore
+        accelgyro.resetFIFO();
+      }
+      gyroState = GYRO_IDLE;
+    }
+    return;
+  }
+
+  if (gyroState == GYRO_AXES) {
+    gyroState = GYRO_IDLE;
+    writeGyroData(gyroBuffer[0]);
+  } else if (gyroState == GYRO_COUNT) {
+    word count = (gyroBuffer[0][0] << 8) | gyroBuffer[0][1];
+    if (count >= MOTION_FIFO_SIZE) {
+      // samples lost and the FIFO isn't aligned to the samples anymore
+      dbgOutLn(F("FIFO overflow"));
+      accelgyro.resetFIFO();
+      gyroState = GYRO_IDLE;
+      return;
+    }
+    motionPending = count / MOTION_SAMPLE_SIZE;
+    gyroFill = 0;
+    readMotionBurst();
+    gyroStart = now;
+  } else {
+    // start reading the next burst into the other buffer, then write this one
+    byte* samples = gyroBuffer[gyroFill];
+    byte count = gyroSamples;
+    unsigned long time = gyroTime;
+    gyroFill ^= 1;
+    readMotionBurst();
+    gyroStart = now;
+    writeMotionData(time, samples, count);
+  }
+#endif
+}
+
+/**
+ * starting the read of the next motion samples into the free buffer.
+ * The time of the burst is the time of its last sample, the FIFO count was read at lastMotion.
+ **/
+void readMotionBurst() {
+#ifdef doOutputGyro
+  gyroState = GYRO_IDLE;
+  if (motionPending == 0) {
+    return;
+  }
+  byte n = min(motionPending, MOTION_BURST_SAMPLES);
+  if (twi_readRegisterAsync(MPU6050_ADDRESS_AD0_LOW, MPU6050_RA_FIFO_R_W, gyroBuffer[gyroFill], n * MOTION_SAMPLE_SIZE)) {
+    motionPending -= n;
+    gyroSamples = n;
+    gyroTime = motionSampleTime(lastMotion, motionRate, motionPending);
+    gyroState = GYRO_SAMPLES;
+  }
+#endif
+}
+
+/**
+ * writing gyro data to the sd card. axes are the 14 bytes from ACCEL_XOUT_H (acc, temperature, gyro).
+ **/
+inline void writeGyroData(byte* axes) {
+  ax = motionValue(axes, 4);
+  ay = motionValue(axes, 5);
+  az = motionValue(axes, 6);
+  if (binaryFormat) {
+    writeAxisRecord(gyroTime, BINARY_GYRO_RECORD);
+  } else {
     sprintf_P(linedata, GYRO_MESSAGE, ax, ay, az);
-    writeData(startTime, CHANNEL_I_IDENTIFIER,  linedata);
+    writeData(gyroTime, CHANNEL_I_IDENTIFIER,  linedata);
+  }
 
-    accelgyro.getAcceleration(&ax, &ay, &az);
+  ax = motionValue(axes, 0);
+  ay = motionValue(axes, 1);
+  az = motionValue(axes, 2);
+  if (binaryFormat) {
+    writeAxisRecord(gyroTime, BINARY_ACC_RECORD);
+  } else {
     sprintf_P(linedata, ACC_MESSAGE, ax, ay, az);
-    writeData(startTime, CHANNEL_I_IDENTIFIER, linedata);
+    writeData(gyroTime, CHANNEL_I_IDENTIFIER, linedata);
+  }
+}
+
+/**
+ * writing motion samples (acc x,y,z, gyro x,y,z) of the FIFO, time is the time of the last sample.
+ * Binary: one record with the rate and the samples, text: one POSMMOT message per sample.
+ * With an attitude rate the samples only go into the attitude filter.
+ **/
+void writeMotionData(unsigned long time, byte* samples, byte count) {
+  if (attitudeRate > 0) {
+    writeAttitudeData(time, samples, count);
+    return;
+  }
+  if (!dataFile.isOpen()) {
+    return;
+  }
+  if (binaryFormat) {
+    writeLEDOn();
+    writeRecordHeader(time, BINARY_MOTION_RECORD, 1 + count * MOTION_SAMPLE_SIZE);
+    logWrite(&motionRate, 1);
+    logWrite(samples, count * MOTION_SAMPLE_SIZE);
+    return;
+  }
+  for (byte i = 0; i < count; i++) {
+    byte* sample = samples + i * MOTION_SAMPLE_SIZE;
+    sprintf_P(linedata, MOTION_MESSAGE, motionValue(sample, 0), motionValue(sample, 1), motionValue(sample, 2),
+              motionValue(sample, 3), motionValue(sample, 4), motionValue(sample, 5));
+    writeData(motionSampleTime(time, motionRate, count - 1 - i), CHANNEL_I_IDENTIFIER, linedata);
+  }
+}
+
+/**
+ * feeding the motion samples into the attitude filter, every motionRate / attitudeRate samples
+ * roll, pitch (1/10 degree) and heave (cm) are written with the time of the sample.
+ **/
+void writeAttitudeData(unsigned long time, byte* samples, byte count) {
+  for (byte i = 0; i < count; i++) {
+    attitudeUpdate(&attitude, samples + i * MOTION_SAMPLE_SIZE);
+    attitudeCount += attitudeRate;
+    if (attitudeCount < motionRate) {
+      continue;
+    }
+    attitudeCount -= motionRate;
+    if (!dataFile.isOpen()) {
+      continue;
+    }
+    unsigned long sampleTime = motionSampleTime(time, motionRate, count - 1 - i);
+    ax = attitudeRoll(&attitude);
+    ay = attitudePitch(&attitude);
+    az = attitudeHeave(&attitude);
+    if (binaryFormat) {
+      writeAxisRecord(sampleTime, BINARY_ATTITUDE_RECORD);
+    } else {
+      sprintf_P(linedata, ATTITUDE_MESSAGE, ax, ay, az);
+      writeData(sampleTime, CHANNEL_I_IDENTIFIER, linedata);
+    }
   }
-#endif
 }
 
 /**
@@ -756,19 +1374,24 @@ void outputConfig() {
   EEPROM_readStruct(EEPROM_VESSELID, vesselID);
   byte bootloaderVersion = EEPROM.read(EEPROM_BOOTLOADER_VERSION);
 
-  sprintf_P(linedata, CONFIG_MESSAGE, baudA, baudB, seatalk, outputs, vesselID, bootloaderVersion);
+  sprintf_P(linedata, CONFIG_MESSAGE, baudA, baudB, seatalk, outputs, vesselID, bootloaderVersion, flushInterval, motionRate, attitudeRate);
   writeData(startTime, CHANNEL_I_IDENTIFIER,  linedata);
 }
 
 /**
- * flushnig the data file. (Will be calles once a minute)
+ * flushnig the data file. (Will be called every flush interval)
+ * Only the pending data and the directory entry will be written, the file stays open (syncDataFile()).
  **/
 void flushFile() {
-  dataFile.close();
-  dataFile.open(filename, O_RDWR | O_APPEND | O_AT_END);
+  syncDataFile();
 }
 
 word lastStartNumber = 0;
+// the numbers from lastStartNumber + 1 up to this one (exclusive) are free, the next file needs no scan
+word freeUntil = 0;
+// file numbers in one bitmap pass of scanFreeNumber() (the bits of linedata)
+const word FILE_NUMBER_WINDOW = MAX_NMEA_BUFFER * 8;
+const byte FILE_NUMBER_WINDOWS = (10000 + FILE_NUMBER_WINDOW - 1) / FILE_NUMBER_WINDOW;
 
 /**
  * creating  a new file with a new filename on the sd card.
@@ -787,43 +1410,185 @@ void newFile() {
     //    LEDOn(SUPPLY_3V3);
     delay(500);
   }
-  int t = 0;
-  int h = 0;
-  int z = 0;
-  int e = 0;
-  strcpy_P(filename, DATA_FILENAME);
   LEDAllOff();
+  if (sd.vol()->fatType() == 16) {
+    word hint;
+    EEPROM_readStruct(EEPROM_ALLOC_HINT, hint);
+    sd.vol()->setAllocSearchStart(hint);
+  }
 
-  for (word i = lastStartNumber + 1; i < 10000; i++) { // create new filename w/ 3 digits 000-999
-    LEDBlink(LED_POWER);
-    t = i / 1000;
-    filename[4] = t + '0';          // calculates tausends position
-    h = (i - (t * 1000)) / 100;
-    filename[5] = h + '0';          // calculates hundred position
-    z = (i - (t * 1000) - (h * 100)) / 10 ;
-    filename[6] = z + '0';          // subtracts hundreds & tens for single digit
-    e = i - (t * 1000) - (h * 100) - (z * 10);
-    filename[7] = e + '0';          // calculates hundreds position
-    if (! sd.exists(filename)) {    // only open a new file if it doesn't exist
-      // checking the freespace
-      uint32_t freeKB = sd.vol()->freeClusterCount();
-      // calculating the count of minimun required culsters
-      uint32_t required = 100 * 1024 * 2 / sd.vol()->blocksPerCluster(); // min 100MB sollten noch frei sein
-      if (freeKB >= required) {
-        dataFile.open(filename, O_RDWR | O_CREAT | O_AT_END);
-        lastStartNumber = i;
-      }
-      else {
-        error = true;
-      }
-      break;                        // leave the loop after finding new filename
+  word number = nextFileNumber();
+  if (number < 10000) {
+    setDataFilename(number);
+    // checking the freespace, the count is kept by the volume, only the first file reads it
+    uint32_t freeKB = sd.vol()->freeClusterCount();
+    // calculating the count of minimun required culsters
+    uint32_t required = 100 * 1024 * 2 / sd.vol()->blocksPerCluster(); // min 100MB sollten noch frei sein
+    if (freeKB >= required) {
+      openDataFile();
+      writeFileHeader();
+      lastStartNumber = number;
+    }
+    else {
+      error = true;
     }
+  } else {
+    // all numbers from data0001.dat to data9999.dat are used, a 5th digit doesn't fit into the 8.3 filename
+    dbgOutLn(F("no file number left"));
+    error = true;
   }
 
   strcpy_P(linedata, START_MESSAGE);
   dbgOutLn(F("Start"));
   writeData(millis(), CHANNEL_I_IDENTIFIER, linedata);          // write data to card
   outputConfig();
+  outputPowerFail();
+}
+
+/**
+ * setting the data filename (dataNNNN.dat) for the number into filename.
+ **/
+void setDataFilename(word number) {
+  strcpy_P(filename, DATA_FILENAME);
+  for (byte i = 7; i > 3; i--) {
+    filename[i] = (number % 10) + '0';
+    number /= 10;
+  }
+}
+
+/**
+ * getting the number for the next data file.
+ * After the first file of this start the next number is taken without looking at the card, as long as it's
+ * known to be free (freeUntil), nothing else writes to it.
+ * Otherwise the root directory is read once to get the highest file number. A number saved in the eeprom doesn't
+ * help: sd.exists() is a directory pass of its own, checking the saved file and the next one took longer than
+ * the scan (Tools/osmsim -n 5000).
+ * With data9999.dat on the card the lowest free number is taken (scanFreeNumber()), the gaps of deleted files
+ * are filled in their order. The result is 10000, if no number is left, newFile() stops with an error then.
+ **/
+word nextFileNumber() {
+  if (lastStartNumber + 1 < freeUntil) {
+    return lastStartNumber + 1;
+  }
+  dbgOutLn(F("scan data files"));
+  // the last data file of the last start
+  word lastNumber = scanFileNumber();
+  word number = lastNumber + 1;
+  freeUntil = 10000;
+  if (lastNumber == 9999) {
+    number = scanFreeNumber();
+    lastNumber = (number > 1) ? number - 1 : 9999;
+  }
+  if (lastStartNumber == 0) {
+    freeFileTail(lastNumber);
+  }
+  return number;
+}
+
+/**
+ * freeing the clusters behind the size of the data file with the number. After a power fail or a crash the
+ * last data file of the last start still has the preallocated rest (powerFail(), syncDataFile() only write
+ * the size). A file closed by newFile() or the stop switch has no rest, nothing is freed then.
+ * While the gaps are filled, the last file is the one before the lowest gap, if the deleted files were in a row.
+ **/
+void freeFileTail(word number) {
+  if (number == 0) {
+    return;
+  }
+  setDataFilename(number);
+  if (dataFile.open(filename, O_RDWR)) {
+    dataFile.truncate(dataFile.fileSize());
+    dataFile.close();
+  }
+}
+
+/**
+ * the number of a DATANNNN.DAT directory entry, 0 for all other entries.
+ **/
+word dirFileNumber(const dir_t* dir) {
+  if (!DIR_IS_FILE(dir) || strncmp_P((char*) dir->name, PSTR("DATA"), 4) || strncmp_P((char*) dir->name + 8, PSTR("DAT"), 3)) {
+    return 0;
+  }
+  word number = 0;
+  for (byte i = 4; i < 8; i++) {
+    char c = dir->name[i];
+    if (c < '0' || c > '9') {
+      return 0;
+    }
+    number = number * 10 + (c - '0');
+  }
+  return number;
+}
+
+/**
+ * reading the root directory once, returning the highest number of all DATANNNN.DAT files.
+ **/
+word scanFileNumber() {
+  word maxNumber = 0;
+  dir_t dir;
+  SdBaseFile* root = sd.vwd();
+  root->rewind();
+  while (root->readDir(&dir) > 0) {
+    word number = dirFileNumber(&dir);
+    if (number > maxNumber) {
+      maxNumber = number;
+    }
+  }
+  return maxNumber;
+}
+
+/**
+ * finding the lowest free file number with two passes over the root directory: the first counts the files in
+ * every window of FILE_NUMBER_WINDOW numbers, the second marks the files of the first window with a free number
+ * in a bitmap (linedata). freeUntil is set to the next used number after it.
+ * Returns 10000, if all numbers from 1 to 9999 are used.
+ **/
+word scanFreeNumber() {
+  word counts[FILE_NUMBER_WINDOWS];
+  memset(counts, 0, sizeof(counts));
+  dir_t dir;
+  SdBaseFile* root = sd.vwd();
+  root->rewind();
+  while (root->readDir(&dir) > 0) {
+    word number = dirFileNumber(&dir);
+    if (number > 0) {
+      counts[number / FILE_NUMBER_WINDOW]++;
+    }
+  }
+  // the first window has no number 0, the last one ends at 9999
+  word base = 0;
+  byte window = 0;
+  for (; window < FILE_NUMBER_WINDOWS; window++, base += FILE_NUMBER_WINDOW) {
+    word end = min(base + FILE_NUMBER_WINDOW, 10000);
+    if (counts[window] < end - max(base, 1)) {
+      break;
+    }
+  }
+  if (window == FILE_NUMBER_WINDOWS) {
+    return 10000;
+  }
+
+  byte* used = (byte*) linedata;
+  memset(used, 0, FILE_NUMBER_WINDOW / 8);
+  used[0] = (base == 0) ? 0x01 : 0x00;
+  root->rewind();
+  while (root->readDir(&dir) > 0) {
+    word number = dirFileNumber(&dir);
+    if ((number >= base) && (number - base < FILE_NUMBER_WINDOW)) {
+      number -= base;
+      used[number >> 3] |= _BV(number & 0x07);
+    }
+  }
+  word number = 0;
+  while (used[number >> 3] & _BV(number & 0x07)) {
+    number++;
+  }
+  word next = number + 1;
+  while ((next < FILE_NUMBER_WINDOW) && !(used[next >> 3] & _BV(next & 0x07))) {
+    next++;
+  }
+  freeUntil = min(base + next, 10000);
+  return base + number;
 }
 
 /**
@@ -831,14 +1596,40 @@ void newFile() {
  **/
 void stopLogger() {
   dbgOutLn(F("close datafile."));
+#ifdef preallocateFile
+  sprintf_P(linedata, BLOCK_MESSAGE, actBlock - firstBlock, maxBlockTime);
+  writeData(millis(), CHANNEL_I_IDENTIFIER, linedata);  // write data to card
+#endif
   strcpy_P(linedata, STOP_MESSAGE);
   writeData(millis(), CHANNEL_I_IDENTIFIER, linedata);  // write data to card
   if (dataFile.isOpen()) {
-    dataFile.close();
+    closeDataFile();
+    saveAllocHint();
+  }
+}
+
+/**
+ * saving the free count and the start of the next free cluster search, FAT32 in the FSINFO of the card,
+ * FAT16 in the eeprom (only if changed). So the first file after a start doesn't search the whole FAT.
+ **/
+void saveAllocHint() {
+  sd.vol()->syncFSInfo();
+  if (sd.vol()->fatType() == 16) {
+    word hint = sd.vol()->allocSearchStart();
+    word savedHint;
+    EEPROM_readStruct(EEPROM_ALLOC_HINT, savedHint);
+    if (hint != savedHint) {
+      EEPROM_writeStruct(EEPROM_ALLOC_HINT, hint);
+    }
   }
 }
 
 bool endingA, endingB;
+// the complete line waits for the card (completeLineA/B)
+bool waitingA = false, waitingB = false;
+#ifdef checkNMEA
+NMEACheck nmeaCheckA, nmeaCheckB;
+#endif
 
 /**
  * testing the first serial connection.
@@ -846,22 +1637,28 @@ bool endingA, endingB;
 void testSerialA() {
   if (firstSerial) {
     outputFreeMem('1');
+    if (seatalkActive) {
+      SeaTalkInputA();
+      return;
+    }
+    if (waitingA) {
+      completeLineA();
+      if (waitingA) {
+        return;
+      }
+    }
     endingA = false;
-    while ((Serial.available()  > 0) && !endingA) {
+    while ((Serial.available()  > 0) && !endingA && !waitingA) {
       int incomingByte = Serial.read();
       if (incomingByte >= 0) {
+        statisticA.bytes++;
         if (indexA == 0) {
-          startA = millis();
+          startA = Serial.lineTime();
         }
 #ifndef checkNMEA
         LEDOn(LED_RX_A);
 #endif
-        if (seatalkActive) {
-          SeaTalkInputA(incomingByte);
-        }
-        else {
-          NMEAInputA(incomingByte);
-        }
+        NMEAInputA(incomingByte);
       }
     }
   }
@@ -870,21 +1667,22 @@ void testSerialA() {
 
 /**
  * processing seatalk data.
+ * The serial interrupt only releases complete datagrams with the right length,
+ * so one datagram is taken per call.
  **/
-byte dataLength;
-inline void SeaTalkInputA(int incomingByte) {
-  if ((incomingByte & 0x0100) > 0) {
-    writeDatagram();
-    endingA = true;
-    indexA = 0;
-    startA = millis();
-  }
-  if (indexA == 1) {
-    dataLength = 3 + (incomingByte & 0x0F);
+inline void SeaTalkInputA() {
+  if (!logReady(MAX_NMEA_BUFFER + LOG_LINE_OVERHEAD)) {
+    return;
   }
-  if (indexA < MAX_NMEA_BUFFER) {
-    bufferA[indexA] = (byte) incomingByte;
-    indexA++;
+  indexA = Serial.readDatagram(bufferA, lineSizeA);
+  if (indexA > 0) {
+    statisticA.bytes += indexA;
+    statisticA.lines++;
+    startA = Serial.lineTime();
+#ifndef checkNMEA
+    LEDOn(LED_RX_A);
+#endif
+    writeDatagram();
   }
 }
 
@@ -892,7 +1690,7 @@ inline void SeaTalkInputA(int incomingByte) {
  * writing seatalk datagram.
  **/
 inline void writeDatagram() {
-  if (indexA == dataLength) {
+  if (indexA > 0) {
     dbgOutLn(SEATALK_NMEA_MESSAGE);
     strcpy_P(linedata, SEATALK_NMEA_MESSAGE);
 
@@ -921,12 +1719,31 @@ inline void NMEAInputA(int incomingByte) {
     if (in != 0x0D) {
       bufferA[indexA] = (byte) in;
       indexA++;
+#ifdef checkNMEA
+      nmeaCheckByte(&nmeaCheckA, in);
+#endif
     }
   }
-  if (endingA || (indexA >= MAX_NMEA_BUFFER)) {
-    if (indexA > 0) {
+  if (endingA || (indexA >= lineSizeA)) {
+    completeLineA();
+  }
+}
+
+/**
+ * writing the complete (or truncated) line of channel A.
+ * If the card is still busy with the last block and the line doesn't fit into the staging block,
+ * the line waits in its buffer (waitingA) and no more bytes are taken from the receive ring.
+ **/
+void completeLineA() {
+  if (indexA > 0) {
+    waitingA = !logReady(indexA + LOG_LINE_OVERHEAD);
+    if (!waitingA) {
+      statisticA.lines++;
+      if (!endingA) {
+        statisticA.truncated++;
+      }
 #ifdef debug
-      if (indexA >= MAX_NMEA_BUFFER) {
+      if (indexA >= lineSizeA) {
         Serial.print('B');
       }
       Serial.print(F("A:"));
@@ -939,18 +1756,21 @@ inline void NMEAInputA(int incomingByte) {
       Serial.println();
 #endif
       if (dataFile.isOpen()) {
+        char marker = CHANNEL_A_IDENTIFIER;
 #ifdef checkNMEA
-        if (checkNMEAData(bufferA)) {
+        if (nmeaCheckResult(&nmeaCheckA)) {
           LEDOn(LED_RX_A);
+        } else {
+          marker |= CHANNEL_INVALID_FLAG;
+          statisticA.checksumErrors++;
         }
 #endif
-        writeLEDOn();
-        writeTimeStamp(startA);
-        writeChannelMarker(CHANNEL_A_IDENTIFIER);
-        dataFile.write(bufferA, indexA);
-        dataFile.println();
+        writeLine(startA, marker, bufferA, indexA);
       }
       indexA = 0;
+#ifdef checkNMEA
+      nmeaCheckStart(&nmeaCheckA);
+#endif
     }
   }
 }
@@ -961,12 +1781,19 @@ inline void NMEAInputA(int incomingByte) {
 void testSerialB() {
   if (secondSerial) {
     outputFreeMem('2');
+    if (waitingB) {
+      completeLineB();
+      if (waitingB) {
+        return;
+      }
+    }
     endingB = false;
-    while ((mySerial.available()  > 0) && !endingB) {
+    while ((mySerial.available()  > 0) && !endingB && !waitingB) {
       int incomingByte = mySerial.read();
       if (incomingByte >= 0) {
+        statisticB.bytes++;
         if (indexB == 0) {
-          startB = millis();
+          startB = mySerial.lineTime();
         }
 #ifndef checkNMEA
         LEDOn(LED_RX_B);
@@ -989,12 +1816,29 @@ inline void NMEAInputB(int incomingByte) {
     if (in != 0x0D) {
       bufferB[indexB] = (byte) in;
       indexB++;
+#ifdef checkNMEA
+      nmeaCheckByte(&nmeaCheckB, in);
+#endif
     }
   }
-  if (endingB || (indexB >= MAX_NMEA_BUFFER)) {
-    if (indexB > 0) {
+  if (endingB || (indexB >= lineSizeB)) {
+    completeLineB();
+  }
+}
+
+/**
+ * writing the complete (or truncated) line of channel B, see completeLineA().
+ **/
+void completeLineB() {
+  if (indexB > 0) {
+    waitingB = !logReady(indexB + LOG_LINE_OVERHEAD);
+    if (!waitingB) {
+      statisticB.lines++;
+      if (!endingB) {
+        statisticB.truncated++;
+      }
 #ifdef debug
-      if (indexB >= MAX_NMEA_BUFFER) {
+      if (indexB >= lineSizeB) {
         Serial.print('B');
       }
       Serial.print(F("B:"));
@@ -1007,79 +1851,57 @@ inline void NMEAInputB(int incomingByte) {
       Serial.println();
 #endif
       if (dataFile.isOpen()) {
+        char marker = CHANNEL_B_IDENTIFIER;
 #ifdef checkNMEA
-        if (checkNMEAData(bufferB)) {
+        if (nmeaCheckResult(&nmeaCheckB)) {
           LEDOn(LED_RX_B);
+        } else {
+          marker |= CHANNEL_INVALID_FLAG;
+          statisticB.checksumErrors++;
         }
 #endif
-        writeLEDOn();
-        writeTimeStamp(startB);
-        writeChannelMarker(CHANNEL_B_IDENTIFIER);
-        dataFile.write(bufferB, indexB);
-        dataFile.println();
+        writeLine(startB, marker, bufferB, indexB);
         //        writeLEDOff();
       }
       indexB = 0;
+#ifdef checkNMEA
+      nmeaCheckStart(&nmeaCheckB);
+#endif
     }
   }
 }
 
 /**
- * checking if the NMEA Data is correct
+ * writing a new logger entry.
  **/
-bool checkNMEAData(byte* myBuffer) {
-  char* data = (char*) myBuffer;
-  if (strlen(data) == 0) {
-    return false;
-  }
-  if (data[0] != '$') {
-    return false;
-  }
-  bool inCrc = false;
-  byte crc = 0;
-  byte fileCrc = 0;
-  byte index = 0;
-  for (byte i = 1; i < strlen(data); i++) {
-    char value = data[i];
-    if ((value < 0x20) || (value > 0x80)) {
-      return false;
-    }
-    if (inCrc) {
-      if (index < 2) {
-        if (value >= '0' && value <= '9') {
-          fileCrc = value - '0';
-        }
-        if (value >= 'A' && value <= 'F') {
-          fileCrc = value - 'A';
-        }
-        if (index == 0) {
-          fileCrc = fileCrc << 4;
-        }
-        index++;
-      }
-    } else {
-      if (value != '*') {
-        crc ^= value;
-      } else {
-        inCrc = true;
-      }
+void writeData(unsigned long startTime, char marker, char* data) {
+  if (dataFile.isOpen()) {
+    if (binaryFormat) {
+      writeLEDOn();
+      byte length = strlen(data);
+      writeRecordHeader(startTime, marker | BINARY_NMEA_FLAG, length);
+      logWrite(data, length);
+      return;
     }
+    writeTimeStamp(startTime);
+    writeChannelMarker(marker);
+    writeNMEAData(data);
   }
-
-  if (fileCrc != crc) {
-    return false;
-  }
-  return true;
 }
 
 /**
- * writing a new logger entry.
+ * writing a received line of a serial channel.
  **/
-void writeData(unsigned long startTime, char marker, char* data) {
-  if (dataFile.isOpen()) {
+void writeLine(unsigned long startTime, char marker, byte* data, byte length) {
+  writeLEDOn();
+  if (binaryFormat) {
+    writeRecordHeader(startTime, marker, length);
+    logWrite(data, length);
+  } else {
     writeTimeStamp(startTime);
     writeChannelMarker(marker);
-    writeNMEAData(data);
+    logWrite(data, length);
+    logNewLine();
   }
 }
 
@@ -1087,23 +1909,16 @@ void writeData(unsigned long startTime, char marker, char* data) {
  * writing the timestamp.
  **/
 void writeTimeStamp(unsigned long time) {
-  word mil = time % 1000L;
-  long div = time / 1000L;
-
-  byte sec = div % 60L;
-  byte minute = (div / 60L) % 60L;
-  byte hour = (div / 3600L) % 24L;
-
-  sprintf_P(timedata, TIMESTAMP, hour, minute, sec, mil);
-  dataFile.print(timedata);
+  advanceTimeStamp(time);
+  logWrite(timeStampText, TIMESTAMP_LENGTH);
 }
 
 /**
  * writing the channel marker.
  **/
 void writeChannelMarker(char marker) {
-  dataFile.print(marker);
-  dataFile.print(';');
+  logWriteByte(marker);
+  logWriteByte(';');
 }
 
 /**
@@ -1111,17 +1926,15 @@ void writeChannelMarker(char marker) {
  **/
 void writeNMEAData(char* data) {
   writeLEDOn();
-  byte crc = 0;
-  for (byte i = 0; i < strlen(data); i++) {
-    crc ^= data[i];
-  }
-  dataFile.write('$');
-  dataFile.print(data);
-  dataFile.write('*');
-  if (crc < 16) {
-    dataFile.write('0');
-  }
-  dataFile.println(crc, HEX);
+  byte crc = nmeaChecksum(data);
+  logWriteByte('$');
+  logWrite(data, strlen(data));
+  logWriteByte('*');
+  byte c = (crc & 0xF0) >> 4;
+  logWriteByte(convertNibble2Hex(c));
+  c = crc & 0x0F;
+  logWriteByte(convertNibble2Hex(c));
+  logNewLine();
 #ifdef debug
   dbgOut('$');
   dbgOut(data);
@@ -1131,4 +1944,69 @@ void writeNMEAData(char* data) {
   }
   dbgOutLn2(crc, HEX);
 #endif
-}
+}
+
+/*********************************/
+/*      Binary data file         */
+/*********************************/
+unsigned long lastRecordTime;
+
+/**
+ * writing the id of the binary data file, must be the first data of a new file.
+ **/
+void writeFileHeader() {
+  if (binaryFormat && dataFile.isOpen()) {
+    lastRecordTime = 0;
+    strcpy_P(linedata, BINARY_FILE_ID);
+    linedata[4] = BINARY_FILE_VERSION;
+    logWrite(linedata, 5);
+  }
+}
+
+/**
+ * writing the header of a binary record: time delta, channel and length of the payload.
+ **/
+void writeRecordHeader(unsigned long time, byte channel, byte length) {
+  byte header[MAX_VARINT_LENGTH + 2];
+  byte pos = encodeTimeDelta(header, time - lastRecordTime);
+  lastRecordTime = time;
+  header[pos++] = channel;
+  header[pos++] = length;
+  logWrite(header, pos);
+}
+
+/**
+ * writing the x, y, z values of the gyro as a binary record.
+ **/
+void writeAxisRecord(unsigned long time, byte record) {
+  if (dataFile.isOpen()) {
+    writeRecordHeader(time, record, 6);
+    logWrite(&ax, 2);
+    logWrite(&ay, 2);
+    logWrite(&az, 2);
+  }
+}
+
+/*********************************/
+/*         Block writer          */
+/*********************************/
+
+/**
+ * creating the data file with the actual filename.
+ * First try to create a contiguous file for the block writer (blockwriter.h), if this fails, use a normal file.
+ **/
+void openDataFile() {
+  resetBlockWriter();
+#ifdef preallocateFile
+  if (dataFile.createContiguous(sd.vwd(), filename, preallocateSize)) {
+    // the free count and the hint are right again, also after a power fail (the preallocated clusters stay in use)
+    saveAllocHint();
+    if (!startBlockWriter()) {
+      // no block writer possible, so use this file the normal way
+      dataFile.truncate(0);
+    }
+    return;
+  }
+#endif
+  dataFile.open(filename, O_RDWR | O_CREAT | O_AT_END);
+}
@@ -0,0 +1,235 @@
+/**
+ * Block writer: All data of the data file is collected in one 512 byte staging block. This block is only written
+ * to the card, if it's full. The data file is created as a contiguous file, so the blocks are streamed
+ * directly to the card (multi block write with pre erase), without any FAT access while logging.
+ * The size in the directory entry is 0 after the start and set by every checkpoint (syncDataFile()), so after
+ * a crash the file ends at the last checkpoint and not with the zeros of the preallocated rest.
+ * As staging block we use the cache of the sd volume, so no additional RAM is needed.
+ * Because of this NO other SdFat calls are allowed while the block writer is active.
+ * The same code runs in the logger and on the emulated card of Tools/sdemu, so the includer defines
+ * sd, dataFile and error, includes SdFat.h first and creates the file itself before startBlockWriter().
+ **/
+extern SdFat sd;
+extern SdFile dataFile;
+extern boolean error;
+
+uint8_t* blockData;
+word blockIndex;
+uint32_t firstBlock, actBlock, lastBlock;
+boolean blockWriter = false;
+boolean blockStreaming = false;
+// first block of the running multi block write and the pre erase count of the next one, 0 = rest of the file
+uint32_t streamBlock;
+uint32_t preEraseCount;
+// the card may still program the last block, it's only asked again near the end of the staging block (logReady)
+boolean cardBusy = false;
+// max. time needed for writing one block (in µs)
+unsigned long maxBlockTime;
+
+/**
+ * resetting the state for a new data file.
+ **/
+void resetBlockWriter() {
+  blockWriter = false;
+  blockStreaming = false;
+  cardBusy = false;
+  maxBlockTime = 0;
+  firstBlock = 0;
+  actBlock = 0;
+  preEraseCount = 0;
+}
+
+/**
+ * starting the multi block write at actBlock. The rest of the file is pre erased with the start of the file,
+ * so the card erases it while the logger doesn't wait for data yet. After a checkpoint only the blocks of
+ * the last stream are pre erased, about the blocks until the next checkpoint.
+ **/
+void startDataStream() {
+  uint32_t count = lastBlock - actBlock + 1;
+  if ((preEraseCount > 0) && (preEraseCount < count)) {
+    count = preEraseCount;
+  }
+  if (!sd.card()->writeStart(actBlock, count)) {
+    error = true;
+  }
+  streamBlock = actBlock;
+  blockStreaming = true;
+}
+
+/**
+ * starting the block writer on the just created contiguous dataFile.
+ * false, if the file isn't contiguous or the cache isn't free, then the file must be used the normal way.
+ **/
+boolean startBlockWriter() {
+  if (dataFile.contiguousRange(&firstBlock, &lastBlock)) {
+    // the last cluster can be longer than the file, the block writer stays inside the file
+    lastBlock = firstBlock + (dataFile.fileSize() >> 9) - 1;
+    // nothing is written yet, the clusters stay with the file
+    if (!dataFile.setSize(0)) {
+      return false;
+    }
+    cache_t* cache = sd.vol()->cacheClear();
+    if (cache) {
+      blockData = cache->data;
+      blockIndex = 0;
+      actBlock = firstBlock;
+      blockWriter = true;
+      startDataStream();
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * writing the full staging block to the sd card.
+ **/
+void writeDataBlock() {
+  unsigned long blockTime = micros();
+  if (!blockStreaming) {
+    startDataStream();
+  }
+  if (!sd.card()->writeData(blockData)) {
+    error = true;
+  }
+  cardBusy = true;
+  blockTime = micros() - blockTime;
+  if (blockTime > maxBlockTime) {
+    maxBlockTime = blockTime;
+  }
+  blockIndex = 0;
+  actBlock++;
+  if (actBlock > lastBlock) {
+    // preallocated space is used up, continue writing at the end of the file the normal way.
+    sd.card()->writeStop();
+    blockStreaming = false;
+    blockWriter = false;
+    // without the rest of the last block, if the preallocated size isn't a multiple of 512,
+    // the normal writes continue in the rest of the last cluster
+    dataFile.setSize((actBlock - firstBlock) << 9);
+    dataFile.seekEnd();
+  }
+}
+
+/**
+ * writing the partial staging block to the sd card, so all data until now is on the card.
+ * The rest of the block is filled with 0. The next full write will overwrite this block again.
+ **/
+void syncDataBlock() {
+  if (blockStreaming) {
+    if (!sd.card()->writeStop()) {
+      error = true;
+    }
+    blockStreaming = false;
+    preEraseCount = actBlock - streamBlock + 1;
+  }
+  if (blockIndex > 0) {
+    memset(blockData + blockIndex, 0, 512 - blockIndex);
+    if (!sd.card()->writeBlock(actBlock, blockData)) {
+      error = true;
+    }
+  }
+}
+
+/**
+ * checkpoint of the data file: the partial staging block and the size in the directory entry are written,
+ * the file on the card is complete up to here. The directory entry goes through the cache, so the partial
+ * staging block is read back from the card afterwards.
+ **/
+void syncDataFile() {
+  if (!blockWriter) {
+    dataFile.sync();
+    return;
+  }
+  syncDataBlock();
+  if (!dataFile.setSize(((actBlock - firstBlock) << 9) + blockIndex)) {
+    error = true;
+  }
+  cache_t* cache = sd.vol()->cacheClear();
+  if (!cache) {
+    error = true;
+    return;
+  }
+  blockData = cache->data;
+  if ((blockIndex > 0) && !sd.card()->readBlock(actBlock, blockData)) {
+    error = true;
+  }
+}
+
+/**
+ * closing the data file. A preallocated file will be truncated to the real data size.
+ **/
+void closeDataFile() {
+  if (blockWriter) {
+    syncDataBlock();
+    blockWriter = false;
+    uint32_t size = ((actBlock - firstBlock) << 9) + blockIndex;
+    // the size in the directory entry is the one of the last checkpoint
+    dataFile.setSize(size);
+    dataFile.truncate(size);
+  }
+  dataFile.close();
+}
+
+/**
+ * can count bytes be written without waiting for the card?
+ * Yes, if they fit into the staging block or the card has finished programming the last block.
+ * writeDataBlock() waits for the card itself, so this is only needed by the tasks, which can wait in the loop.
+ **/
+boolean logReady(word count) {
+  if (!blockStreaming || !cardBusy || (blockIndex + count < 512)) {
+    return true;
+  }
+  cardBusy = sd.card()->isBusy();
+  return !cardBusy;
+}
+
+/**
+ * writing data to the data file.
+ **/
+void logWrite(const void* data, byte count) {
+  if (!blockWriter) {
+    dataFile.write(data, count);
+    return;
+  }
+  const uint8_t* src = (const uint8_t*) data;
+  while (count > 0) {
+    word n = 512 - blockIndex;
+    if (n > count) {
+      n = count;
+    }
+    memcpy(blockData + blockIndex, src, n);
+    blockIndex += n;
+    src += n;
+    count -= n;
+    if (blockIndex == 512) {
+      writeDataBlock();
+      if (!blockWriter) {
+        dataFile.write(src, count);
+        return;
+      }
+    }
+  }
+}
+
+/**
+ * writing one byte to the data file.
+ **/
+void logWriteByte(char value) {
+  if (!blockWriter) {
+    dataFile.write(value);
+    return;
+  }
+  blockData[blockIndex++] = value;
+  if (blockIndex == 512) {
+    writeDataBlock();
+  }
+}
+
+/**
+ * writing CR LF to the data file.
+ **/
+inline void logNewLine() {
+  logWriteByte(0x0D);
+  logWriteByte(0x0A);
+}
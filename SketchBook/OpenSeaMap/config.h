@@ -5,7 +5,7 @@
 // SD Card
 const byte SD_CHIPSELECT = 10;
 // NMEA Baudrates
-const int BAUDRATES[] = {
+const word BAUDRATES[] = {
   0, 1200, 2400, 4800, 9600, 19200, 38400
 };
 // NMEA 0183 Port B
@@ -33,11 +33,50 @@ const byte SW_STOP = 3; // PD3
 const int VCC_GOLDCAP = 200;
 
 const long GOLDCAP_LOADING_TIME = 30000L;
+// scale and time constant (in conversions, about 1 ms each) of the average of the supply monitor
+const byte VCC_FILTER_SAMPLES = 4;
 // sopme debug strings
 const String vccString = "VCC:";
 
 const char CONFIG_FILE[] = "config.dat";
 
+// min. size of the preallocated contiguous data file, the real size depends on the baudrates (one hour of data)
+const unsigned long PREALLOCATE_MIN_SIZE = 1024UL * 1024UL;
+// flush interval of the data file in seconds
+const byte DEFAULT_FLUSH_INTERVAL = 60;
+const byte MAX_FLUSH_INTERVAL = 250;
+
+// bytes per second for the internal messages (gyro, vcc...)
+const word INTERNAL_BYTES_PER_SECOND = 100;
+
+// high rate motion logging with the MPU6050 FIFO, samples per second (0 = gyro/acc once a second)
+const byte MIN_MOTION_RATE = 4;
+const byte MAX_MOTION_RATE = 100;
+// reading the FIFO every 100 ms, the FIFO (1024 bytes) holds 85 samples, 850 ms at 100 Hz
+const word MOTION_READ_INTERVAL = 100;
+const word MOTION_FIFO_SIZE = 1024;
+// samples in one I2C transfer, one binary record per transfer (2 buffers in RAM)
+const byte MOTION_BURST_SAMPLES = 3;
+
+// bytes written for one gyro read at most (3 motion lines in text format)
+const word GYRO_WRITE_RESERVE = 210;
+// max. time of one gyro transfer in ms (max. 36 bytes, about 4 ms at 100 kHz), after that the TWI is reset
+const byte GYRO_TIMEOUT = 20;
+
+// states of the asynchronous gyro reading
+const byte GYRO_IDLE = 0;
+const byte GYRO_AXES = 1;
+const byte GYRO_COUNT = 2;
+const byte GYRO_SAMPLES = 3;
+
+// receive buffers and line buffers of both channels (was 128 + 16 hardware serial, 80 AltSoftSerial, 2 * 80 line buffers)
+// 38400 baud on channel A alone gets the full ring of 255 bytes (66 ms), 4800/4800 rings of 112 bytes.
+const word RX_ARENA_SIZE = 384;
+// max. size of one receive ring (8 bit indices)
+const word MAX_RX_RING_SIZE = 255;
+// bytes of a text line beside the data: timestamp, channel marker, $ and checksum (internal messages), CR LF
+const byte LOG_LINE_OVERHEAD = 21;
+
 // EEPROM storage positions
 const word EEPROM_BAUD_A = 0x0010;
 const word EEPROM_BAUD_B = 0x0011;
@@ -45,6 +84,12 @@ const word EEPROM_SEATALK = 0x0012;
 const word EEPROM_OUTPUT = 0x0013;
 const word EEPROM_VESSELID = 0x0014;// (-17) 4 bytes
 const word EEPROM_BOOTLOADER_VERSION = 0x0019;// 1 byte
+const word EEPROM_FLUSH_INTERVAL = 0x001A;// 1 byte
+const word EEPROM_MOTION_RATE = 0x001D;// 1 byte
+const word EEPROM_ATTITUDE_RATE = 0x001E;// 1 byte
+const word EEPROM_SHUTDOWN_TIME = 0x001F;// (-22) 4 bytes, µs of the last power fail shutdown, 0xFFFFFFFF = none
+const word EEPROM_SHUTDOWN_VCC = 0x0023;// (-26) 2 * 2 bytes, voltage before and after the shutdown
+const word EEPROM_ALLOC_HINT = 0x0027;// (-28) 2 bytes, next free cluster of a FAT16 card
 
 const word EEPROM_VERSION = E2END - 2;
 
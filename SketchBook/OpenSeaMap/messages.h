@@ -4,22 +4,36 @@
 #define VERSIONNUMBER 15
 #define VERSION PSTR("V 0.1.15")
 #define START_MESSAGE PSTR("POSMST,Start NMEA Logger,V 0.1.15")
-#define CONFIG_MESSAGE PSTR("POSMCFG,%u,%u,%u,%u,%x,%u")
+#define CONFIG_MESSAGE PSTR("POSMCFG,%u,%u,%u,%u,%lx,%u,%u,%u,%u")
 #define STOP_MESSAGE PSTR("POSMSO,Stop NMEA Logger")
 #define REASON_TIME_MESSAGE PSTR("POSMSO,Reason: times up")
 //#define REASON_NODATA_MESSAGE PSTR("POSMSO,Reason: no data file")
 #define REASON_VCC_MESSAGE PSTR("POSMSO,Reason: supply low")
+// last power fail: time in µs until the data file was consistent, voltage in mV before and after
+#define POWERFAIL_MESSAGE PSTR("POSMPF,%lu,%u,%u")
 #define REASON_SWITCH_MESSAGE PSTR("POSMSO,Reason: stop switch")
 #define COMMENT_MESSAGE PSTR("POSCOM,")
 
 // voltage message, value is voltage in mV
 #define VCC_MESSAGE PSTR("POSMVCC,%i,%i")
+// statistic of a serial channel since start: channel, received bytes, lines, checksum errors, truncated lines,
+// bytes lost in the receive buffer, dropped seatalk datagrams
+#define STAT_MESSAGE PSTR("POSMSTAT,%c,%lu,%lu,%u,%u,%u,%u")
+// task of the main loop, max. runtime in µs, missed deadlines (every minute)
+#define TASK_MESSAGE PSTR("POSMTSK,%u,%lu,%u")
+// free RAM in bytes between the variables and the deepest stack since the start (every minute, only on the avr)
+#define RAM_MESSAGE PSTR("POSMRAM,%u")
+// block writer, count of written blocks, max. write time of one block in µs
+#define BLOCK_MESSAGE PSTR("POSMBLK,%lu,%lu")
 // gyroscope x,y,z axis
 #define GYRO_MESSAGE PSTR("POSMGYR,%i,%i,%i")
 // accelerator, x,y,z axis
 #define ACC_MESSAGE PSTR("POSMACC,%i,%i,%i")
-// timestamp in format hh:mm:ss.SSS
-#define TIMESTAMP PSTR("%02d:%02d:%02d.%03u;")
+// motion sample of the high rate mode, acc x,y,z, gyro x,y,z
+#define MOTION_MESSAGE PSTR("POSMMOT,%i,%i,%i,%i,%i,%i")
+// attitude from the motion samples, roll and pitch in 1/10 degree, heave in cm
+#define ATTITUDE_MESSAGE PSTR("POSMATT,%i,%i,%i")
+// timestamp in format hh:mm:ss.SSS; is build by advanceTimeStamp() (osmfunctions.h)
 // seatalk start, the datagram follows in hex
 #define SEATALK_NMEA_MESSAGE PSTR("POSMSK,")
 #define MAX_NMEA_BUFFER 80
@@ -30,4 +44,22 @@
 #define CHANNEL_A_IDENTIFIER 'A'
 #define CHANNEL_B_IDENTIFIER 'B'
 #define CHANNEL_I_IDENTIFIER 'I'
+// lower case channel marker: the NMEA check of this line failed (only with checkNMEA)
+#define CHANNEL_INVALID_FLAG 0x20
+
+// binary data file, starts with the id and the version
+#define BINARY_FILE_ID PSTR("OSMB")
+#define BINARY_FILE_VERSION 1
+// channel with this flag: payload is a message of the logger without $ and checksum
+#define BINARY_NMEA_FLAG 0x80
+// fixed size records of the logger, x,y,z axis as 16 bit little endian
+#define BINARY_GYRO_RECORD 'g'
+#define BINARY_ACC_RECORD 'c'
+// voltage and norm voltage as 16 bit little endian
+#define BINARY_VCC_RECORD 'v'
+// motion samples of the high rate mode: rate, then samples of MOTION_SAMPLE_SIZE bytes like they come from the FIFO.
+// The record time is the time of the last sample.
+#define BINARY_MOTION_RECORD 'm'
+// roll, pitch, heave like ATTITUDE_MESSAGE as 16 bit little endian
+#define BINARY_ATTITUDE_RECORD 't'
 
@@ -0,0 +1,635 @@
+/**
+ * Hardware independent helper functions of the logger.
+ * Nothing in here may touch the ports, the serials or the sd card,
+ * so these functions can be compiled and checked on a PC, too.
+ * This is a header and no .c file, because the Arduino IDE compiles every .c file of the sketch folder
+ * a second time on its own as C.
+ **/
+#include <inttypes.h>
+#include <string.h>
+
+/**
+ * my strcat function.
+ **/
+void strcat(char* original, char appended)
+{
+  while (*original++)
+    ;
+  *original--;
+  *original = appended;
+  *original++;
+  *original = '\0';
+}
+
+/**
+ * calculating the NMEA checksum (xor of all characters) of a datagram without $ and *.
+ **/
+uint8_t nmeaChecksum(const char* data)
+{
+  uint8_t crc = 0;
+  while (*data) {
+    crc ^= *data++;
+  }
+  return crc;
+}
+
+/**
+ * value of a hex digit, -1 if it's not a hex digit.
+ **/
+int8_t hexDigitValue(uint8_t value) {
+  if (value >= '0' && value <= '9') {
+    return value - '0';
+  }
+  if (value >= 'A' && value <= 'F') {
+    return value - 'A' + 10;
+  }
+  if (value >= 'a' && value <= 'f') {
+    return value - 'a' + 10;
+  }
+  return -1;
+}
+
+/**
+ * checking if the NMEA Data is correct.
+ * The sentence must start with $, only printable characters are allowed and the xor of all characters
+ * between $ and * must be the value of the 2 hex digits after the *, which end the sentence.
+ **/
+bool checkNMEAData(const uint8_t* data, uint16_t length) {
+  if ((length < 4) || (data[0] != '$')) {
+    return false;
+  }
+  uint8_t crc = 0;
+  uint16_t i = 1;
+  for (; i < length; i++) {
+    uint8_t value = data[i];
+    if ((value < 0x20) || (value > 0x7F)) {
+      return false;
+    }
+    if (value == '*') {
+      break;
+    }
+    crc ^= value;
+  }
+  if ((i + 3) != length) {
+    return false;
+  }
+  int8_t high = hexDigitValue(data[i + 1]);
+  int8_t low = hexDigitValue(data[i + 2]);
+  if ((high < 0) || (low < 0)) {
+    return false;
+  }
+  return (uint8_t) ((high << 4) | low) == crc;
+}
+
+/**
+ * streaming check of a NMEA sentence with the rules of checkNMEAData(), one call per received byte.
+ * The xor is calculated while the bytes arrive, the 2 hex digits after the * are xored into it, too.
+ * So after the last byte the sentence is ok, if the state is done and the xor is 0.
+ **/
+#define NMEA_CHECK_START 0
+#define NMEA_CHECK_DATA 1
+#define NMEA_CHECK_HIGH 2
+#define NMEA_CHECK_LOW 3
+#define NMEA_CHECK_DONE 4
+#define NMEA_CHECK_ERROR 5
+
+struct NMEACheck {
+  uint8_t state;
+  uint8_t crc;
+};
+
+/**
+ * starting the check of a new sentence.
+ **/
+inline void nmeaCheckStart(NMEACheck* check) {
+  check->state = NMEA_CHECK_START;
+  check->crc = 0;
+}
+
+/**
+ * checking the next byte of the sentence.
+ **/
+void nmeaCheckByte(NMEACheck* check, uint8_t value) {
+  int8_t digit;
+  switch (check->state) {
+    case NMEA_CHECK_START:
+      check->state = value == '$' ? NMEA_CHECK_DATA : NMEA_CHECK_ERROR;
+      break;
+    case NMEA_CHECK_DATA:
+      if ((value < 0x20) || (value > 0x7F)) {
+        check->state = NMEA_CHECK_ERROR;
+      } else if (value == '*') {
+        check->state = NMEA_CHECK_HIGH;
+      } else {
+        check->crc ^= value;
+      }
+      break;
+    case NMEA_CHECK_HIGH:
+    case NMEA_CHECK_LOW:
+      digit = hexDigitValue(value);
+      if (digit < 0) {
+        check->state = NMEA_CHECK_ERROR;
+      } else if (check->state == NMEA_CHECK_HIGH) {
+        check->crc ^= digit << 4;
+        check->state = NMEA_CHECK_LOW;
+      } else {
+        check->crc ^= digit;
+        check->state = NMEA_CHECK_DONE;
+      }
+      break;
+    case NMEA_CHECK_DONE:
+      // nothing allowed after the checksum
+      check->state = NMEA_CHECK_ERROR;
+      break;
+  }
+}
+
+/**
+ * result of the check after the last byte of the sentence.
+ **/
+inline bool nmeaCheckResult(const NMEACheck* check) {
+  return (check->state == NMEA_CHECK_DONE) && (check->crc == 0);
+}
+
+/**
+ * incremental timestamp in the format hh:mm:ss.SSS;
+ * The digits are held as ascii characters. For every new timestamp only the
+ * millis delta to the previous one is added digit by digit,
+ * so there are no 32 bit divisions and no sprintf needed for every line.
+ **/
+#define TIMESTAMP_LENGTH 13
+char timeStampText[TIMESTAMP_LENGTH + 1] = "00:00:00.000;";
+uint32_t timeStampMillis = 0;
+
+/**
+ * adding a value to one digit of the timestamp, returning the carry for the next digit.
+ **/
+uint8_t addTimeDigit(uint8_t pos, uint8_t value, char maxDigit) {
+  uint8_t carry = 0;
+  char digit = timeStampText[pos] + value;
+  while (digit > maxDigit) {
+    digit -= maxDigit - '0' + 1;
+    carry++;
+  }
+  timeStampText[pos] = digit;
+  return carry;
+}
+
+/**
+ * subtracting a value from one digit of the timestamp, returning the borrow from the next digit.
+ **/
+uint8_t subTimeDigit(uint8_t pos, uint8_t value, char maxDigit) {
+  uint8_t borrow = 0;
+  char digit = timeStampText[pos] - value;
+  while (digit < '0') {
+    digit += maxDigit - '0' + 1;
+    borrow++;
+  }
+  timeStampText[pos] = digit;
+  return borrow;
+}
+
+/**
+ * writing a 2 digit value into the timestamp.
+ **/
+void setTimeDigits(uint8_t pos, uint8_t value) {
+  uint8_t tens = 0;
+  while (value >= 10) {
+    value -= 10;
+    tens++;
+  }
+  timeStampText[pos] = tens + '0';
+  timeStampText[pos + 1] = value + '0';
+}
+
+/**
+ * setting the timestamp to the given time the expensive way.
+ * The calculation is done with 32 bit, so there is no overrun at 18 hours. 
+ * Hours will start with 0 after 24 hours.
+ **/
+void setTimeStamp(uint32_t time) {
+  uint16_t mil = time % 1000L;
+  uint32_t div = time / 1000L;
+
+  setTimeDigits(0, (div / 3600L) % 24L);
+  setTimeDigits(3, (div / 60L) % 60L);
+  setTimeDigits(6, div % 60L);
+  timeStampText[9] = (mil / 100) + '0';
+  setTimeDigits(10, mil % 100);
+  timeStampMillis = time;
+}
+
+/**
+ * moving the timestamp back by less than a minute, split into seconds and the digits of the millis.
+ * The digits borrow like they carry forward, hours 00 go back to 23.
+ **/
+void retreatTimeStamp(uint8_t seconds, uint8_t hundreds, uint8_t tens, uint8_t ones) {
+  uint8_t borrow = subTimeDigit(11, ones, '9');
+  borrow = subTimeDigit(10, tens + borrow, '9');
+  borrow = subTimeDigit(9, hundreds + borrow, '9');
+
+  // seconds
+  seconds += borrow;
+  tens = 0;
+  while (seconds >= 10) {
+    seconds -= 10;
+    tens++;
+  }
+  borrow = subTimeDigit(7, seconds, '9');
+  borrow = subTimeDigit(6, tens + borrow, '5');
+  if (borrow == 0) {
+    return;
+  }
+
+  // minutes
+  borrow = subTimeDigit(4, borrow, '9');
+  borrow = subTimeDigit(3, borrow, '5');
+  if (borrow == 0) {
+    return;
+  }
+
+  // hours
+  if ((timeStampText[0] == '0') && (timeStampText[1] == '0')) {
+    timeStampText[0] = '2';
+    timeStampText[1] = '3';
+    return;
+  }
+  borrow = subTimeDigit(1, borrow, '9');
+  subTimeDigit(0, borrow, '9');
+}
+
+/**
+ * advancing the timestamp to the given time.
+ * A time up to a minute before the last timestamp is a step back (a line of the other channel, which started
+ * before the last one was written). If the time is more than a minute away, the timestamp will be calculated new.
+ **/
+void advanceTimeStamp(uint32_t time) {
+  bool back = time < timeStampMillis;
+  uint32_t distance = back ? timeStampMillis - time : time - timeStampMillis;
+  if (distance >= 60000L) {
+    setTimeStamp(time);
+    return;
+  }
+  uint16_t delta = distance;
+  timeStampMillis = time;
+
+  uint8_t seconds = 0;
+  while (delta >= 1000) {
+    delta -= 1000;
+    seconds++;
+  }
+  uint8_t hundreds = 0;
+  while (delta >= 100) {
+    delta -= 100;
+    hundreds++;
+  }
+  uint8_t tens = 0;
+  while (delta >= 10) {
+    delta -= 10;
+    tens++;
+  }
+  if (back) {
+    retreatTimeStamp(seconds, hundreds, tens, delta);
+    return;
+  }
+
+  // milliseconds
+  uint8_t carry = addTimeDigit(11, delta, '9');
+  carry = addTimeDigit(10, tens + carry, '9');
+  carry = addTimeDigit(9, hundreds + carry, '9');
+
+  // seconds
+  seconds += carry;
+  tens = 0;
+  while (seconds >= 10) {
+    seconds -= 10;
+    tens++;
+  }
+  carry = addTimeDigit(7, seconds, '9');
+  carry = addTimeDigit(6, tens + carry, '5');
+  if (carry == 0) {
+    return;
+  }
+
+  // minutes
+  carry = addTimeDigit(4, carry, '9');
+  carry = addTimeDigit(3, carry, '5');
+  if (carry == 0) {
+    return;
+  }
+
+  // hours, starting with 00 after 23
+  carry = addTimeDigit(1, carry, '9');
+  addTimeDigit(0, carry, '9');
+  if ((timeStampText[0] > '2') || ((timeStampText[0] == '2') && (timeStampText[1] >= '4'))) {
+    timeStampText[0] -= 2;
+    timeStampText[1] -= 4;
+  }
+}
+
+/**
+ * binary data file: every record starts with the millis delta to the record before as zigzag varint,
+ * so timestamps a little bit in the past (line started before the last record) are small values, too.
+ * The varint is written in 7 bit groups, lowest group first, bit 7 set if another group follows.
+ * 32 bit need max. 5 bytes.
+ **/
+#define MAX_VARINT_LENGTH 5
+
+uint8_t encodeTimeDelta(uint8_t* dest, int32_t delta) {
+  uint32_t value = ((uint32_t) delta << 1) ^ (uint32_t) (delta >> 31);
+  uint8_t pos = 0;
+  while (value >= 0x80) {
+    dest[pos++] = (value & 0x7F) | 0x80;
+    value >>= 7;
+  }
+  dest[pos++] = value;
+  return pos;
+}
+
+/**
+ * decoding a time delta, returning the count of used bytes, 0 if the varint isn't complete.
+ **/
+uint8_t decodeTimeDelta(const uint8_t* src, uint8_t size, int32_t* delta) {
+  uint32_t value = 0;
+  for (uint8_t pos = 0; (pos < size) && (pos < MAX_VARINT_LENGTH); pos++) {
+    value |= (uint32_t) (src[pos] & 0x7F) << (7 * pos);
+    if ((src[pos] & 0x80) == 0) {
+      *delta = (int32_t) (value >> 1) ^ -(int32_t) (value & 1);
+      return pos + 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * motion samples of the MPU6050 FIFO: acc x, y, z, gyro x, y, z, each 16 bit big endian.
+ * A batch of samples gets the time of the last sample, every sample before is 1000 / rate ms earlier.
+ **/
+#define MOTION_SAMPLE_SIZE 12
+
+int16_t motionValue(const uint8_t* sample, uint8_t axis) {
+  return (int16_t) ((sample[axis * 2] << 8) | sample[axis * 2 + 1]);
+}
+
+uint32_t motionSampleTime(uint32_t time, uint8_t rate, uint8_t before) {
+  return time - ((uint32_t) before * 1000) / rate;
+}
+
+/**
+ * integer square root.
+ **/
+uint16_t isqrt32(uint32_t value) {
+  uint32_t result = 0;
+  uint32_t bit = 1UL << 30;
+  while (bit > value) {
+    bit >>= 2;
+  }
+  while (bit != 0) {
+    if (value >= result + bit) {
+      value -= result + bit;
+      result = (result >> 1) + bit;
+    } else {
+      result >>= 1;
+    }
+    bit >>= 2;
+  }
+  return (uint16_t) result;
+}
+
+/**
+ * atan2 in 1/100 degree (-18000..18000).
+ * atan(z) = z * (45 + (1 - z) * (14.02 + 3.80 * z)) degree for 0 <= z <= 1 (z as Q15), max. error about 0.1 degree.
+ **/
+int16_t iatan2(int32_t y, int32_t x) {
+  uint32_t ux = x < 0 ? -x : x;
+  uint32_t uy = y < 0 ? -y : y;
+  if ((ux == 0) && (uy == 0)) {
+    return 0;
+  }
+  bool swapped = uy > ux;
+  int32_t z = swapped ? (ux << 15) / uy : (uy << 15) / ux;
+  int32_t t = 1402 + ((380 * z) >> 15);
+  int32_t u = ((32768 - z) * t) >> 15;
+  int16_t angle = (z * (4500 + u)) >> 15;
+  if (swapped) {
+    angle = 9000 - angle;
+  }
+  if (x < 0) {
+    angle = 18000 - angle;
+  }
+  return y < 0 ? -angle : angle;
+}
+
+/**
+ * sine of 1/100 degree (-18000..18000) as Q14, Bhaskara approximation, max. error about 0.002.
+ **/
+int16_t isin(int32_t angle) {
+  bool negative = angle < 0;
+  if (negative) {
+    angle = -angle;
+  }
+  int32_t p = angle * (18000 - angle);
+  int16_t value = (4 * p) / ((405000000L - p) >> 14);
+  return negative ? -value : value;
+}
+
+int16_t icos(int32_t angle) {
+  angle += 9000;
+  if (angle > 18000) {
+    angle -= 36000;
+  }
+  return isin(angle);
+}
+
+/**
+ * attitude of the logger from the motion samples: complementary filter of roll and pitch,
+ * heave from the acceleration in the up direction of roll and pitch, integrated twice with leaky (high pass)
+ * integrators. The mean of the vertical acceleration (gravity, offset of the sensor) is removed first.
+ * Everything is fixed point, raw values for 2g (16384 = 1g) and 250 degree/s (131 = 1 degree/s).
+ * A constant error of the vertical acc is multiplied by the square of the leak time in the heave,
+ * so the heave part rounds instead of truncating and keeps enough fraction bits, that the leak of
+ * 1 / 2^leak doesn't stop at a small value (gravity 0.0001 g, velocity 0.25 mm/s).
+ * roll, pitch: 1/100 degree * 256; gravity: mean vertical acc, raw * 1024;
+ * velocity: mm/s * 4096; heave: mm * 4096
+ **/
+struct Attitude {
+  int32_t roll;
+  int32_t pitch;
+  int32_t gravity;
+  int32_t velocity;
+  int32_t heave;
+  int32_t gyroScale;
+  int32_t accScale;
+  uint8_t rate;
+  uint8_t shift;
+  uint8_t leak;
+  bool started;
+};
+
+// value / 2^shift, rounded
+int32_t roundShift(int32_t value, uint8_t shift) {
+  return (value + (1L << (shift - 1))) >> shift;
+}
+
+// floor(log2(value))
+uint8_t log2floor(uint16_t value) {
+  uint8_t bits = 0;
+  while (value > 1) {
+    value >>= 1;
+    bits++;
+  }
+  return bits;
+}
+
+/**
+ * starting the filter for samples with rate per second.
+ * The acc correction of the angles takes 1 / 2^shift per sample (0.5..1 s),
+ * the mean of the vertical acc and the leak of the heave integrators 1 / 2^leak per sample (20..40 s).
+ **/
+void attitudeStart(Attitude* attitude, uint8_t rate) {
+  memset(attitude, 0, sizeof(Attitude));
+  attitude->rate = rate;
+  // raw gyro -> 1/100 degree * 256 per sample, Q8
+  attitude->gyroScale = 6553600UL / (131UL * rate);
+  // raw acc / 4 * 16 -> mm/s * 4096 per sample, Q6 (9807 mm/s2 = 4096 * 16)
+  attitude->accScale = (9807UL * 4UL) / rate;
+  attitude->shift = log2floor(rate);
+  attitude->leak = log2floor(32 * rate);
+}
+
+/**
+ * one sample of the FIFO (acc x,y,z, gyro x,y,z).
+ **/
+void attitudeUpdate(Attitude* attitude, const uint8_t* sample) {
+  int32_t acc[3];
+  for (uint8_t i = 0; i < 3; i++) {
+    acc[i] = motionValue(sample, i);
+  }
+  int32_t accRoll = (int32_t) iatan2(acc[1], acc[2]) << 8;
+  int32_t accPitch = (int32_t) iatan2(-acc[0], isqrt32((uint32_t) (acc[1] * acc[1]) + (uint32_t) (acc[2] * acc[2]))) << 8;
+
+  if (!attitude->started) {
+    attitude->roll = accRoll;
+    attitude->pitch = accPitch;
+    attitude->gravity = 16384L << 10;
+    attitude->started = true;
+    return;
+  }
+
+  attitude->roll += ((int32_t) motionValue(sample, 3) * attitude->gyroScale) >> 8;
+  attitude->pitch += ((int32_t) motionValue(sample, 4) * attitude->gyroScale) >> 8;
+  // roll wraps at 180 degree, the acc angle may be on the other side
+  int32_t difference = accRoll - attitude->roll;
+  if (difference > (18000L << 8)) {
+    difference -= 36000L << 8;
+  } else if (difference < -(18000L << 8)) {
+    difference += 36000L << 8;
+  }
+  attitude->roll += difference >> attitude->shift;
+  attitude->pitch += (accPitch - attitude->pitch) >> attitude->shift;
+  if (attitude->roll > (18000L << 8)) {
+    attitude->roll -= 36000L << 8;
+  } else if (attitude->roll < -(18000L << 8)) {
+    attitude->roll += 36000L << 8;
+  }
+
+  // vertical acceleration: acc in the up direction (raw * Q14 -> raw * 1024) minus its mean (raw / 4 * 16)
+  int16_t roll = attitude->roll >> 8;
+  int16_t pitch = attitude->pitch >> 8;
+  int32_t cosPitch = icos(pitch);
+  int32_t up = -acc[0] * isin(pitch);
+  up += acc[1] * roundShift((int32_t) isin(roll) * cosPitch, 14);
+  up += acc[2] * roundShift((int32_t) icos(roll) * cosPitch, 14);
+  up = roundShift(up, 4);
+  attitude->gravity += roundShift(up - attitude->gravity, attitude->leak);
+  int32_t vertical = roundShift(up - attitude->gravity, 8);
+
+  attitude->velocity += roundShift(vertical * attitude->accScale, 6);
+  attitude->velocity -= roundShift(attitude->velocity, attitude->leak);
+  int32_t half = attitude->rate / 2;
+  attitude->heave += (attitude->velocity + (attitude->velocity < 0 ? -half : half)) / attitude->rate;
+  attitude->heave -= roundShift(attitude->heave, attitude->leak);
+}
+
+// roll and pitch in 1/10 degree, heave in cm
+int16_t attitudeRoll(const Attitude* attitude) {
+  return attitude->roll / 2560;
+}
+
+int16_t attitudePitch(const Attitude* attitude) {
+  return attitude->pitch / 2560;
+}
+
+int16_t attitudeHeave(const Attitude* attitude) {
+  return attitude->heave / 40960;
+}
+
+/**
+ * cooperative scheduler with a static task table, the table order is the priority.
+ * period 0: the task runs in every pass. Otherwise the task is due every period ms (16 bit, max. 65 s),
+ * a start later than deadline ms after that is counted as a miss. Of the due background tasks only the
+ * first runs in a pass, so long tasks (flush, new file) don't pile up.
+ * The runtime is measured with clock (µs), the max. is kept until taskReset (32 bit, a flush or a stall of the
+ * card takes longer than 65 ms).
+ **/
+#define TASK_BACKGROUND 0x01
+
+// the types of millis() and micros(), so the tasks and micros fit on the pc too (Tools/osmsim)
+typedef void (*TaskFunction)(unsigned long now);
+typedef unsigned long (*TaskClock)(void);
+
+struct Task {
+  TaskFunction run;
+  uint16_t period;
+  uint16_t deadline;
+  uint8_t flags;
+  uint16_t last;
+  uint32_t maxRuntime;
+  uint8_t misses;
+};
+
+void runTasks(Task* tasks, uint8_t count, uint32_t now, TaskClock clock) {
+  bool background = false;
+  for (uint8_t i = 0; i < count; i++) {
+    Task* task = tasks + i;
+    if (task->period > 0) {
+      uint16_t late = (uint16_t) now - task->last;
+      if (late < task->period) {
+        continue;
+      }
+      if (task->flags & TASK_BACKGROUND) {
+        if (background) {
+          continue;
+        }
+        background = true;
+      }
+      late -= task->period;
+      if ((late > task->deadline) && (task->misses < 0xFF)) {
+        task->misses++;
+      }
+      // keeping the phase, only after a long stall the task starts new from now
+      task->last = late < task->period ? task->last + task->period : (uint16_t) now;
+    }
+    uint32_t start = clock();
+    task->run(now);
+    uint32_t runtime = clock() - start;
+    if (runtime > task->maxRuntime) {
+      task->maxRuntime = runtime;
+    }
+  }
+}
+
+void taskReset(Task* tasks, uint8_t count) {
+  for (uint8_t i = 0; i < count; i++) {
+    tasks[i].maxRuntime = 0;
+    tasks[i].misses = 0;
+  }
+}
+
+// the first period of all tasks starts now
+void taskStart(Task* tasks, uint8_t count, uint32_t now) {
+  for (uint8_t i = 0; i < count; i++) {
+    tasks[i].last = now;
+  }
+  taskReset(tasks, count);
+}
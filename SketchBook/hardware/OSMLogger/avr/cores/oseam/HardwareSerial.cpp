@@ -21,6 +21,11 @@
   Modified 14 August 2012 by Alarus
   Modified 14 October 2013 by Wilfried Klaas
   - separate buffer sizes for input/output
+  Modified 17 October 2026 by Wilfried Klaas
+  - seatalk mode, the receive interrupt only stores complete datagrams
+  - counting dropped bytes
+  - receive buffer can be given from outside (setRxBuffer), 8 bit indices
+  - receive time of the first byte of a line (lineTime)
 */
 
 #include <stdlib.h>
@@ -57,10 +62,14 @@
 
 struct ring_buffer
 {
-  unsigned char rx_buffer[SERIAL_RX_BUFFER_SIZE];
-  unsigned char nrx_buffer[SERIAL_NRX_BUFFER_SIZE];
-  volatile unsigned int rx_head;
-  volatile unsigned int rx_tail;
+  // receive buffer, the default buffer or one given by setRxBuffer(). nrx_buffer may be 0 for 8 bit data.
+  unsigned char *rx_buffer;
+  unsigned char *nrx_buffer;
+  unsigned char rx_size;
+  volatile unsigned char rx_head;
+  volatile unsigned char rx_tail;
+  unsigned char rx_default[SERIAL_RX_BUFFER_SIZE];
+  unsigned char nrx_default[SERIAL_NRX_BUFFER_SIZE];
 
   unsigned char tx_buffer[SERIAL_TX_BUFFER_SIZE];
   unsigned char ntx_buffer[SERIAL_NTX_BUFFER_SIZE];
@@ -68,44 +77,173 @@ struct ring_buffer
   volatile unsigned int tx_tail;
   
   volatile bool overflow;
+  // count of dropped bytes
+  volatile unsigned int overflow_count;
+
+  // seatalk mode: datagram is written from rx_head to rx_write, rx_head is only set on completion
+  volatile bool seatalk;
+  unsigned char rx_write;
+  unsigned char dg_index;
+  unsigned char dg_length;
+  volatile unsigned int dg_errors;
+  unsigned long dg_time;
+
+  // receive time (millis) of the first byte of the last lines (NMEA: after a LF, seatalk: the command byte)
+  volatile unsigned long line_times[SERIAL_LINE_TIMES];
+  volatile unsigned char line_count;
+  bool line_start;
+  // reader side, the time of the line the reader is in
+  unsigned char read_line_count;
+  bool read_line_start;
+  unsigned long read_line_time;
 };
 
 #if defined(USBCON)
-  ring_buffer buffer = { { 0 }, { 0 }, 0, 0, { 0 }, { 0 }, 0, 0, false};
+  ring_buffer buffer;
 #endif
 #if defined(UBRRH) || defined(UBRR0H)
-  ring_buffer buffer = { { 0 }, { 0 }, 0, 0, { 0 }, { 0 }, 0, 0, false};
+  ring_buffer buffer;
 #endif
 #if defined(UBRR1H)
-  ring_buffer buffer1 = { { 0 }, { 0 }, 0, 0, { 0 }, { 0 }, 0, 0, false};
+  ring_buffer buffer1;
 #endif
 #if defined(UBRR2H)
-  ring_buffer buffer2 = { { 0 }, { 0 }, 0, 0, { 0 }, { 0 }, 0, 0, false};
+  ring_buffer buffer2;
 #endif
 #if defined(UBRR3H)
-  ring_buffer buffer3 = { { 0 }, { 0 }, 0, 0, { 0 }, { 0 }, 0, 0, false};
+  ring_buffer buffer3;
 #endif
 
+inline void reset_lines(ring_buffer *buffer)
+{
+  buffer->line_start = true;
+  buffer->read_line_start = true;
+  buffer->read_line_count = buffer->line_count;
+}
+
+// only called from the receive interrupt
+inline void push_line_time(unsigned long time, ring_buffer *buffer)
+{
+  buffer->line_times[buffer->line_count % SERIAL_LINE_TIMES] = time;
+  buffer->line_count++;
+}
+
+/*
+ * time of the line the reader is starting. If the reader is more than SERIAL_LINE_TIMES lines behind,
+ * the time is already overwritten and the actual time is used.
+ */
+inline unsigned long take_line_time(ring_buffer *buffer)
+{
+  unsigned long time;
+  uint8_t oldSREG = SREG;
+  cli();
+  unsigned char behind = buffer->line_count - buffer->read_line_count;
+  if ((behind > 0) && (behind <= SERIAL_LINE_TIMES)) {
+    time = buffer->line_times[buffer->read_line_count % SERIAL_LINE_TIMES];
+  } else {
+    time = millis();
+  }
+  SREG = oldSREG;
+  if (behind > 0) {
+    buffer->read_line_count++;
+  }
+  return time;
+}
+
 inline void store_char(unsigned char c, unsigned char nb, ring_buffer *buffer)
 {
-  unsigned int i = (unsigned int)(buffer->rx_head + 1) % SERIAL_RX_BUFFER_SIZE;
+  unsigned char i = buffer->rx_head + 1;
+  if (i >= buffer->rx_size) {
+    i = 0;
+  }
 
   // if we should be storing the received character into the location
   // just before the tail (meaning that the head would advance to the
   // current location of the tail), we're about to overflow the buffer
   // and so we don't write the character or advance the head.
   if (i != buffer->rx_tail) {
-    unsigned char index = getIndex(buffer->rx_head);
-    unsigned char offset = getOffset(buffer->rx_head);
     buffer->rx_buffer[buffer->rx_head] = c;
-	if (nb > 0) {
-      buffer->nrx_buffer[index] |= _BV(offset); 
-	} else {
-      buffer->nrx_buffer[index] &= ~_BV(offset);
-	}
+    if (buffer->nrx_buffer) {
+      unsigned char index = getIndex(buffer->rx_head);
+      unsigned char offset = getOffset(buffer->rx_head);
+      if (nb > 0) {
+        buffer->nrx_buffer[index] |= _BV(offset); 
+      } else {
+        buffer->nrx_buffer[index] &= ~_BV(offset);
+      }
+    }
 	buffer->rx_head = i;
+    if (buffer->line_start) {
+      push_line_time(millis(), buffer);
+    }
+    buffer->line_start = (c == '\n');
   } else {
     buffer->overflow = true;
+    buffer->overflow_count++;
+  }
+}
+
+/*
+ * seatalk mode: a byte with the 9th bit set is the command byte and starts a new datagram,
+ * the low nibble of the second byte is the length (3 + nibble bytes).
+ * Only a datagram with the right length is released to the reader by setting the rx_head.
+ * An uncompleted datagram (collision on the bus, lost bytes) is dropped and counted.
+ */
+inline void store_datagram(unsigned char c, unsigned char nb, ring_buffer *buffer)
+{
+  if (nb > 0) {
+    if (buffer->dg_index > 0) {
+      buffer->dg_errors++;
+    }
+    buffer->dg_index = 0;
+    buffer->dg_length = 2;
+    buffer->dg_time = millis();
+    buffer->rx_write = buffer->rx_head;
+  } else if (buffer->dg_index == 0) {
+    // data byte without a command byte, garbage
+    return;
+  }
+
+  unsigned char i = buffer->rx_write + 1;
+  if (i >= buffer->rx_size) {
+    i = 0;
+  }
+  if (i == buffer->rx_tail) {
+    buffer->overflow = true;
+    buffer->overflow_count++;
+    buffer->dg_errors++;
+    buffer->dg_index = 0;
+    return;
+  }
+  buffer->rx_buffer[buffer->rx_write] = c;
+  if (buffer->nrx_buffer) {
+    unsigned char index = getIndex(buffer->rx_write);
+    unsigned char offset = getOffset(buffer->rx_write);
+    if (nb > 0) {
+      buffer->nrx_buffer[index] |= _BV(offset);
+    } else {
+      buffer->nrx_buffer[index] &= ~_BV(offset);
+    }
+  }
+  buffer->rx_write = i;
+  buffer->dg_index++;
+
+  if (buffer->dg_index == 2) {
+    buffer->dg_length = 3 + (c & 0x0F);
+  }
+  if (buffer->dg_index == buffer->dg_length) {
+    buffer->rx_head = i;
+    buffer->dg_index = 0;
+    push_line_time(buffer->dg_time, buffer);
+  }
+}
+
+inline void receive_char(unsigned char c, unsigned char nb, ring_buffer *buffer)
+{
+  if (buffer->seatalk) {
+    store_datagram(c, nb, buffer);
+  } else {
+    store_char(c, nb, buffer);
   }
 }
 
@@ -131,7 +269,7 @@ inline void store_char(unsigned char c, unsigned char nb, ring_buffer *buffer)
     if (bit_is_clear(UCSR0A, UPE0)) {
 	  unsigned char nb = UCSR0B & 0x02;
 	  unsigned char c = UDR0;
-      store_char(c, nb, &buffer);
+      receive_char(c, nb, &buffer);
     } else {
       unsigned char c = UDR0;
     };
@@ -139,7 +277,7 @@ inline void store_char(unsigned char c, unsigned char nb, ring_buffer *buffer)
     if (bit_is_clear(UCSRA, PE)) {
 	  unsigned char nb = UCSRB & 0x02;
       unsigned char c = UDR;
-      store_char(c, nb, &buffer);
+      receive_char(c, nb, &buffer);
     } else {
       unsigned char c = UDR;
     };
@@ -159,7 +297,7 @@ inline void store_char(unsigned char c, unsigned char nb, ring_buffer *buffer)
     if (bit_is_clear(UCSR1A, UPE1)) {
       unsigned char nb = UCSR1B & 0x02;
       unsigned char c = UDR1;
-      store_char(c, nb, &buffer1);
+      receive_char(c, nb, &buffer1);
     } else {
       unsigned char c = UDR1;
     };
@@ -175,7 +313,7 @@ inline void store_char(unsigned char c, unsigned char nb, ring_buffer *buffer)
     if (bit_is_clear(UCSR2A, UPE2)) {
 	  unsigned char nb = UCSR2B & 0x02;
       unsigned char c = UDR2;
-      store_char(c, nb, &buffer2);
+      receive_char(c, nb, &buffer2);
     } else {
       unsigned char c = UDR2;
     };
@@ -191,7 +329,7 @@ inline void store_char(unsigned char c, unsigned char nb, ring_buffer *buffer)
     if (bit_is_clear(UCSR3A, UPE3)) {
 	  unsigned char nb = UCSR3B & 0x02;
       unsigned char c = UDR3;
-      store_char(c, nb, &buffer3);
+      receive_char(c, nb, &buffer3);
     } else {
       unsigned char c = UDR3;
     };
@@ -364,6 +502,9 @@ HardwareSerial::HardwareSerial(ring_buffer *buffer,
 
 void HardwareSerial::initBuffer()
 {
+  _buffer->rx_buffer = _buffer->rx_default;
+  _buffer->nrx_buffer = _buffer->nrx_default;
+  _buffer->rx_size = SERIAL_RX_BUFFER_SIZE;
   for(int i = 0; i < SERIAL_RX_BUFFER_SIZE; i++) 
 	_buffer->rx_buffer[i] = 0;
 	
@@ -380,7 +521,12 @@ void HardwareSerial::initBuffer()
   _buffer->rx_tail = 0;
   _buffer->tx_head = 0;
   _buffer->tx_tail = 0;
+  reset_lines(_buffer);
   _buffer->overflow = false;
+  _buffer->overflow_count = 0;
+  _buffer->seatalk = false;
+  _buffer->dg_index = 0;
+  _buffer->dg_errors = 0;
   
   }
 
@@ -392,6 +538,7 @@ void HardwareSerial::begin(unsigned long baud, byte config)
   //uint8_t current_config;
   bool use_u2x = true;
   _nineBitMode = config & 0x01;
+  _buffer->seatalk = false;
 
 #if F_CPU == 16000000UL
   // hardcoded exception for compatibility with the bootloader shipped
@@ -439,6 +586,53 @@ try_again:
   cbi(*_ucsrb, _udrie);
 }
 
+/*
+ * starting the seatalk mode (4800 baud, 9N1). Complete datagrams are read with readDatagram().
+ */
+void HardwareSerial::beginSeaTalk()
+{
+  begin(4800, SERIAL_9N1);
+  uint8_t oldSREG = SREG;
+  cli();
+  _buffer->rx_head = _buffer->rx_tail;
+  _buffer->dg_index = 0;
+  _buffer->dg_errors = 0;
+  _buffer->seatalk = true;
+  reset_lines(_buffer);
+  SREG = oldSREG;
+}
+
+/*
+ * using the given memory as receive buffer instead of the small default buffer. Must be called before begin().
+ * For 9 bit data 1/9 of the memory is used for the 9th bits. size is max. 255.
+ * Without memory (0) the default buffer is used again.
+ */
+void HardwareSerial::setRxBuffer(unsigned char *memory, unsigned char size, bool nineBit)
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  if (memory && (size > 8)) {
+    if (nineBit) {
+      unsigned char ringSize = (unsigned int) size * 8 / 9;
+      _buffer->rx_buffer = memory;
+      _buffer->nrx_buffer = memory + ringSize;
+      _buffer->rx_size = ringSize;
+    } else {
+      _buffer->rx_buffer = memory;
+      _buffer->nrx_buffer = 0;
+      _buffer->rx_size = size;
+    }
+  } else {
+    _buffer->rx_buffer = _buffer->rx_default;
+    _buffer->nrx_buffer = _buffer->nrx_default;
+    _buffer->rx_size = SERIAL_RX_BUFFER_SIZE;
+  }
+  _buffer->rx_head = 0;
+  _buffer->rx_tail = 0;
+  reset_lines(_buffer);
+  SREG = oldSREG;
+}
+
 void HardwareSerial::end()
 {
   // wait for transmission of outgoing data
@@ -452,11 +646,17 @@ void HardwareSerial::end()
   
   // clear any received data
   _buffer->rx_head = _buffer->rx_tail;
+  reset_lines(_buffer);
 }
 
 int HardwareSerial::available(void)
 {
-  return (unsigned int)(SERIAL_RX_BUFFER_SIZE + _buffer->rx_head - _buffer->rx_tail) % SERIAL_RX_BUFFER_SIZE;
+  unsigned char head = _buffer->rx_head;
+  unsigned char tail = _buffer->rx_tail;
+  if (head >= tail) {
+    return head - tail;
+  }
+  return _buffer->rx_size + head - tail;
 }
 
 bool HardwareSerial::overflow(void)
@@ -464,13 +664,79 @@ bool HardwareSerial::overflow(void)
   return _buffer->overflow;
 }
 
+/*
+ * reading the next complete seatalk datagram into data.
+ * Returns the length of the datagram or 0 if there is no datagram.
+ * A datagram longer than size is dropped.
+ */
+uint8_t HardwareSerial::readDatagram(uint8_t *data, uint8_t size)
+{
+  unsigned char tail = _buffer->rx_tail;
+  if (!_buffer->seatalk || (_buffer->rx_head == tail)) {
+    return 0;
+  }
+  unsigned char attribute = tail + 1;
+  if (attribute >= _buffer->rx_size) {
+    attribute = 0;
+  }
+  uint8_t length = 3 + (_buffer->rx_buffer[attribute] & 0x0F);
+  for (uint8_t i = 0; i < length; i++) {
+    if (i < size) {
+      data[i] = _buffer->rx_buffer[tail];
+    }
+    if (++tail >= _buffer->rx_size) {
+      tail = 0;
+    }
+  }
+  _buffer->rx_tail = tail;
+  _buffer->overflow = false;
+  _buffer->read_line_time = take_line_time(_buffer);
+  if (length > size) {
+    return 0;
+  }
+  return length;
+}
+
+/*
+ * count of dropped seatalk datagrams (wrong length, collision, buffer overflow), running over at 65535.
+ */
+uint16_t HardwareSerial::datagramErrors(void)
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  uint16_t count = _buffer->dg_errors;
+  SREG = oldSREG;
+  return count;
+}
+
+/*
+ * count of received bytes dropped because of a full receive buffer, running over at 65535.
+ */
+uint16_t HardwareSerial::overflowCount(void)
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  uint16_t count = _buffer->overflow_count;
+  SREG = oldSREG;
+  return count;
+}
+
+/*
+ * receive time (millis) of the first byte of the line the last read byte belongs to,
+ * in seatalk mode of the last datagram.
+ */
+unsigned long HardwareSerial::lineTime(void)
+{
+  return _buffer->read_line_time;
+}
+
 int HardwareSerial::peek(void)
 {
   if (_buffer->rx_head == _buffer->rx_tail) {
     return -1;
   } else {
     int c = _buffer->rx_buffer[_buffer->rx_tail];
-    if (_nineBitMode) {
+    if (_nineBitMode && _buffer->nrx_buffer) {
       unsigned char index = getIndex(_buffer->rx_tail);
       unsigned char offset = getOffset(_buffer->rx_tail);
 	  unsigned char nb = _buffer->nrx_buffer[index] & (1<<(offset));
@@ -489,7 +755,7 @@ int HardwareSerial::read(void)
     return -1;
   } else {
     int c = _buffer->rx_buffer[_buffer->rx_tail];
-    if (_nineBitMode) {
+    if (_nineBitMode && _buffer->nrx_buffer) {
       unsigned char index = getIndex(_buffer->rx_tail);
       unsigned char offset = getOffset(_buffer->rx_tail);
 	  unsigned char nb = _buffer->nrx_buffer[index] & (1<<(offset));
@@ -497,8 +763,16 @@ int HardwareSerial::read(void)
 	    c |= _BV(8);
 	  }
 	}
-    _buffer->rx_tail = (unsigned int)(_buffer->rx_tail + 1) % SERIAL_RX_BUFFER_SIZE;
+    unsigned char tail = _buffer->rx_tail + 1;
+    if (tail >= _buffer->rx_size) {
+      tail = 0;
+    }
+    _buffer->rx_tail = tail;
     _buffer->overflow = false;
+    if (_buffer->read_line_start) {
+      _buffer->read_line_time = take_line_time(_buffer);
+    }
+    _buffer->read_line_start = (c == '\n');
     return c;
   }
 }
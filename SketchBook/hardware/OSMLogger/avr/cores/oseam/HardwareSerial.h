@@ -20,6 +20,11 @@
   Modified 14 August 2012 by Alarus
   Modified 14 October 2013 by Wilfried Klaas
   - separate buffer sizes for input/output
+  Modified 17 October 2026 by Wilfried Klaas
+  - seatalk mode, the receive interrupt only stores complete datagrams
+  - counting dropped bytes
+  - receive buffer can be given from outside (setRxBuffer), 8 bit indices
+  - receive time of the first byte of a line (lineTime)
 */
 
 #ifndef HardwareSerial_h
@@ -39,16 +44,21 @@
   #define SERIAL_NRX_BUFFER_SIZE 2
   #define SERIAL_NTX_BUFFER_SIZE 2
 #else
-// changing the buffer to a greater value.
-/*  #define SERIAL_RX_BUFFER_SIZE 256
-  #define SERIAL_NRX_BUFFER_SIZE 32
-*/
-  #define SERIAL_RX_BUFFER_SIZE 128
+// small default receive buffer, a bigger one can be set with setRxBuffer().
+/*  #define SERIAL_RX_BUFFER_SIZE 128
   #define SERIAL_NRX_BUFFER_SIZE 16
+*/
+  #define SERIAL_RX_BUFFER_SIZE 16
+  #define SERIAL_NRX_BUFFER_SIZE 2
   #define SERIAL_TX_BUFFER_SIZE 8
   #define SERIAL_NTX_BUFFER_SIZE 1
 #endif
 
+// a seatalk datagram has max. 18 bytes (command, attribute with 4 bit length, 16 data bytes)
+#define SEATALK_MAX_DATAGRAM 18
+// count of line start times stored by the receive interrupt, the reader may be so many lines behind
+#define SERIAL_LINE_TIMES 4
+
 struct ring_buffer;
 
 // Define config for Serial.begin(baud, config);
@@ -116,6 +126,8 @@ class HardwareSerial : public Stream
       uint8_t rxen, uint8_t txen, uint8_t rxcie, uint8_t udrie, uint8_t u2x);
     void begin(unsigned long baud) { begin(baud, SERIAL_8N1); }
     void begin(unsigned long, uint8_t);
+    void beginSeaTalk();
+    void setRxBuffer(unsigned char *memory, unsigned char size, bool nineBit);
     void end();
     virtual int available(void);
     virtual int peek(void);
@@ -123,6 +135,10 @@ class HardwareSerial : public Stream
     virtual void flush(void);
     virtual size_t write(int);
     virtual bool overflow(void);
+    uint8_t readDatagram(uint8_t *data, uint8_t size);
+    uint16_t datagramErrors(void);
+    uint16_t overflowCount(void);
+    unsigned long lineTime(void);
     inline size_t write(unsigned long n) { return write((int)n); }
     inline size_t write(long n) { return write((int)n); }
     inline size_t write(unsigned int n) { return write((int)n); }
@@ -46,8 +46,23 @@ static uint16_t rx_target;
 static uint16_t rx_stop_ticks=0;
 static volatile uint8_t rx_buffer_head;
 static volatile uint8_t rx_buffer_tail;
-#define RX_BUFFER_SIZE 80
-static volatile uint8_t rx_buffer[RX_BUFFER_SIZE];
+// WKLA 20261017 the receive buffer can be set from outside (setRxBuffer), small default buffer
+//#define RX_BUFFER_SIZE 80
+#define RX_BUFFER_SIZE 16
+static volatile uint8_t rx_default[RX_BUFFER_SIZE];
+static volatile uint8_t *rx_buffer = rx_default;
+static uint8_t rx_buffer_size = RX_BUFFER_SIZE;
+// WKLA 20261017 counting the bytes dropped because of a full receive buffer
+static volatile uint16_t rx_overflow_count;
+// WKLA 20261017 receive time (millis) of the first byte of the last lines, a line starts after a LF.
+// The reader takes the time, when it reads the first byte of a line.
+#define RX_LINE_TIMES 4
+static volatile unsigned long rx_line_times[RX_LINE_TIMES];
+static volatile uint8_t rx_line_count;
+static bool rx_line_start = true;
+static uint8_t read_line_count;
+static bool read_line_start = true;
+static unsigned long read_line_time;
 
 static volatile uint8_t tx_state=0;
 static uint8_t tx_byte;
@@ -60,6 +75,13 @@ static volatile uint8_t tx_buffer_tail;
 static volatile uint8_t tx_buffer[TX_BUFFER_SIZE];
 
 
+static void reset_lines(void)
+{
+	rx_line_start = true;
+	read_line_start = true;
+	read_line_count = rx_line_count;
+}
+
 #ifndef INPUT_PULLUP
 #define INPUT_PULLUP INPUT
 #endif
@@ -191,6 +213,16 @@ void AltSoftSerial::flushOutput(void)
 /****************************************/
 
 
+// only called from the receive interrupts
+static inline void stamp_line(uint8_t b)
+{
+	if (rx_line_start) {
+		rx_line_times[rx_line_count % RX_LINE_TIMES] = millis();
+		rx_line_count++;
+	}
+	rx_line_start = (b == '\n');
+}
+
 ISR(CAPTURE_INTERRUPT)
 {
 	uint8_t state, bit, head;
@@ -225,10 +257,13 @@ ISR(CAPTURE_INTERRUPT)
 			if (state >= 9) {
 				DISABLE_INT_COMPARE_B();
 				head = rx_buffer_head + 1;
-				if (head >= RX_BUFFER_SIZE) head = 0;
+				if (head >= rx_buffer_size) head = 0;
 				if (head != rx_buffer_tail) {
 					rx_buffer[head] = rx_byte;
 					rx_buffer_head = head;
+					stamp_line(rx_byte);
+				} else {
+					rx_overflow_count++;
 				}
 				CONFIG_CAPTURE_FALLING_EDGE();
 				rx_bit = 0;
@@ -255,10 +290,13 @@ ISR(COMPARE_B_INTERRUPT)
 		state++;
 	}
 	head = rx_buffer_head + 1;
-	if (head >= RX_BUFFER_SIZE) head = 0;
+	if (head >= rx_buffer_size) head = 0;
 	if (head != rx_buffer_tail) {
 		rx_buffer[head] = rx_byte;
 		rx_buffer_head = head;
+		stamp_line(rx_byte);
+	} else {
+		rx_overflow_count++;
 	}
 	rx_state = 0;
 	CONFIG_CAPTURE_FALLING_EDGE();
@@ -274,12 +312,41 @@ int AltSoftSerial::read(void)
 	head = rx_buffer_head;
 	tail = rx_buffer_tail;
 	if (head == tail) return -1;
-	if (++tail >= RX_BUFFER_SIZE) tail = 0;
+	if (++tail >= rx_buffer_size) tail = 0;
 	out = rx_buffer[tail];
 	rx_buffer_tail = tail;
+	if (read_line_start) {
+		read_line_time = take_line_time();
+	}
+	read_line_start = (out == '\n');
 	return out;
 }
 
+// time of the line the reader is starting. If the reader is more than RX_LINE_TIMES lines behind,
+// the time is already overwritten and the actual time is used.
+unsigned long AltSoftSerial::take_line_time(void)
+{
+	unsigned long time;
+	uint8_t oldSREG = SREG;
+	cli();
+	uint8_t behind = rx_line_count - read_line_count;
+	if ((behind > 0) && (behind <= RX_LINE_TIMES)) {
+		time = rx_line_times[read_line_count % RX_LINE_TIMES];
+	} else {
+		time = millis();
+	}
+	SREG = oldSREG;
+	if (behind > 0) {
+		read_line_count++;
+	}
+	return time;
+}
+
+unsigned long AltSoftSerial::lineTime(void)
+{
+	return read_line_time;
+}
+
 int AltSoftSerial::peek(void)
 {
 	uint8_t head, tail;
@@ -297,12 +364,42 @@ int AltSoftSerial::available(void)
 	head = rx_buffer_head;
 	tail = rx_buffer_tail;
 	if (head >= tail) return head - tail;
-	return RX_BUFFER_SIZE + head - tail;
+	return rx_buffer_size + head - tail;
+}
+
+void AltSoftSerial::setRxBuffer(uint8_t *memory, uint8_t size)
+{
+	uint8_t oldSREG = SREG;
+	cli();
+	if (memory && (size > 1)) {
+		rx_buffer = memory;
+		rx_buffer_size = size;
+	} else {
+		rx_buffer = rx_default;
+		rx_buffer_size = RX_BUFFER_SIZE;
+	}
+	rx_buffer_head = 0;
+	rx_buffer_tail = 0;
+	reset_lines();
+	SREG = oldSREG;
+}
+
+uint16_t AltSoftSerial::overflowCount(void)
+{
+	uint8_t oldSREG = SREG;
+	cli();
+	uint16_t count = rx_overflow_count;
+	SREG = oldSREG;
+	return count;
 }
 
 void AltSoftSerial::flushInput(void)
 {
+	uint8_t oldSREG = SREG;
+	cli();
 	rx_buffer_head = rx_buffer_tail;
+	reset_lines();
+	SREG = oldSREG;
 }
 
 
@@ -64,12 +64,19 @@ public:
 	bool listen() { return false; }
 	bool isListening() { return true; }
 	bool overflow() { bool r = timing_error; timing_error = false; return r; }
+	// count of dropped bytes, running over at 65535
+	static uint16_t overflowCount();
+	// using the memory as receive buffer (max. 255 bytes), must be called before begin()
+	static void setRxBuffer(uint8_t *memory, uint8_t size);
+	// receive time (millis) of the first byte of the line the last read() byte belongs to
+	static unsigned long lineTime();
 	static int library_version() { return 1; }
 	static void enable_timer0(bool enable) { }
 	static bool timing_error;
 private:
 	static void init(uint32_t cycles_per_bit);
 	static void writeByte(uint8_t byte);
+	static unsigned long take_line_time();
 };
 
 #endif
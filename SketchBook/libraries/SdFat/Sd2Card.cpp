@@ -332,6 +332,21 @@ bool Sd2Card::begin(uint8_t chipSelectPin, uint8_t sckDivisor) {
   return false;
 }
 //------------------------------------------------------------------------------
+// WKLA 20261017
+/** Check if the card is still programming the last block of a write.
+ *
+ * Only one byte is read, so this can be polled in the main loop between
+ * writeData() calls, writeData() will not wait if this returns false.
+ *
+ * \return true if the card holds DO low (busy).
+ */
+bool Sd2Card::isBusy() {
+  chipSelectLow();
+  bool busy = m_spi.receive() != 0XFF;
+  chipSelectHigh();
+  return busy;
+}
+//------------------------------------------------------------------------------
 /**
  * Read a 512 byte block from an SD card.
  *
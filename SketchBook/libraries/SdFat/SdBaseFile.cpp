@@ -708,7 +708,11 @@ bool SdBaseFile::open(SdBaseFile* dirFile,
     // set timestamps
     if (m_dateTime) {
       // call user date/time function
-      m_dateTime(&p->creationDate, &p->creationTime);
+      // WKLA 20261017 no pointers into the packed entry (card emulator on the pc)
+      uint16_t date, time;
+      m_dateTime(&date, &time);
+      p->creationDate = date;
+      p->creationTime = time;
     } else {
       // use default date/time
       p->creationDate = FAT_DEFAULT_DATE;
@@ -1604,6 +1608,35 @@ void SdBaseFile::setpos(FatPos_t* pos) {
   m_curCluster = pos->cluster;
 }
 //------------------------------------------------------------------------------
+// WKLA 20261017
+/** Set the size of the file in the directory entry, the clusters of the
+ * file are not changed. Only the directory block is written, so this is
+ * the fastest way to make a preallocated file consistent (power fail,
+ * checkpoint). The clusters behind the size stay in the chain of the file
+ * until a later truncate(). The file position is not changed, close the
+ * file or seek before the next write.
+ *
+ * \param[in] size The new size of the file. It may be greater than the
+ * current size (a preallocated file growing again), but the caller must
+ * keep it inside the clusters of the file.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ */
+bool SdBaseFile::setSize(uint32_t size) {
+  if (!isFile() || (size > 0 && m_firstCluster == 0)) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+  m_fileSize = size;
+  m_flags |= F_FILE_DIR_DIRTY;
+  return sync();
+
+ fail:
+  writeError = true;
+  return false;
+}
+//------------------------------------------------------------------------------
 /** The sync() call causes all modified data and directory fields
  * to be written to the storage device.
  *
@@ -1634,8 +1667,11 @@ bool SdBaseFile::sync() {
 
     // set modify time if user supplied a callback date/time function
     if (m_dateTime) {
-      m_dateTime(&d->lastWriteDate, &d->lastWriteTime);
-      d->lastAccessDate = d->lastWriteDate;
+      uint16_t date, time;
+      m_dateTime(&date, &time);
+      d->lastWriteDate = date;
+      d->lastWriteTime = time;
+      d->lastAccessDate = date;
     }
     // clear directory dirty
     m_flags &= ~F_FILE_DIR_DIRTY;
@@ -1799,7 +1835,8 @@ bool SdBaseFile::truncate(uint32_t length) {
     goto fail;
   }
   // fileSize and length are zero - nothing to do
-  if (m_fileSize == 0) return true;
+  // WKLA 20261017 unless there are clusters behind the size (setSize())
+  if (m_fileSize == 0 && m_firstCluster == 0) return true;
 
   // remember position for seek after truncation
   newPos = m_curPosition > length ? length : m_curPosition;
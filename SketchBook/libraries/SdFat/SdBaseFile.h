@@ -345,6 +345,8 @@ class SdBaseFile {
    */
   bool seekEnd(int32_t offset = 0) {return seekSet(m_fileSize + offset);}
   bool seekSet(uint32_t pos);
+  // WKLA 20261017
+  bool setSize(uint32_t size);
   bool sync();
   bool timestamp(SdBaseFile* file);
   bool timestamp(uint8_t flag, uint16_t year, uint8_t month, uint8_t day,
@@ -30,22 +30,28 @@
  * for FAT table entries.  Improves performance for large writes that
  * are not a multiple of 512 bytes.
  */
+// WKLA 20261017 USE_SEPARATE_FAT_CACHE, USE_MULTI_BLOCK_SD_IO and USE_SD_CRC
+// can be set on the command line (Tools/sdemu/sdmatrix.sh)
+#ifndef USE_SEPARATE_FAT_CACHE
 #ifdef __arm__
 #define USE_SEPARATE_FAT_CACHE 1
 #else  // __arm__
 #define USE_SEPARATE_FAT_CACHE 0
 #endif  // __arm__
+#endif  // USE_SEPARATE_FAT_CACHE
 //------------------------------------------------------------------------------
 /**
  * Set USE_MULTI_BLOCK_SD_IO nonzero to use multi-block SD read/write.
  *
  * Don't use mult-block read/write on small AVR boards.
  */
+#ifndef USE_MULTI_BLOCK_SD_IO
 #if defined(RAMEND) && RAMEND < 3000
 #define USE_MULTI_BLOCK_SD_IO 0
 #else
 #define USE_MULTI_BLOCK_SD_IO 1
 #endif
+#endif  // USE_MULTI_BLOCK_SD_IO
 //------------------------------------------------------------------------------
 /**
  * Force use of Arduino Standard SPI library if USE_ARDUINO_SPI_LIBRARY
@@ -60,7 +66,9 @@
  *
  * Set USE_SD_CRC to 2 to used a larger faster table driven CRC-CCITT function.
  */
+#ifndef USE_SD_CRC
 #define USE_SD_CRC 0
+#endif  // USE_SD_CRC
 //------------------------------------------------------------------------------
 /**
  * To use multiple SD cards set USE_MULTIPLE_CARDS nonzero.
@@ -93,6 +93,12 @@ bool SdVolume::allocContiguous(uint32_t count, uint32_t* curCluster) {
   // remember possible next free cluster
   if (setStart) m_allocSearchStart = endCluster + 1;
 
+  // WKLA 20261017 the FSINFO count is wrong from now on
+  if (!invalidateFSInfo()) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+
   // mark end of chain
   if (!fatPutEOC(endCluster)) {
     DBG_FAIL_MACRO;
@@ -113,6 +119,8 @@ bool SdVolume::allocContiguous(uint32_t count, uint32_t* curCluster) {
       goto fail;
     }
   }
+  // WKLA 20261017 the clusters are used only if the whole chain is written
+  if (m_freeClusters >= 0) m_freeClusters -= count;
   // return first cluster number to caller
   *curCluster = bgnCluster;
   return true;
@@ -404,6 +412,11 @@ bool SdVolume::fatPut(uint32_t cluster, uint32_t value) {
 bool SdVolume::freeChain(uint32_t cluster) {
   uint32_t next;
 
+  // WKLA 20261017 the FSINFO count is wrong from now on
+  if (!invalidateFSInfo()) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
   do {
     if (!fatGet(cluster, &next)) {
       DBG_FAIL_MACRO;
@@ -415,6 +428,7 @@ bool SdVolume::freeChain(uint32_t cluster) {
       goto fail;
     }
     if (cluster < m_allocSearchStart) m_allocSearchStart = cluster;
+    if (m_freeClusters >= 0) m_freeClusters++;
     cluster = next;
   } while (!isEOC(cluster));
 
@@ -424,7 +438,49 @@ bool SdVolume::freeChain(uint32_t cluster) {
   return false;
 }
 //------------------------------------------------------------------------------
+// WKLA 20261017
+// the free count in the FSINFO is marked unknown before the first change of the FAT,
+// also if the count was never read since the card was mounted
+bool SdVolume::invalidateFSInfo() {
+  m_fsInfoValid = false;
+  if (!m_fsInfoBlock || m_fsInfoUnknown) return true;
+  m_fsInfoUnknown = true;
+  return writeFSInfo(0XFFFFFFFF);
+}
+//------------------------------------------------------------------------------
+bool SdVolume::writeFSInfo(uint32_t freeCount) {
+  cache_t* pc = cacheFetch(m_fsInfoBlock, CACHE_FOR_WRITE);
+  if (!pc || pc->fsinfo.leadSignature != FSINFO_LEAD_SIG
+    || pc->fsinfo.structSignature != FSINFO_STRUCT_SIG) {
+    DBG_FAIL_MACRO;
+    return false;
+  }
+  pc->fsinfo.freeCount = freeCount;
+  pc->fsinfo.nextFree = m_allocSearchStart;
+  return cacheSync();
+}
+//------------------------------------------------------------------------------
+/** Write the cached free cluster count and the start of the next free
+ * cluster search into the FSINFO of a FAT32 volume, so the next start
+ * doesn't need to scan the FAT.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ */
+bool SdVolume::syncFSInfo() {
+  if (!m_fsInfoBlock || m_freeClusters < 0 || m_fsInfoValid) return true;
+  if (!writeFSInfo(m_freeClusters)) return false;
+  m_fsInfoValid = true;
+  m_fsInfoUnknown = false;
+  return true;
+}
+//------------------------------------------------------------------------------
 /** Volume free space in clusters.
+ *
+ * The count is kept in the volume and updated with every allocation, only the
+ * first call after the card was initialized reads it. This is the free count
+ * of the FSINFO of a FAT32 volume if it's valid, else one scan of the FAT.
+ * A new init() of the same volume (serial number) keeps the count.
  *
  * \return Count of free clusters for success or -1 if an error occurs.
  */
@@ -434,6 +490,23 @@ int32_t SdVolume::freeClusterCount() {
   uint32_t todo = m_clusterCount + 2;
   uint16_t n;
 
+  // WKLA 20261017
+  if (m_freeClusters >= 0) return m_freeClusters;
+  if (m_fsInfoBlock) {
+    cache_t* pc = cacheFetch(m_fsInfoBlock, CACHE_FOR_READ);
+    if (!pc) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+    if (pc->fsinfo.leadSignature == FSINFO_LEAD_SIG
+      && pc->fsinfo.structSignature == FSINFO_STRUCT_SIG
+      && pc->fsinfo.freeCount <= m_clusterCount) {
+      m_freeClusters = pc->fsinfo.freeCount;
+      m_fsInfoValid = true;
+      return m_freeClusters;
+    }
+  }
+
   if (FAT12_SUPPORT && m_fatType == 12) {
     for (unsigned i = 2; i < todo; i++) {
       uint32_t c;
@@ -469,6 +542,7 @@ int32_t SdVolume::freeClusterCount() {
     DBG_FAIL_MACRO;
     goto fail;
   }
+  m_freeClusters = free;
   return free;
 
  fail:
@@ -493,6 +567,9 @@ bool SdVolume::init(Sd2Card* dev, uint8_t part) {
   uint8_t tmp;
   uint32_t totalBlocks;
   uint32_t volumeStartBlock = 0;
+  // WKLA 20261017
+  uint32_t oldClusterCount = m_clusterCount;
+  uint32_t serial;
   fat32_boot_t* fbs;
   cache_t* pc;
   m_sdCard = dev;
@@ -585,6 +662,32 @@ bool SdVolume::init(Sd2Card* dev, uint8_t part) {
     m_rootDirStart = fbs->fat32RootCluster;
     m_fatType = 32;
   }
+  // WKLA 20261017 the cached free count stays valid for the same volume
+  serial = m_fatType == 32 ? fbs->volumeSerialNumber : pc->fbs.volumeSerialNumber;
+  m_fsInfoBlock = m_fatType == 32 ? volumeStartBlock + fbs->fat32FSInfo : 0;
+  if (serial != m_volumeSerial || m_clusterCount != oldClusterCount) {
+    m_volumeSerial = serial;
+    m_freeClusters = -1;
+    m_fsInfoValid = false;
+  }
+  // the free cluster search starts at the hint of the FSINFO, not at the
+  // beginning of a card full of old files
+  if (m_fsInfoBlock) {
+    pc = cacheFetch(m_fsInfoBlock, CACHE_FOR_READ);
+    if (!pc) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+    if (pc->fsinfo.leadSignature == FSINFO_LEAD_SIG
+      && pc->fsinfo.structSignature == FSINFO_STRUCT_SIG) {
+      setAllocSearchStart(pc->fsinfo.nextFree);
+      // a count on the card has to be marked unknown before the first FAT change
+      m_fsInfoUnknown = pc->fsinfo.freeCount == 0XFFFFFFFF;
+    } else {
+      // no valid FSINFO, nothing to read or to update
+      m_fsInfoBlock = 0;
+    }
+  }
   return true;
 
  fail:
@@ -57,7 +57,7 @@ union cache_t {
 class SdVolume {
  public:
   /** Create an instance of SdVolume */
-  SdVolume() : m_fatType(0) {}
+  SdVolume() : m_fatType(0), m_freeClusters(-1), m_volumeSerial(0) {}
   /** Clear the cache and returns a pointer to the cache.  Used by the WaveRP
    * recorder to do raw write to the SD card.  Not for normal apps.
    * \return A pointer to the cache buffer or zero if an error occurs.
@@ -81,6 +81,17 @@ class SdVolume {
   bool init(Sd2Card* dev, uint8_t part);
 
   // inline functions that return volume info
+  // WKLA 20261017
+  /** \return The cluster where the search for free clusters starts. */
+  uint32_t allocSearchStart() const {return m_allocSearchStart;}
+  /** Set the cluster where the search for free clusters starts, a hint
+   * saved by the application (FAT16 has no FSINFO). Invalid values are ignored.
+   *
+   * \param[in] cluster The likely first free cluster.
+   */
+  void setAllocSearchStart(uint32_t cluster) {
+    if (cluster >= 2 && cluster <= m_clusterCount + 1) m_allocSearchStart = cluster;
+  }
   /** \return The volume's cluster size in blocks. */
   uint8_t blocksPerCluster() const {return m_blocksPerCluster;}
   /** \return The number of blocks in one FAT. */
@@ -98,6 +109,8 @@ class SdVolume {
   /** \return The FAT type of the volume. Values are 12, 16 or 32. */
   uint8_t fatType() const {return m_fatType;}
   int32_t freeClusterCount();
+  // WKLA 20261017
+  bool syncFSInfo();
   /** \return The number of entries in the root directory for FAT16 volumes. */
   uint32_t rootDirEntryCount() const {return m_rootDirEntryCount;}
   /** \return The logical block number for the start of the root directory
@@ -129,6 +142,12 @@ class SdVolume {
   uint8_t m_fatType;             // Volume type (12, 16, OR 32).
   uint16_t m_rootDirEntryCount;  // Number of entries in FAT16 root dir.
   uint32_t m_rootDirStart;       // Start block for FAT16, cluster for FAT32.
+  // WKLA 20261017
+  int32_t m_freeClusters;        // Cached free cluster count, -1 = unknown.
+  uint32_t m_fsInfoBlock;        // FSINFO block for FAT32, 0 for FAT16.
+  uint32_t m_volumeSerial;       // Serial number of the volume of the cached count.
+  bool m_fsInfoValid;            // Free count in the FSINFO is the cached count.
+  bool m_fsInfoUnknown;          // Free count in the FSINFO is marked unknown.
 //------------------------------------------------------------------------------
 // block caches
 // use of static functions save a bit of flash - maybe not worth complexity
@@ -201,6 +220,9 @@ class SdVolume {
     return fatPut(cluster, 0x0FFFFFFF);
   }
   bool freeChain(uint32_t cluster);
+  // WKLA 20261017
+  bool invalidateFSInfo();
+  bool writeFSInfo(uint32_t freeCount);
   bool isEOC(uint32_t cluster) const {
     if (FAT12_SUPPORT && m_fatType == 12) return  cluster >= FAT12EOC_MIN;
     if (m_fatType == 16) return cluster >= FAT16EOC_MIN;
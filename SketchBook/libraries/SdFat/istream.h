@@ -291,14 +291,15 @@ void istream::getNumber(T* value) {
   uint32_t tmp;
   if ((T)-1 < 0) {
     // number is signed, max positive value
-    uint32_t const m = ((uint32_t)-1) >> (33 - sizeof(T) * 8);
+    // WKLA 20261017 a 64 bit long (card emulator on the pc) is read with 32 bit like on the avr
+    uint32_t const m = ((uint32_t)-1) >> (33 - (sizeof(T) > 4 ? 4 : sizeof(T)) * 8);
     // max absolute value of negative number is m + 1.
     if (getNumber(m, m + 1, &tmp)) {
       *value = (T)tmp;
     }
   } else {
     // max unsigned value for T
-    uint32_t const m = (T)-1;
+    uint32_t const m = (uint32_t)(T)-1;
     if (getNumber(m, m, &tmp)) {
       *value = (T)tmp;
     }
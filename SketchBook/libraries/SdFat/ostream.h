@@ -175,7 +175,8 @@ class ostream : public virtual ios {
    * \return the stream
    */
   ostream &operator<< (long arg) {  // NOLINT
-    putNum(arg);
+    // WKLA 20261017 cast for 64 bit long (card emulator on the pc)
+    putNum((int32_t)arg);
     return *this;
   }
   /** Output unsigned long
@@ -183,7 +184,7 @@ class ostream : public virtual ios {
    * \return the stream
    */
   ostream &operator<< (unsigned long arg) {  // NOLINT
-    putNum(arg);
+    putNum((uint32_t)arg);
     return *this;
   }
   /** Output pointer
@@ -191,7 +192,7 @@ class ostream : public virtual ios {
    * \return the stream
    */
   ostream& operator<< (const void* arg) {
-    putNum(reinterpret_cast<uint32_t>(arg));
+    putNum((uint32_t)reinterpret_cast<uintptr_t>(arg));
     return *this;
   }
   /** Output a string from flash using the pstr() macro
@@ -17,6 +17,9 @@
   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
   Modified 2012 by Todd Krein (todd@krein.org) to implement repeated starts
+  Modified 17 October 2026 by Wilfried Klaas
+  - asynchronous register read (twi_readRegisterAsync), the caller doesn't wait for the bus
+  - twi_disable, with twi_init a hung transfer can be reset
 */
 
 #include <math.h>
@@ -47,6 +50,8 @@ static void (*twi_onSlaveTransmit)(void);
 static void (*twi_onSlaveReceive)(uint8_t*, int);
 
 static uint8_t twi_masterBuffer[TWI_BUFFER_LENGTH];
+// master receiver writes here, the master buffer or the data of an asynchronous read
+static uint8_t* twi_masterData = twi_masterBuffer;
 static volatile uint8_t twi_masterBufferIndex;
 static volatile uint8_t twi_masterBufferLength;
 
@@ -59,6 +64,11 @@ static volatile uint8_t twi_rxBufferIndex;
 
 static volatile uint8_t twi_error;
 
+static volatile uint8_t twi_asyncState;
+static uint8_t twi_asyncAddress;
+static uint8_t* twi_asyncData;
+static uint8_t twi_asyncLength;
+
 /* 
  * Function twi_init
  * Desc     readys twi pins and sets twi bitrate
@@ -71,6 +81,8 @@ void twi_init(void)
   twi_state = TWI_READY;
   twi_sendStop = true;		// default value
   twi_inRepStart = false;
+  twi_asyncState = TWI_ASYNC_IDLE;
+  twi_masterData = twi_masterBuffer;
   
   // activate internal pullups for twi.
   digitalWrite(SDA, 1);
@@ -90,6 +102,23 @@ void twi_init(void)
   TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWEA);
 }
 
+/* 
+ * Function twi_disable
+ * Desc     disables twi pins and the twi module, a running transfer is dropped.
+ *          Call twi_init to use the bus again.
+ * Input    none
+ * Output   none
+ */
+void twi_disable(void)
+{
+  // disable twi module, acks, and twi interrupt
+  TWCR &= ~(_BV(TWEN) | _BV(TWIE) | _BV(TWEA));
+
+  // deactivate internal pullups for twi.
+  digitalWrite(SDA, 0);
+  digitalWrite(SCL, 0);
+}
+
 /* 
  * Function twi_slaveInit
  * Desc     sets slave address and enables interrupt
@@ -131,6 +160,7 @@ uint8_t twi_readFrom(uint8_t address, uint8_t* data, uint8_t length, uint8_t sen
   twi_error = 0xFF;
 
   // initialize buffer iteration vars
+  twi_masterData = twi_masterBuffer;
   twi_masterBufferIndex = 0;
   twi_masterBufferLength = length-1;  // This is not intuitive, read on...
   // On receive, the previously configured ACK/NACK setting is transmitted in
@@ -253,6 +283,71 @@ uint8_t twi_writeTo(uint8_t address, uint8_t* data, uint8_t length, uint8_t wait
     return 4;	// other twi error
 }
 
+/* 
+ * Function twi_readRegisterAsync
+ * Desc     starts reading a series of bytes from a register of a device, without waiting.
+ *          The register address is written, then with a repeated start the bytes are read
+ *          directly into data. The transfer is done by the twi interrupt, check it with twi_asyncStatus().
+ *          data must not be touched until the transfer is done.
+ * Input    address: 7bit i2c device address
+ *          reg: register to read from
+ *          data: pointer to byte array
+ *          length: number of bytes to read into array (1..255)
+ * Output   1 .. transfer started
+ *          0 .. bus not ready (other transfer or repeated start pending), nothing started
+ */
+uint8_t twi_readRegisterAsync(uint8_t address, uint8_t reg, uint8_t* data, uint8_t length)
+{
+  if ((length == 0) || (TWI_READY != twi_state) || twi_inRepStart) {
+    return 0;
+  }
+  twi_state = TWI_MTX;
+  twi_sendStop = false;
+  twi_error = 0xFF;
+
+  twi_asyncAddress = address;
+  twi_asyncData = data;
+  twi_asyncLength = length;
+  twi_asyncState = TWI_ASYNC_REGISTER;
+
+  twi_masterBuffer[0] = reg;
+  twi_masterBufferIndex = 0;
+  twi_masterBufferLength = 1;
+
+  twi_slarw = TW_WRITE;
+  twi_slarw |= address << 1;
+
+  // send start condition
+  TWCR = _BV(TWINT) | _BV(TWEA) | _BV(TWEN) | _BV(TWIE) | _BV(TWSTA);
+  return 1;
+}
+
+/* 
+ * Function twi_asyncStatus
+ * Desc     state of the asynchronous read. TWI_ASYNC_DONE and TWI_ASYNC_ERROR are returned only once,
+ *          after that the state is TWI_ASYNC_IDLE again.
+ * Input    none
+ * Output   TWI_ASYNC_IDLE, TWI_ASYNC_REGISTER, TWI_ASYNC_DATA (running), TWI_ASYNC_DONE, TWI_ASYNC_ERROR
+ */
+uint8_t twi_asyncStatus(void)
+{
+  uint8_t state = twi_asyncState;
+  if ((state == TWI_ASYNC_DONE) || (state == TWI_ASYNC_ERROR)) {
+    twi_asyncState = TWI_ASYNC_IDLE;
+  }
+  return state;
+}
+
+/*
+ * an error ends a running asynchronous read
+ */
+static void twi_asyncFail(void)
+{
+  if ((twi_asyncState == TWI_ASYNC_REGISTER) || (twi_asyncState == TWI_ASYNC_DATA)) {
+    twi_asyncState = TWI_ASYNC_ERROR;
+  }
+}
+
 /* 
  * Function twi_transmit
  * Desc     fills slave tx buffer with data
@@ -379,6 +474,16 @@ ISR(TWI_vect)
         // copy data to output register and ack
         TWDR = twi_masterBuffer[twi_masterBufferIndex++];
         twi_reply(1);
+      }else if (twi_asyncState == TWI_ASYNC_REGISTER){
+        // register written, repeated start and read into the data of the caller
+        twi_asyncState = TWI_ASYNC_DATA;
+        twi_state = TWI_MRX;
+        twi_sendStop = true;
+        twi_slarw = TW_READ | (twi_asyncAddress << 1);
+        twi_masterData = twi_asyncData;
+        twi_masterBufferIndex = 0;
+        twi_masterBufferLength = twi_asyncLength - 1;
+        TWCR = _BV(TWINT) | _BV(TWSTA) | _BV(TWEN) | _BV(TWIE);
       }else{
 	if (twi_sendStop)
           twi_stop();
@@ -394,21 +499,24 @@ ISR(TWI_vect)
       break;
     case TW_MT_SLA_NACK:  // address sent, nack received
       twi_error = TW_MT_SLA_NACK;
+      twi_asyncFail();
       twi_stop();
       break;
     case TW_MT_DATA_NACK: // data sent, nack received
       twi_error = TW_MT_DATA_NACK;
+      twi_asyncFail();
       twi_stop();
       break;
     case TW_MT_ARB_LOST: // lost bus arbitration
       twi_error = TW_MT_ARB_LOST;
+      twi_asyncFail();
       twi_releaseBus();
       break;
 
     // Master Receiver
     case TW_MR_DATA_ACK: // data received, ack sent
       // put byte into buffer
-      twi_masterBuffer[twi_masterBufferIndex++] = TWDR;
+      twi_masterData[twi_masterBufferIndex++] = TWDR;
     case TW_MR_SLA_ACK:  // address sent, ack received
       // ack if more bytes are expected, otherwise nack
       if(twi_masterBufferIndex < twi_masterBufferLength){
@@ -419,7 +527,10 @@ ISR(TWI_vect)
       break;
     case TW_MR_DATA_NACK: // data received, nack sent
       // put final byte into buffer
-      twi_masterBuffer[twi_masterBufferIndex++] = TWDR;
+      twi_masterData[twi_masterBufferIndex++] = TWDR;
+      if (twi_asyncState == TWI_ASYNC_DATA) {
+        twi_asyncState = TWI_ASYNC_DONE;
+      }
 	if (twi_sendStop)
           twi_stop();
 	else {
@@ -432,6 +543,7 @@ ISR(TWI_vect)
 	}    
 	break;
     case TW_MR_SLA_NACK: // address sent, nack received
+      twi_asyncFail();
       twi_stop();
       break;
     // TW_MR_ARB_LOST handled by TW_MT_ARB_LOST case
@@ -520,6 +632,7 @@ ISR(TWI_vect)
       break;
     case TW_BUS_ERROR: // bus error, illegal stop/start
       twi_error = TW_BUS_ERROR;
+      twi_asyncFail();
       twi_stop();
       break;
   }
@@ -37,11 +37,21 @@
   #define TWI_MTX   2
   #define TWI_SRX   3
   #define TWI_STX   4
+
+  // state of the asynchronous register read
+  #define TWI_ASYNC_IDLE     0
+  #define TWI_ASYNC_REGISTER 1
+  #define TWI_ASYNC_DATA     2
+  #define TWI_ASYNC_DONE     3
+  #define TWI_ASYNC_ERROR    4
   
   void twi_init(void);
+  void twi_disable(void);
   void twi_setAddress(uint8_t);
   uint8_t twi_readFrom(uint8_t, uint8_t*, uint8_t, uint8_t);
   uint8_t twi_writeTo(uint8_t, uint8_t*, uint8_t, uint8_t, uint8_t);
+  uint8_t twi_readRegisterAsync(uint8_t, uint8_t, uint8_t*, uint8_t);
+  uint8_t twi_asyncStatus(void);
   uint8_t twi_transmit(const uint8_t*, uint8_t);
   void twi_attachSlaveRxEvent( void (*)(uint8_t*, int) );
   void twi_attachSlaveTxEvent( void (*)(void) );
@@ -0,0 +1,220 @@
+/*
+ nmeascan.h - vectorized line scanner and NMEA checksum check for the pc tools of the OpenSeaMap logger
+ Copyright (c) 2014 Wilfried Klaas.  All right reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ The rules are the rules of checkNMEAData() (osmfunctions.h): $ at the start, only printable characters
+ and the line ends with * and 2 hex digits, which are the xor of everything between $ and *.
+ So the first * must be at length - 3. The span between $ and * is checked 32 (AVX2) or 16 (SSE2) bytes
+ at a time: no character below 0x20 or above 0x7F (signed compare), no *, and the xor is accumulated.
+ The last bytes of the span are loaded overlapping and masked, so only lines shorter than 16 bytes
+ are checked byte by byte. Which version is used is decided at runtime, checkNMEAData() is the fallback.
+ Include osmfunctions.h before this file.
+ */
+#ifndef nmeascan_h
+#define nmeascan_h
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NMEASCAN_X86
+#endif
+
+typedef bool (*NMEACheckFunction)(const uint8_t* data, uint16_t length);
+typedef const char* (*LineEndFunction)(const char* data, const char* end);
+
+/**
+ * checking the 2 hex digits after the * against the xor.
+ **/
+inline bool checkNMEAChecksum(const uint8_t* data, uint16_t length, uint8_t crc) {
+  int8_t high = hexDigitValue(data[length - 2]);
+  int8_t low = hexDigitValue(data[length - 1]);
+  if ((high < 0) || (low < 0)) {
+    return false;
+  }
+  return (uint8_t) ((high << 4) | low) == crc;
+}
+
+/**
+ * scalar version, finding the line end with memchr.
+ **/
+inline const char* findLineEndScalar(const char* data, const char* end) {
+  const char* lineEnd = (const char*) memchr(data, '\n', end - data);
+  return lineEnd ? lineEnd : end;
+}
+
+#ifdef NMEASCAN_X86
+static const uint8_t nmeaTailMask[32] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
+/**
+ * xor of the 16 bytes of a vector.
+ **/
+__attribute__((target("sse2")))
+inline uint8_t reduceXor128(__m128i value) {
+  value = _mm_xor_si128(value, _mm_srli_si128(value, 8));
+  value = _mm_xor_si128(value, _mm_srli_si128(value, 4));
+  value = _mm_xor_si128(value, _mm_srli_si128(value, 2));
+  value = _mm_xor_si128(value, _mm_srli_si128(value, 1));
+  return (uint8_t) _mm_cvtsi128_si32(value);
+}
+
+/**
+ * bad characters of a vector: below 0x20, above 0x7F (negative) or *.
+ **/
+__attribute__((target("sse2")))
+inline __m128i badCharacters128(__m128i value) {
+  __m128i low = _mm_cmpgt_epi8(_mm_set1_epi8(0x20), value);
+  __m128i star = _mm_cmpeq_epi8(value, _mm_set1_epi8('*'));
+  return _mm_or_si128(low, star);
+}
+
+/**
+ * checking the last bytes (1..15) of the span, loaded overlapping from end - 16 and masked.
+ **/
+__attribute__((target("sse2")))
+inline bool checkTail128(const uint8_t* end, uint16_t count, __m128i* crc) {
+  __m128i mask = _mm_loadu_si128((const __m128i*) (nmeaTailMask + count));
+  __m128i value = _mm_and_si128(_mm_loadu_si128((const __m128i*) (end - 16)), mask);
+  if (_mm_movemask_epi8(_mm_and_si128(badCharacters128(value), mask))) {
+    return false;
+  }
+  *crc = _mm_xor_si128(*crc, value);
+  return true;
+}
+
+/**
+ * SSE2 version of checkNMEAData().
+ **/
+__attribute__((target("sse2")))
+bool checkNMEADataSSE2(const uint8_t* data, uint16_t length) {
+  if ((length < 4) || (data[0] != '$') || (data[length - 3] != '*')) {
+    return false;
+  }
+  uint16_t spanEnd = length - 3;
+  if (spanEnd < 17) {
+    return checkNMEAData(data, length);
+  }
+  __m128i crc = _mm_setzero_si128();
+  uint16_t i = 1;
+  for (; i + 16 <= spanEnd; i += 16) {
+    __m128i value = _mm_loadu_si128((const __m128i*) (data + i));
+    if (_mm_movemask_epi8(badCharacters128(value))) {
+      return false;
+    }
+    crc = _mm_xor_si128(crc, value);
+  }
+  if ((i < spanEnd) && !checkTail128(data + spanEnd, spanEnd - i, &crc)) {
+    return false;
+  }
+  return checkNMEAChecksum(data, length, reduceXor128(crc));
+}
+
+/**
+ * AVX2 version of checkNMEAData(), 32 bytes a time, the rest like SSE2.
+ **/
+__attribute__((target("avx2")))
+bool checkNMEADataAVX2(const uint8_t* data, uint16_t length) {
+  if ((length < 4) || (data[0] != '$') || (data[length - 3] != '*')) {
+    return false;
+  }
+  uint16_t spanEnd = length - 3;
+  if (spanEnd < 17) {
+    return checkNMEAData(data, length);
+  }
+  __m256i crc256 = _mm256_setzero_si256();
+  const __m256i space = _mm256_set1_epi8(0x20);
+  const __m256i star = _mm256_set1_epi8('*');
+  uint16_t i = 1;
+  for (; i + 32 <= spanEnd; i += 32) {
+    __m256i value = _mm256_loadu_si256((const __m256i*) (data + i));
+    __m256i bad = _mm256_or_si256(_mm256_cmpgt_epi8(space, value), _mm256_cmpeq_epi8(value, star));
+    if (_mm256_movemask_epi8(bad)) {
+      return false;
+    }
+    crc256 = _mm256_xor_si256(crc256, value);
+  }
+  __m128i crc = _mm_xor_si128(_mm256_castsi256_si128(crc256), _mm256_extracti128_si256(crc256, 1));
+  if (i + 16 <= spanEnd) {
+    __m128i value = _mm_loadu_si128((const __m128i*) (data + i));
+    if (_mm_movemask_epi8(badCharacters128(value))) {
+      return false;
+    }
+    crc = _mm_xor_si128(crc, value);
+    i += 16;
+  }
+  if ((i < spanEnd) && !checkTail128(data + spanEnd, spanEnd - i, &crc)) {
+    return false;
+  }
+  return checkNMEAChecksum(data, length, reduceXor128(crc));
+}
+
+/**
+ * SSE2 version of the line end search, 16 bytes a time.
+ **/
+__attribute__((target("sse2")))
+const char* findLineEndSSE2(const char* data, const char* end) {
+  const __m128i newLine = _mm_set1_epi8('\n');
+  for (; data + 16 <= end; data += 16) {
+    int found = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) data), newLine));
+    if (found) {
+      return data + __builtin_ctz(found);
+    }
+  }
+  return findLineEndScalar(data, end);
+}
+
+/**
+ * AVX2 version of the line end search, 32 bytes a time.
+ **/
+__attribute__((target("avx2")))
+const char* findLineEndAVX2(const char* data, const char* end) {
+  const __m256i newLine = _mm256_set1_epi8('\n');
+  for (; data + 32 <= end; data += 32) {
+    int found = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*) data), newLine));
+    if (found) {
+      return data + __builtin_ctz(found);
+    }
+  }
+  return findLineEndSSE2(data, end);
+}
+#endif
+
+/**
+ * the NMEA check and line end search for this cpu, forced with OSM_SCAN=scalar|sse2|avx2.
+ **/
+inline const char* selectNMEAScanner(NMEACheckFunction* check, LineEndFunction* lineEnd) {
+  const char* forced = getenv("OSM_SCAN");
+#ifdef NMEASCAN_X86
+  __builtin_cpu_init();
+  if ((!forced || !strcmp(forced, "avx2")) && __builtin_cpu_supports("avx2")) {
+    *check = checkNMEADataAVX2;
+    *lineEnd = findLineEndAVX2;
+    return "avx2";
+  }
+  if ((!forced || !strcmp(forced, "sse2")) && __builtin_cpu_supports("sse2")) {
+    *check = checkNMEADataSSE2;
+    *lineEnd = findLineEndSSE2;
+    return "sse2";
+  }
+#endif
+  *check = checkNMEAData;
+  *lineEnd = findLineEndScalar;
+  return "scalar";
+}
+
+#endif
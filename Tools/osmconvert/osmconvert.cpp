@@ -0,0 +1,474 @@
+/*
+ osmconvert.cpp - converting data files of the OpenSeaMap logger into GPX tracks and depth CSV files
+ Copyright (c) 2014 Wilfried Klaas.  All right reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ Every data file (text format hh:mm:ss.SSS;C;$...*CS) is memory mapped and read once.
+ For every data file two files are written:
+ dataNNNN.gpx: one track per channel with the positions of RMC (with date and time) and GGA (elevation)
+ dataNNNN.csv: depth of DBT sentences with the last known position
+ The sentences are checked with the rules of checkNMEAData() of the logger, wrong sentences are counted and skipped.
+ Lines the logger already marked as wrong (lower case channel marker) are skipped without checking.
+ Line ends and checksums are scanned with SSE2/AVX2 if the cpu has it (see nmeascan.h).
+ The files are converted in parallel, one file per thread.
+
+ build: g++ -O2 -pthread -o osmconvert osmconvert.cpp
+ usage: osmconvert [-j threads] [-o outputdir] [-v] data0001.dat data0002.dat ...
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#define PSTR(s) s
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../SketchBook/OpenSeaMap/osmfunctions.h"
+#include "../../SketchBook/OpenSeaMap/messages.h"
+#include "nmeascan.h"
+
+// length of the logger prefix hh:mm:ss.SSS;C;
+#define LINE_PREFIX_LENGTH 15
+#define MAX_FIELDS 24
+#define MAX_SENTENCE 128
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+
+NMEACheckFunction checkSentence;
+LineEndFunction findLineEnd;
+
+/**
+ * statistic of one converted file.
+ **/
+struct ConvertResult {
+  unsigned long long bytes;
+  unsigned long lines;
+  unsigned long badLines;
+  unsigned long points;
+  unsigned long depths;
+  bool ok;
+};
+
+/**
+ * one gps point of a channel, filled from RMC and GGA with the same time.
+ **/
+struct TrackPoint {
+  char utcTime[7];
+  double lat, lon;
+  bool valid;
+  bool hasElevation;
+  double elevation;
+};
+
+/**
+ * everything we know about one channel of the logger.
+ **/
+struct ChannelState {
+  std::string track;
+  TrackPoint point;
+  char date[7];
+};
+
+/**
+ * the last position of all channels, depth sentences mostly come on the other channel.
+ **/
+struct Position {
+  char utcTime[7];
+  double lat, lon;
+  bool valid;
+};
+
+/**
+ * splitting a sentence (without checksum) into its comma separated fields.
+ * The sentence is changed, every comma is replaced by a 0.
+ **/
+int splitFields(char* sentence, char** fields) {
+  int count = 0;
+  fields[count++] = sentence;
+  for (char* p = sentence; *p; p++) {
+    if (*p == ',') {
+      *p = '\0';
+      if (count < MAX_FIELDS) {
+        fields[count++] = p + 1;
+      }
+    }
+  }
+  return count;
+}
+
+/**
+ * converting a NMEA position (dddmm.mmmm) with hemisphere into degrees.
+ **/
+bool parseCoordinate(const char* value, const char* hemisphere, double* result) {
+  if (!*value || !*hemisphere) {
+    return false;
+  }
+  double raw = atof(value);
+  int degrees = (int) (raw / 100);
+  double coordinate = degrees + (raw - degrees * 100) / 60.0;
+  if ((*hemisphere == 'S') || (*hemisphere == 'W')) {
+    coordinate = -coordinate;
+  }
+  *result = coordinate;
+  return true;
+}
+
+/**
+ * copying the hhmmss part of a NMEA time field.
+ **/
+bool copyTime(const char* value, char* time) {
+  for (int i = 0; i < 6; i++) {
+    if (value[i] < '0' || value[i] > '9') {
+      return false;
+    }
+    time[i] = value[i];
+  }
+  time[6] = '\0';
+  return true;
+}
+
+/**
+ * writing the collected point of the channel as trkpt.
+ **/
+void flushPoint(ChannelState& channel, ConvertResult& result) {
+  TrackPoint& point = channel.point;
+  if (point.valid) {
+    char text[256];
+    int length = snprintf(text, sizeof(text), "      <trkpt lat=\"%.7f\" lon=\"%.7f\">", point.lat, point.lon);
+    if (point.hasElevation) {
+      length += snprintf(text + length, sizeof(text) - length, "<ele>%.2f</ele>", point.elevation);
+    }
+    if (channel.date[0]) {
+      // date ddmmyy, time hhmmss
+      length += snprintf(text + length, sizeof(text) - length, "<time>20%.2s-%.2s-%.2sT%.2s:%.2s:%.2sZ</time>",
+                         channel.date + 4, channel.date + 2, channel.date, point.utcTime, point.utcTime + 2,
+                         point.utcTime + 4);
+    }
+    length += snprintf(text + length, sizeof(text) - length, "</trkpt>\n");
+    channel.track.append(text, length);
+    result.points++;
+  }
+  point.valid = false;
+  point.hasElevation = false;
+  point.utcTime[0] = '\0';
+}
+
+/**
+ * getting the point of the channel for the time, an older point will be written.
+ **/
+TrackPoint& pointForTime(ChannelState& channel, const char* utcTime, ConvertResult& result) {
+  if (strcmp(channel.point.utcTime, utcTime) != 0) {
+    flushPoint(channel, result);
+    strcpy(channel.point.utcTime, utcTime);
+  }
+  return channel.point;
+}
+
+/**
+ * checking the sentence type, only RMC, GGA and DBT are processed.
+ **/
+inline bool isWantedSentence(const char* type) {
+  return !memcmp(type, "RMC,", 4) || !memcmp(type, "GGA,", 4) || !memcmp(type, "DBT,", 4);
+}
+
+/**
+ * remembering the last position.
+ **/
+void setPosition(Position& position, const char* utcTime, double lat, double lon) {
+  strcpy(position.utcTime, utcTime);
+  position.lat = lat;
+  position.lon = lon;
+  position.valid = true;
+}
+
+/**
+ * processing one checked sentence.
+ **/
+void processSentence(const char* loggerTime, ChannelState& channel, Position& position, char marker, char* sentence,
+                     FILE* csv, ConvertResult& result) {
+  char* fields[MAX_FIELDS];
+  int count = splitFields(sentence, fields);
+  const char* id = fields[0] + 1;
+  if (strlen(id) != 5) {
+    return;
+  }
+  const char* type = id + 2;
+  char utcTime[7];
+
+  if (!strcmp(type, "RMC") && (count >= 10)) {
+    // $--RMC,time,status,lat,N/S,lon,E/W,speed,course,date,...
+    if (copyTime(fields[1], utcTime) && (fields[2][0] == 'A')) {
+      double lat, lon;
+      if (parseCoordinate(fields[3], fields[4], &lat) && parseCoordinate(fields[5], fields[6], &lon)) {
+        if (strlen(fields[9]) == 6) {
+          strcpy(channel.date, fields[9]);
+        }
+        TrackPoint& point = pointForTime(channel, utcTime, result);
+        point.lat = lat;
+        point.lon = lon;
+        point.valid = true;
+        setPosition(position, utcTime, lat, lon);
+      }
+    }
+  } else if (!strcmp(type, "GGA") && (count >= 10)) {
+    // $--GGA,time,lat,N/S,lon,E/W,quality,satellites,hdop,altitude,M,...
+    if (copyTime(fields[1], utcTime) && (atoi(fields[6]) > 0)) {
+      double lat, lon;
+      if (parseCoordinate(fields[2], fields[3], &lat) && parseCoordinate(fields[4], fields[5], &lon)) {
+        TrackPoint& point = pointForTime(channel, utcTime, result);
+        point.lat = lat;
+        point.lon = lon;
+        point.valid = true;
+        if (fields[9][0]) {
+          point.elevation = atof(fields[9]);
+          point.hasElevation = true;
+        }
+        setPosition(position, utcTime, lat, lon);
+      }
+    }
+  } else if (!strcmp(type, "DBT") && (count >= 5)) {
+    // $--DBT,feet,f,meters,M,fathoms,F
+    if (fields[3][0]) {
+      fprintf(csv, "%.12s,%c,", loggerTime, marker);
+      if (position.valid) {
+        fprintf(csv, "%s,%.7f,%.7f,", position.utcTime, position.lat, position.lon);
+      } else {
+        fputs(",,,", csv);
+      }
+      fprintf(csv, "%s\n", fields[3]);
+      result.depths++;
+    }
+  }
+}
+
+/**
+ * opening an output file with a big buffer.
+ **/
+FILE* openOutput(const std::string& name, std::vector<char>& buffer) {
+  FILE* file = fopen(name.c_str(), "w");
+  if (file) {
+    buffer.resize(OUTPUT_BUFFER_SIZE);
+    setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+  }
+  return file;
+}
+
+/**
+ * converting one data file.
+ **/
+ConvertResult convertFile(const char* filename, const char* outputDir) {
+  ConvertResult result = {0, 0, 0, 0, 0, false};
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    perror(filename);
+    return result;
+  }
+  struct stat info;
+  if (fstat(fd, &info) < 0) {
+    perror(filename);
+    close(fd);
+    return result;
+  }
+  size_t size = info.st_size;
+  const char* data = NULL;
+  if (size > 0) {
+    data = (const char*) mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      perror(filename);
+      close(fd);
+      return result;
+    }
+    madvise((void*) data, size, MADV_SEQUENTIAL);
+  }
+  close(fd);
+
+  // output names: dataNNNN.gpx and dataNNNN.csv
+  std::string base = filename;
+  size_t dot = base.rfind('.');
+  size_t slash = base.rfind('/');
+  if ((dot != std::string::npos) && ((slash == std::string::npos) || (dot > slash))) {
+    base.erase(dot);
+  }
+  if (outputDir) {
+    base = std::string(outputDir) + "/" + base.substr(slash == std::string::npos ? 0 : slash + 1);
+  }
+  std::vector<char> gpxBuffer, csvBuffer;
+  FILE* gpx = openOutput(base + ".gpx", gpxBuffer);
+  FILE* csv = openOutput(base + ".csv", csvBuffer);
+  if (!gpx || !csv) {
+    perror(base.c_str());
+    if (gpx) fclose(gpx);
+    if (csv) fclose(csv);
+    if (data) munmap((void*) data, size);
+    return result;
+  }
+  fputs("loggertime,channel,utctime,lat,lon,depth\n", csv);
+
+  // channels A, B and I
+  ChannelState channels[3];
+  for (int i = 0; i < 3; i++) {
+    channels[i].point.valid = false;
+    channels[i].point.hasElevation = false;
+    channels[i].point.utcTime[0] = '\0';
+    channels[i].date[0] = '\0';
+  }
+  Position position;
+  position.valid = false;
+
+  char sentence[MAX_SENTENCE];
+  const char* pos = data;
+  const char* end = data + size;
+  while (pos < end) {
+    const char* lineEnd = findLineEnd(pos, end);
+    const char* line = pos;
+    size_t length = lineEnd - line;
+    pos = lineEnd + 1;
+    if ((length > 0) && (line[length - 1] == '\r')) {
+      length--;
+    }
+    if (length == 0) {
+      continue;
+    }
+    result.lines++;
+
+    // hh:mm:ss.SSS;C;$...*CS
+    if ((length <= LINE_PREFIX_LENGTH) || (line[12] != ';') || (line[14] != ';')) {
+      result.badLines++;
+      continue;
+    }
+    if (line[13] & CHANNEL_INVALID_FLAG) {
+      result.badLines++;
+      continue;
+    }
+    const uint8_t* nmea = (const uint8_t*) line + LINE_PREFIX_LENGTH;
+    uint16_t nmeaLength = length - LINE_PREFIX_LENGTH;
+    if ((nmeaLength >= MAX_SENTENCE) || !checkSentence(nmea, nmeaLength)) {
+      result.badLines++;
+      continue;
+    }
+    // only RMC, GGA and DBT are needed ($ttRMC,...)
+    if ((nmeaLength < 10) || !isWantedSentence((const char*) nmea + 3)) {
+      continue;
+    }
+    char marker = line[13];
+    int index = marker == 'A' ? 0 : (marker == 'B' ? 1 : 2);
+    // without the checksum
+    memcpy(sentence, nmea, nmeaLength - 3);
+    sentence[nmeaLength - 3] = '\0';
+    processSentence(line, channels[index], position, marker, sentence, csv, result);
+  }
+
+  fputs("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<gpx version=\"1.1\" creator=\"osmconvert\" xmlns=\"http://www.topografix.com/GPX/1/1\">\n", gpx);
+  for (int i = 0; i < 3; i++) {
+    flushPoint(channels[i], result);
+    if (!channels[i].track.empty()) {
+      fprintf(gpx, "  <trk>\n    <name>channel %c</name>\n    <trkseg>\n", "ABI"[i]);
+      fwrite(channels[i].track.data(), 1, channels[i].track.size(), gpx);
+      fputs("    </trkseg>\n  </trk>\n", gpx);
+    }
+  }
+  fputs("</gpx>\n", gpx);
+
+  result.ok = (fclose(gpx) == 0) & (fclose(csv) == 0);
+  if (data) {
+    munmap((void*) data, size);
+  }
+  result.bytes = size;
+  return result;
+}
+
+int main(int argc, char* argv[]) {
+  unsigned int threads = std::thread::hardware_concurrency();
+  const char* outputDir = NULL;
+  bool verbose = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "j:o:v")) != -1) {
+    switch (opt) {
+      case 'j':
+        threads = atoi(optarg);
+        break;
+      case 'o':
+        outputDir = optarg;
+        break;
+      case 'v':
+        verbose = true;
+        break;
+      default:
+        fprintf(stderr, "usage: osmconvert [-j threads] [-o outputdir] [-v] <data files>\n");
+        return 1;
+    }
+  }
+  if (optind >= argc) {
+    fprintf(stderr, "usage: osmconvert [-j threads] [-o outputdir] [-v] <data files>\n");
+    return 1;
+  }
+  int fileCount = argc - optind;
+  if (threads < 1) {
+    threads = 1;
+  }
+  if ((int) threads > fileCount) {
+    threads = fileCount;
+  }
+
+  const char* scanner = selectNMEAScanner(&checkSentence, &findLineEnd);
+  std::vector<ConvertResult> results(fileCount);
+  std::atomic<int> next(0);
+  struct timespec start, stop;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  std::vector<std::thread> workers;
+  for (unsigned int t = 0; t < threads; t++) {
+    workers.push_back(std::thread([&]() {
+      int i;
+      while ((i = next++) < fileCount) {
+        results[i] = convertFile(argv[optind + i], outputDir);
+      }
+    }));
+  }
+  for (size_t t = 0; t < workers.size(); t++) {
+    workers[t].join();
+  }
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+
+  ConvertResult total = {0, 0, 0, 0, 0, true};
+  for (int i = 0; i < fileCount; i++) {
+    if (verbose) {
+      fprintf(stderr, "%s: %lu lines, %lu bad, %lu points, %lu depths\n", argv[optind + i], results[i].lines,
+              results[i].badLines, results[i].points, results[i].depths);
+    }
+    total.bytes += results[i].bytes;
+    total.lines += results[i].lines;
+    total.badLines += results[i].badLines;
+    total.points += results[i].points;
+    total.depths += results[i].depths;
+    total.ok &= results[i].ok;
+  }
+  if (verbose) {
+    double seconds = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(stderr, "scanner %s\n", scanner);
+    fprintf(stderr, "%d files, %llu bytes, %lu lines, %lu bad, %lu points, %lu depths, %.2f s, %.1f MB/s\n",
+            fileCount, total.bytes, total.lines, total.badLines, total.points, total.depths, seconds,
+            total.bytes / 1e6 / seconds);
+  }
+  return total.ok ? 0 : 2;
+}
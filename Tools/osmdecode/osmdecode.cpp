@@ -0,0 +1,168 @@
+/*
+ osmdecode.cpp - decoder for the binary data files of the OpenSeaMap logger
+ Copyright (c) 2014 Wilfried Klaas.  All right reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ With the 3. config line bit 4 the logger writes binary data files. This program converts them
+ back into the text format of the logger (hh:mm:ss.SSS;C;data CR LF), byte for byte like the logger would
+ have written it. The timestamp and checksum functions are taken from the logger sources.
+
+ build: g++ -O2 -o osmdecode osmdecode.cpp
+ usage: osmdecode data0001.dat > data0001.txt
+
+ A record is: time delta (zigzag varint), channel, length, payload
+ channel A, B, I        : the received line (a, b: the NMEA check of the logger failed)
+ channel A, B, I | 0x80 : logger message, written as $payload*checksum
+ g, c                   : gyro/accelerator x, y, z (16 bit little endian)
+ v                      : voltage, norm voltage (16 bit little endian)
+ m                      : motion samples, rate and acc/gyro samples (16 bit big endian), time of the last sample
+ t                      : attitude, roll, pitch, heave (16 bit little endian)
+ A channel of 0 is the end of the data (rest of the preallocated file after a power fail).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#define PSTR(s) s
+#define strcpy_P strcpy
+#include "../../SketchBook/OpenSeaMap/osmfunctions.h"
+#include "../../SketchBook/OpenSeaMap/messages.h"
+
+/**
+ * reading a 16 bit little endian value.
+ **/
+int16_t readInt16(const uint8_t* data) {
+  return (int16_t) (data[0] | (data[1] << 8));
+}
+
+/**
+ * writing one line with timestamp and channel marker.
+ **/
+void writeLine(FILE* out, uint32_t time, char marker, const char* data, int length) {
+  setTimeStamp(time);
+  fwrite(timeStampText, 1, TIMESTAMP_LENGTH, out);
+  fputc(marker, out);
+  fputc(';', out);
+  fwrite(data, 1, length, out);
+  fputs("\r\n", out);
+}
+
+/**
+ * writing a logger message with $ and checksum.
+ **/
+void writeMessage(FILE* out, uint32_t time, char marker, const char* message) {
+  char line[MAX_NMEA_BUFFER + 8];
+  int length = snprintf(line, sizeof(line), "$%s*%02X", message, nmeaChecksum(message));
+  writeLine(out, time, marker, line, length);
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: osmdecode <binary data file>\n");
+    return 1;
+  }
+  FILE* in = fopen(argv[1], "rb");
+  if (!in) {
+    perror(argv[1]);
+    return 1;
+  }
+
+  char id[6];
+  strcpy_P(id, BINARY_FILE_ID);
+  uint8_t header[5];
+  if ((fread(header, 1, 5, in) != 5) || memcmp(header, id, 4) || (header[4] != BINARY_FILE_VERSION)) {
+    fprintf(stderr, "%s: not a binary data file of the logger\n", argv[1]);
+    return 1;
+  }
+
+  FILE* out = stdout;
+  uint32_t time = 0;
+  uint8_t buffer[MAX_VARINT_LENGTH + 2 + 256];
+  char message[MAX_NMEA_BUFFER + 1];
+  long records = 0;
+  while (true) {
+    // time delta, byte by byte until the last group
+    uint8_t pos = 0;
+    int c;
+    do {
+      c = fgetc(in);
+      if (c == EOF) {
+        break;
+      }
+      buffer[pos++] = c;
+    } while ((c & 0x80) && (pos < MAX_VARINT_LENGTH));
+    if (c == EOF) {
+      break;
+    }
+    int32_t delta;
+    if (decodeTimeDelta(buffer, pos, &delta) == 0) {
+      fprintf(stderr, "record %ld: wrong time delta\n", records);
+      return 2;
+    }
+    uint8_t channel_length[2];
+    if (fread(channel_length, 1, 2, in) != 2) {
+      break;
+    }
+    uint8_t channel = channel_length[0];
+    uint8_t length = channel_length[1];
+    if (channel == 0) {
+      break;
+    }
+    if (fread(buffer, 1, length, in) != length) {
+      fprintf(stderr, "record %ld: truncated\n", records);
+      return 2;
+    }
+    time += delta;
+    records++;
+
+    switch (channel) {
+      case BINARY_GYRO_RECORD:
+      case BINARY_ACC_RECORD:
+        snprintf(message, sizeof(message), channel == BINARY_GYRO_RECORD ? GYRO_MESSAGE : ACC_MESSAGE,
+                 readInt16(buffer), readInt16(buffer + 2), readInt16(buffer + 4));
+        writeMessage(out, time, CHANNEL_I_IDENTIFIER, message);
+        break;
+      case BINARY_ATTITUDE_RECORD:
+        snprintf(message, sizeof(message), ATTITUDE_MESSAGE, readInt16(buffer), readInt16(buffer + 2), readInt16(buffer + 4));
+        writeMessage(out, time, CHANNEL_I_IDENTIFIER, message);
+        break;
+      case BINARY_MOTION_RECORD:
+        if ((length > 0) && (buffer[0] > 0)) {
+          uint8_t samples = (length - 1) / MOTION_SAMPLE_SIZE;
+          for (uint8_t i = 0; i < samples; i++) {
+            const uint8_t* sample = buffer + 1 + i * MOTION_SAMPLE_SIZE;
+            snprintf(message, sizeof(message), MOTION_MESSAGE, motionValue(sample, 0), motionValue(sample, 1),
+                     motionValue(sample, 2), motionValue(sample, 3), motionValue(sample, 4), motionValue(sample, 5));
+            writeMessage(out, motionSampleTime(time, buffer[0], samples - 1 - i), CHANNEL_I_IDENTIFIER, message);
+          }
+        }
+        break;
+      case BINARY_VCC_RECORD:
+        snprintf(message, sizeof(message), VCC_MESSAGE, readInt16(buffer), readInt16(buffer + 2));
+        writeMessage(out, time, CHANNEL_I_IDENTIFIER, message);
+        break;
+      default:
+        if (channel & BINARY_NMEA_FLAG) {
+          memcpy(message, buffer, length < MAX_NMEA_BUFFER ? length : MAX_NMEA_BUFFER);
+          message[length < MAX_NMEA_BUFFER ? length : MAX_NMEA_BUFFER] = '\0';
+          writeMessage(out, time, channel & ~BINARY_NMEA_FLAG, message);
+        } else {
+          writeLine(out, time, channel, (const char*) buffer, length);
+        }
+    }
+  }
+  fclose(in);
+  return 0;
+}
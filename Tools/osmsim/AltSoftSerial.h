@@ -0,0 +1,44 @@
+/*
+ AltSoftSerial.h - channel B of the logger simulation, the interface of the logger's AltSoftSerial
+ Copyright (c) 2014 Wilfried Klaas.  All right reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ Only receiving, written bytes are dropped.
+ */
+#ifndef osmsim_AltSoftSerial_h
+#define osmsim_AltSoftSerial_h
+#include <Arduino.h>
+
+class AltSoftSerial : public Stream {
+ public:
+  void begin(uint32_t baud);
+  void end();
+  int peek();
+  int read();
+  int available();
+  size_t write(uint8_t c) {
+    return 1;
+  }
+  using Print::write;
+  void flush() {}
+  // using the memory as receive buffer (max. 255 bytes), must be called before begin()
+  void setRxBuffer(uint8_t* memory, uint8_t size);
+  uint16_t overflowCount();
+  // receive time (millis) of the first byte of the line the last read() byte belongs to
+  unsigned long lineTime();
+};
+
+#endif
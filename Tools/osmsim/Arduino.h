@@ -0,0 +1,63 @@
+/*
+ Arduino.h - the part of the Arduino core the logger needs, for the logger simulation on the pc
+ Copyright (c) 2014 Wilfried Klaas.  All right reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ Print, Stream and the time (millis(), micros(), delay()) are the ones of the card emulator
+ (Tools/sdemu/Arduino.h), the time is advanced by the cpu model and the card (sim.h).
+ Serial and AltSoftSerial are the receive channels of the simulation.
+ */
+#ifndef osmsim_Arduino_h
+#define osmsim_Arduino_h
+#include <math.h>
+#include <avr/pgmspace.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#define HOST_HARDWARE_SERIAL
+#include "../sdemu/Arduino.h"
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#define lowByte(w) ((uint8_t) ((w) & 0xff))
+#define highByte(w) ((uint8_t) ((w) >> 8))
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+// only constant strings
+class String {
+ public:
+  String(const char* value) : buffer(value) {}
+  const char* c_str() const {
+    return buffer;
+  }
+
+ private:
+  const char* buffer;
+};
+
+#include "HardwareSerial.h"
+
+#endif
@@ -0,0 +1,35 @@
+/*
+ EEPROM.h - the EEPROM library of the Arduino core, for the logger simulation
+ Copyright (c) 2014 Wilfried Klaas.  All right reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef osmsim_EEPROM_h
+#define osmsim_EEPROM_h
+#include <avr/eeprom.h>
+
+class EEPROMClass {
+ public:
+  uint8_t read(int address) {
+    return eeprom_read_byte((const uint8_t*) (uintptr_t) address);
+  }
+  void write(int address, uint8_t value) {
+    eeprom_write_byte((uint8_t*) (uintptr_t) address, value);
+  }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
@@ -0,0 +1,54 @@
+/*
+ HardwareSerial.h - channel A of the logger simulation, the interface of the logger's core
+ Copyright (c) 2014 Wilfried Klaas.  All right reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ Only receiving, written bytes go to stdout. Seatalk isn't simulated, there are no datagrams.
+ */
+#ifndef osmsim_HardwareSerial_h
+#define osmsim_HardwareSerial_h
+#include <inttypes.h>
+
+#define SERIAL_8N1 0x06
+#define SERIAL_9N1 0x07
+
+// a seatalk datagram has max. 18 bytes (command, attribute with 4 bit length, 16 data bytes)
+#define SEATALK_MAX_DATAGRAM 18
+
+class HardwareSerial : public Stream {
+ public:
+  void begin(unsigned long baud) {
+    begin(baud, SERIAL_8N1);
+  }
+  void begin(unsigned long baud, uint8_t config);
+  void beginSeaTalk();
+  void setRxBuffer(unsigned char* memory, unsigned char size, bool nineBit);
+  void end();
+  int available();
+  int peek();
+  int read();
+  void flush();
+  size_t write(uint8_t c);
+  using Print::write;
+  uint8_t readDatagram(uint8_t* data, uint8_t size);
+  uint16_t datagramErrors();
+  uint16_t overflowCount();
+  unsigned long lineTime();
+};
+
+extern HardwareSerial Serial;
+
+#endif
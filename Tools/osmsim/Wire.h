@@ -0,0 +1,30 @@
+/*
+ Wire.h - the I2C bus of the logger simulation, the MPU6050 is a register model (mpu6050.cpp)
+ Copyright (c) 2014 Wilfried Klaas.  All right reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef osmsim_Wire_h
+#define osmsim_Wire_h
+#include <Arduino.h>
+
+class TwoWire {
+ public:
+  void begin();
+};
+
+extern TwoWire Wire;
+
+#endif
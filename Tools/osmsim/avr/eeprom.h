@@ -0,0 +1,45 @@
+/*
+ avr/eeprom.h - eeprom of the logger simulation
+ Copyright (c) 2014 Wilfried Klaas.  All right reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ 1 kB in memory, erased (0xFF) at the start. Every written byte takes the programming time.
+ A byte, which isn't programmed before the power loss (simCutoff, sim.h), keeps its old value.
+ */
+#ifndef osmsim_eeprom_h
+#define osmsim_eeprom_h
+#include <stdint.h>
+#include <avr/io.h>
+
+// programming time of one byte (3.3 ms in the data sheet), the avr waits for it
+#define EEPROM_WRITE_US 3300
+
+extern uint8_t simEeprom[E2END + 1];
+extern uint64_t hostMicros;
+extern uint64_t simCutoff;
+
+inline uint8_t eeprom_read_byte(const uint8_t* address) {
+  return simEeprom[(uintptr_t) address & E2END];
+}
+
+inline void eeprom_write_byte(uint8_t* address, uint8_t value) {
+  if (hostMicros + EEPROM_WRITE_US <= simCutoff) {
+    simEeprom[(uintptr_t) address & E2END] = value;
+  }
+  hostMicros += EEPROM_WRITE_US;
+}
+
+#endif
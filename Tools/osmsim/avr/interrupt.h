@@ -0,0 +1,30 @@
+/*
+ avr/interrupt.h - interrupts of the logger simulation
+ Copyright (c) 2014 Wilfried Klaas.  All right reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ An ISR is a normal function, called by the simulation (sim.cpp) while the I flag of SREG is set.
+ */
+#ifndef osmsim_interrupt_h
+#define osmsim_interrupt_h
+#include <avr/io.h>
+
+#define sei() (SREG |= 0x80)
+#define cli() (SREG &= ~0x80)
+
+#define ISR(vector, ...) extern "C" void vector(void)
+
+#endif
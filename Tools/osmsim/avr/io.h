@@ -0,0 +1,68 @@
+/*
+ avr/io.h - the registers of the ATmega328P the logger uses, for the logger simulation
+ Copyright (c) 2014 Wilfried Klaas.  All right reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ The registers are variables. A conversion started with ADSC ends after the conversion time
+ (simAdcsra() in sim.cpp), the value (ADC) is the 1.1V reference of the simulated supply voltage.
+ */
+#ifndef osmsim_io_h
+#define osmsim_io_h
+#include <stdint.h>
+
+#define RAMEND 0x8FF
+#define E2END 0x3FF
+
+#define _BV(bit) (1 << (bit))
+#define bit_is_set(sfr, bit) ((sfr) & _BV(bit))
+#define bit_is_clear(sfr, bit) (!((sfr) & _BV(bit)))
+#define _SFR_BYTE(sfr) (sfr)
+
+extern volatile uint8_t SREG;
+extern volatile uint8_t PORTB, PORTC, PORTD;
+extern volatile uint8_t DDRB, DDRC, DDRD;
+
+extern volatile uint8_t ADMUX, ADCSRB;
+extern volatile uint16_t simAdc;
+volatile uint8_t& simAdcsra();
+#define ADCSRA (simAdcsra())
+#define ADC (simAdc)
+#define ADCL ((uint8_t) simAdc)
+#define ADCH ((uint8_t) (simAdc >> 8))
+
+// ADMUX
+#define REFS1 7
+#define REFS0 6
+#define ADLAR 5
+#define MUX3 3
+#define MUX2 2
+#define MUX1 1
+#define MUX0 0
+// ADCSRA
+#define ADEN 7
+#define ADSC 6
+#define ADATE 5
+#define ADIF 4
+#define ADIE 3
+#define ADPS2 2
+#define ADPS1 1
+#define ADPS0 0
+// ADCSRB
+#define ADTS2 2
+#define ADTS1 1
+#define ADTS0 0
+
+#endif
@@ -0,0 +1,59 @@
+/*
+ avr/pgmspace.h - flash access of the logger simulation, the flash strings are normal strings
+ Copyright (c) 2014 Wilfried Klaas.  All right reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ The logger reads the flash of the bootloader by address (CalculateChecksum), addresses below 32 kB
+ are the flash of the avr and read as erased flash (0xFF).
+ */
+#ifndef osmsim_pgmspace_h
+#define osmsim_pgmspace_h
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// SdBaseFile.h defines its own versions for other cpus before it includes Arduino.h
+#undef PROGMEM
+#undef PGM_P
+#undef PSTR
+#undef pgm_read_byte
+#undef pgm_read_word
+
+#define PROGMEM
+#define PGM_P const char*
+#define PSTR(s) (s)
+
+#define FLASH_SIZE 0x8000
+
+inline uint8_t simFlashByte(const void* p) {
+  return ((uintptr_t) p < FLASH_SIZE) ? 0xFF : *(const uint8_t*) p;
+}
+
+inline uint16_t simFlashWord(const void* p) {
+  return ((uintptr_t) p < FLASH_SIZE) ? 0xFFFF : *(const uint16_t*) p;
+}
+
+#define pgm_read_byte(p) simFlashByte((const void*) (p))
+#define pgm_read_word(p) simFlashWord((const void*) (p))
+
+#define strcpy_P strcpy
+#define strlen_P strlen
+#define strncmp_P strncmp
+#define strcat_P strcat
+#define memcpy_P memcpy
+#define sprintf_P sprintf
+
+#endif
@@ -0,0 +1,46 @@
+#!/bin/bash
+# ino2cpp.sh
+#
+# Purpose:
+#   o the sketch as c++ file, like the Arduino IDE makes it: Arduino.h first, the prototypes of the functions
+#     after the last include before the first function
+#   o a function is a definition in the first column, ending with the opening brace on the same line
+#
+# Usage:
+#   ino2cpp.sh sketch.ino > sketch.cpp
+#
+# Background:
+#   o sketchhost.h comes after the includes too, it adapts the sketch to the pc
+#   o #line keeps the errors and warnings on the lines of the sketch
+#
+awk '
+{ line[NR] = $0 }
+END {
+  for (i = 1; i <= NR; i++) {
+    if ((line[i] ~ /^[A-Za-z_][A-Za-z0-9_]*[ *&][^=;]*\)[ \t]*\{/) && (line[i] !~ /^(ISR|if|else|for|while|switch|return|struct|class|typedef|enum)[ (]/)) {
+      count++
+      prototype[count] = line[i]
+      sub(/[ \t]*\{.*$/, ";", prototype[count])
+      if (!first) {
+        first = i
+      }
+    }
+  }
+  for (i = 1; i < first; i++) {
+    if (line[i] ~ /^#include/) {
+      last = i
+    }
+  }
+  print "#include <Arduino.h>"
+  printf "#line 1 \"%s\"\n", FILENAME
+  for (i = 1; i <= NR; i++) {
+    print line[i]
+    if (i == last) {
+      print "#include \"sketchhost.h\""
+      for (j = 1; j <= count; j++) {
+        print prototype[j]
+      }
+      printf "#line %d \"%s\"\n", i + 1, FILENAME
+    }
+  }
+}' "$1"
@@ -0,0 +1,246 @@
+/*
+ mpu6050.cpp - the MPU6050 of the logger simulation: the registers the logger uses and the methods of the
+ MPU6050 class the logger calls
+ Copyright (c) 2014 Wilfried Klaas.  All right reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ The axes are slow sine waves, the board lies flat (1 g on z). The FIFO is filled with the sample rate
+ (1 kHz / (SMPLRT_DIV + 1) with the low pass filter on) and overflows at 1024 bytes like the real one.
+ Every register access of the class waits for the I2C bus like Wire does.
+ */
+#include <Arduino.h>
+#include <MPU6050.h>
+#include "sim.h"
+
+#define SIM_MPU_FIFO_SIZE 1024
+
+static uint8_t registers[128];
+// time of the next sample into the FIFO, the samples written since the reset and the bytes in the FIFO
+static uint64_t fifoTime;
+static uint32_t fifoSamples;
+static uint16_t fifoCount;
+static bool initialized = false;
+
+static void mpuInit() {
+  if (!initialized) {
+    registers[MPU6050_RA_PWR_MGMT_1] = 0x40;
+    registers[MPU6050_RA_WHO_AM_I] = 0x68;
+    initialized = true;
+  }
+}
+
+static uint32_t samplePeriod() {
+  uint8_t dlpf = registers[MPU6050_RA_CONFIG] & 0x07;
+  uint32_t rate = ((dlpf == 0) || (dlpf == 7)) ? 8000 : 1000;
+  return (1000000UL * (registers[MPU6050_RA_SMPLRT_DIV] + 1)) / rate;
+}
+
+static uint8_t sampleSize() {
+  uint8_t enabled = registers[MPU6050_RA_FIFO_EN];
+  uint8_t size = 0;
+  if (enabled & 0x80) {
+    size += 2;
+  }
+  for (uint8_t bit = 4; bit <= 6; bit++) {
+    if (enabled & _BV(bit)) {
+      size += 2;
+    }
+  }
+  if (enabled & 0x08) {
+    size += 6;
+  }
+  return size;
+}
+
+/**
+ * value of the register ACCEL_XOUT_H + 2 * axis at the time in µs (accel x, y, z, temperature, gyro x, y, z).
+ **/
+static int16_t axisValue(uint8_t axis, uint64_t time) {
+  double t = time / 1e6;
+  switch (axis) {
+    case 0:
+      return 2000 * sin(2 * M_PI * 0.10 * t);
+    case 1:
+      return 1500 * sin(2 * M_PI * 0.125 * t);
+    case 2:
+      return 16384 + 800 * sin(2 * M_PI * 0.2 * t);
+    case 3:
+      return -1500;
+    default:
+      return 300 * cos(2 * M_PI * (0.1 + 0.05 * axis) * t);
+  }
+}
+
+/**
+ * byte at the offset of a FIFO sample, the enabled values in the order of their registers.
+ **/
+static uint8_t sampleByte(uint32_t sample, uint8_t offset) {
+  uint64_t time = fifoTime - (uint64_t) (fifoSamples - 1 - sample) * samplePeriod();
+  uint8_t enabled = registers[MPU6050_RA_FIFO_EN];
+  uint8_t pos = 0;
+  for (uint8_t axis = 0; axis < 7; axis++) {
+    bool on = (axis < 3) ? (enabled & 0x08) : (axis == 3) ? (enabled & 0x80) : (enabled & _BV(10 - axis));
+    if (on) {
+      if (offset < pos + 2) {
+        int16_t value = axisValue(axis, time);
+        return (offset == pos) ? value >> 8 : value & 0xFF;
+      }
+      pos += 2;
+    }
+  }
+  return 0;
+}
+
+/**
+ * samples into the FIFO until now.
+ **/
+static void fillFifo() {
+  if (!(registers[MPU6050_RA_USER_CTRL] & _BV(MPU6050_USERCTRL_FIFO_EN_BIT))) {
+    fifoTime = hostMicros;
+    return;
+  }
+  uint8_t size = sampleSize();
+  uint32_t period = samplePeriod();
+  while (fifoTime + period <= hostMicros) {
+    fifoTime += period;
+    fifoSamples++;
+    fifoCount += size;
+    if (fifoCount > SIM_MPU_FIFO_SIZE) {
+      fifoCount = SIM_MPU_FIFO_SIZE;
+    }
+  }
+}
+
+uint8_t simMpuRead(uint8_t reg) {
+  mpuInit();
+  reg &= 0x7F;
+  fillFifo();
+  if ((reg >= MPU6050_RA_ACCEL_XOUT_H) && (reg < MPU6050_RA_ACCEL_XOUT_H + 14)) {
+    int16_t value = axisValue((reg - MPU6050_RA_ACCEL_XOUT_H) / 2, hostMicros);
+    return ((reg - MPU6050_RA_ACCEL_XOUT_H) & 1) ? value & 0xFF : value >> 8;
+  }
+  switch (reg) {
+    case MPU6050_RA_FIFO_COUNTH:
+      return fifoCount >> 8;
+    case MPU6050_RA_FIFO_COUNTL:
+      return fifoCount & 0xFF;
+    case MPU6050_RA_FIFO_R_W: {
+      if (fifoCount == 0) {
+        return 0;
+      }
+      uint8_t size = sampleSize();
+      uint32_t next = fifoSamples * size - fifoCount;
+      fifoCount--;
+      return sampleByte(next / size, next % size);
+    }
+    default:
+      return registers[reg];
+  }
+}
+
+void simMpuWrite(uint8_t reg, uint8_t value) {
+  mpuInit();
+  reg &= 0x7F;
+  fillFifo();
+  if (reg == MPU6050_RA_USER_CTRL) {
+    if (value & _BV(MPU6050_USERCTRL_FIFO_RESET_BIT)) {
+      fifoCount = 0;
+      fifoSamples = 0;
+      fifoTime = hostMicros;
+      value &= ~_BV(MPU6050_USERCTRL_FIFO_RESET_BIT);
+    }
+  }
+  registers[reg] = value;
+}
+
+/**
+ * read modify write of bits like I2Cdev::writeBits(), with the time of the 2 transfers.
+ **/
+static void writeBits(uint8_t reg, uint8_t bitStart, uint8_t length, uint8_t data) {
+  hostMicros += simTwiMicros(1) * 2;
+  uint8_t mask = ((1 << length) - 1) << (bitStart - length + 1);
+  data <<= (bitStart - length + 1);
+  simMpuWrite(reg, (simMpuRead(reg) & ~mask) | (data & mask));
+}
+
+static void writeBit(uint8_t reg, uint8_t bit, bool enabled) {
+  writeBits(reg, bit, 1, enabled);
+}
+
+MPU6050::MPU6050() {
+  devAddr = MPU6050_DEFAULT_ADDRESS;
+}
+
+MPU6050::MPU6050(uint8_t address) {
+  devAddr = address;
+}
+
+void MPU6050::initialize() {
+  writeBits(MPU6050_RA_PWR_MGMT_1, MPU6050_PWR1_CLKSEL_BIT, MPU6050_PWR1_CLKSEL_LENGTH, MPU6050_CLOCK_PLL_XGYRO);
+  setFullScaleGyroRange(MPU6050_GYRO_FS_250);
+  setFullScaleAccelRange(MPU6050_ACCEL_FS_2);
+  writeBit(MPU6050_RA_PWR_MGMT_1, MPU6050_PWR1_SLEEP_BIT, false);
+}
+
+bool MPU6050::testConnection() {
+  return getDeviceID() == 0x34;
+}
+
+uint8_t MPU6050::getDeviceID() {
+  hostMicros += simTwiMicros(1);
+  return (simMpuRead(MPU6050_RA_WHO_AM_I) >> 1) & 0x3F;
+}
+
+void MPU6050::setRate(uint8_t rate) {
+  hostMicros += simTwiMicros(1);
+  simMpuWrite(MPU6050_RA_SMPLRT_DIV, rate);
+}
+
+void MPU6050::setDLPFMode(uint8_t mode) {
+  writeBits(MPU6050_RA_CONFIG, MPU6050_CFG_DLPF_CFG_BIT, MPU6050_CFG_DLPF_CFG_LENGTH, mode);
+}
+
+void MPU6050::setFullScaleGyroRange(uint8_t range) {
+  writeBits(MPU6050_RA_GYRO_CONFIG, MPU6050_GCONFIG_FS_SEL_BIT, MPU6050_GCONFIG_FS_SEL_LENGTH, range);
+}
+
+void MPU6050::setFullScaleAccelRange(uint8_t range) {
+  writeBits(MPU6050_RA_ACCEL_CONFIG, MPU6050_ACONFIG_AFS_SEL_BIT, MPU6050_ACONFIG_AFS_SEL_LENGTH, range);
+}
+
+void MPU6050::setXGyroFIFOEnabled(bool enabled) {
+  writeBit(MPU6050_RA_FIFO_EN, MPU6050_XG_FIFO_EN_BIT, enabled);
+}
+
+void MPU6050::setYGyroFIFOEnabled(bool enabled) {
+  writeBit(MPU6050_RA_FIFO_EN, MPU6050_YG_FIFO_EN_BIT, enabled);
+}
+
+void MPU6050::setZGyroFIFOEnabled(bool enabled) {
+  writeBit(MPU6050_RA_FIFO_EN, MPU6050_ZG_FIFO_EN_BIT, enabled);
+}
+
+void MPU6050::setAccelFIFOEnabled(bool enabled) {
+  writeBit(MPU6050_RA_FIFO_EN, MPU6050_ACCEL_FIFO_EN_BIT, enabled);
+}
+
+void MPU6050::setFIFOEnabled(bool enabled) {
+  writeBit(MPU6050_RA_USER_CTRL, MPU6050_USERCTRL_FIFO_EN_BIT, enabled);
+}
+
+void MPU6050::resetFIFO() {
+  writeBit(MPU6050_RA_USER_CTRL, MPU6050_USERCTRL_FIFO_RESET_BIT, true);
+}
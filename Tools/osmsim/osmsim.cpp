@@ -0,0 +1,939 @@
+/*
+ osmsim.cpp - replay benchmark of the logger: the sketch runs on the pc with the emulated sd card
+ Copyright (c) 2014 Wilfried Klaas.  All right reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ The lines of a NMEA file are sent to channel A and B at the baudrate (10 bits per byte), with the times
+ of the file or back to back (full bus load). The sketch (OpenSeaMap.ino) runs like on the logger:
+ setup() with config.dat on the card, then loop() until the lines are sent, then the stop switch
+ (or a power fail). The time of the logger is the cpu model and the card, see sim.h.
+ The lines are sent from the full 100 ms after the first pass of the loop, it creates the data file and starts the
+ receivers.
+ At the end the data files are read back and the logged lines are compared with the sent ones.
+ Output per channel: sentences per second, cpu cycles per received byte (loop and interrupt),
+ dropped lines (not in the file), garbled lines (in the file, but not sent like this), the overflows
+ of the receive ring and the error of the timestamps (text format). Then the size of the data files, their records (lines or binary records) and the cycles
+ of the channels (loop with the polling) per logged line. The time of the passes of the loop (average, 99.9 %, max.)
+ and the longest time a byte waited in a receive ring is the latency of the logger, the max. fill of the rings is
+ the RAM of them really needed.
+ The block writer prints its streamed blocks and the longest block write (the value of $POSMBLK).
+
+ build: make -C .. osmsim (Tools/Makefile)
+ usage: osmsim [-a baud] [-b baud] [-t seconds] [-f] [-k cycles] [-i flush seconds] [-g motion rate]
+               [-r attitude rate] [-o outputs] [-c] [-z cut us] [-n files] [-u number] [-h seconds] [-e]
+               [-p stalls per mille] [-s stall ms] [-w] [-m] [-y] [-l] [-x directory] image nmea file
+ -a, -b are the baudrates of the channels (4800, 0 = off, B max. 4800), -t the seconds of sending (60),
+ -f sends the lines back to back instead of with the times of the file, -k the cycles per basic block (6),
+ -i, -g, -r, -o are the lines of config.dat (60, 0, 0, 2, see OpenSeaMap.ino), the lines of the channels are
+ compared in the text and in the binary format (-o bit 4).
+ -c ends with a power fail (cut supply) instead of the stop switch.
+ -z cuts the rest of the supply (the gold cap) so many µs after the power fail (implies -c): the card and the EEPROM
+ write nothing after that. Then the card is mounted again like at the next start, the data file is checked (zeros
+ inside its size, clusters behind its size) before and after freeFileTail() of the sketch, and the shutdown record
+ in the EEPROM (complete or none). Fails (exit 2) on an inconsistent file or a tail, which isn't freed.
+ -p, -s are the written blocks with a stall of the card per mille and its length (0, 200 ms, like sdbench).
+ -w hides the busy card from logReady(), the logger waits in the next block write like it did before.
+ -m takes the time of a line when the loop reads its first byte (millis()) like the logger did before, not in the
+ receive interrupt. The timestamps of the text lines are compared with the receive time of their first byte.
+ -y waits for the I2C bus in every gyro transfer like the blocking reads the logger did before the TWI interrupt.
+ -l fails (exit 2) on any byte lost in a receive ring and any dropped or garbled line.
+ -x copies the data files into the directory (e.g. for osmdecode, make binary).
+ -n creates the data files data0001.dat up to the count before the start (more than about 500 files need a FAT32
+ image of mkfat32). The name of the new data file is checked. -u removes the data file with the number again
+ (a deleted file), with -n 9999 the logger has to take this number, without it no number is left.
+ -h switches the logger on so many seconds before the full hour of its clock (more than the 33 s of the setup), the
+ hourly data file is rotated then. The pass of the loop with the new file is timed, and for comparison the free
+ cluster count by reading the whole FAT, like every new file did it before the volume kept the count. Fails
+ (exit 2) without a rotation.
+ -e clears the next free cluster of the FSINFO (FAT32) before the start, the search for the first cluster of the
+ data file starts at the beginning of the card like before the hint, e.g. on a full image of mkfat32 -f.
+ The image is e.g. ../../test/image.dd.gz (unpacked into a temporary file), the NMEA file
+ e.g. ../../test/20130629_135830.nmea.gz.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <SdFat.h>
+#include <avr/eeprom.h>
+#include "sim.h"
+#include "../../SketchBook/OpenSeaMap/messages.h"
+#include "../../SketchBook/OpenSeaMap/config.h"
+
+// the macros of Arduino.h, std::min and std::max are used here
+#undef min
+#undef max
+
+// time after the last sent line until the stop, the logger writes the rest
+#define DRAIN_US 2000000ULL
+// voltage of the power fail
+#define POWER_FAIL_VCC 4000
+// a pass of the loop longer than this is counted (µs)
+#define LONG_PASS_US 5000
+// a dropped line is searched so many lines ahead
+#define MATCH_WINDOW 1000
+
+// the sketch
+extern SdFat sd;
+extern SdFile dataFile;
+extern char filename[];
+extern boolean error;
+// the block writer (blockwriter.h), its state stays after the data file is closed
+extern uint32_t firstBlock, actBlock;
+extern unsigned long maxBlockTime;
+void setup();
+void loop();
+void testSerialA();
+void testSerialB();
+void pollGyro(unsigned long now);
+void freeFileTail(word number);
+
+struct NmeaLine {
+  uint64_t time;
+  std::string text;
+};
+
+/**
+ * the lines of the NMEA file as bytes of a channel, every line ends with CR LF.
+ **/
+class ReplaySource : public SimSource {
+ public:
+  ReplaySource(const std::vector<NmeaLine>* lines, uint32_t baud, uint64_t start, uint64_t end, bool backToBack)
+    : lines(lines), byteUs(10000000.0 / baud), start(start), end(end), backToBack(backToBack), next(0), pos(0),
+      lineStart(start) {
+  }
+
+  bool peek(uint64_t* time) {
+    if ((next >= lines->size()) || (lineStart >= end)) {
+      return false;
+    }
+    *time = lineStart + (uint64_t) ((pos + 1) * byteUs);
+    return true;
+  }
+
+  uint8_t take() {
+    const std::string& text = (*lines)[next].text;
+    uint8_t c = (pos < text.size()) ? text[pos] : ((pos == text.size()) ? '\r' : '\n');
+    pos++;
+    if (pos == text.size() + 2) {
+      sent.push_back(text);
+      sentTimes.push_back(lineStart + (uint64_t) byteUs);
+      uint64_t lineEnd = lineStart + (uint64_t) (pos * byteUs);
+      pos = 0;
+      next++;
+      lineStart = lineEnd;
+      if (!backToBack && (next < lines->size())) {
+        lineStart = std::max(lineEnd, start + (*lines)[next].time);
+      }
+    }
+    return c;
+  }
+
+  // lines sent completely, the bytes of the channel, and the receive time of their first byte (µs)
+  std::vector<std::string> sent;
+  std::vector<uint64_t> sentTimes;
+
+ private:
+  const std::vector<NmeaLine>* lines;
+  double byteUs;
+  uint64_t start;
+  uint64_t end;
+  bool backToBack;
+  size_t next;
+  size_t pos;
+  uint64_t lineStart;
+};
+
+/**
+ * reading the lines of the NMEA file (time: line) with the time in µs since the first line.
+ **/
+bool readLines(const char* path, std::vector<NmeaLine>* lines) {
+  std::string command = std::string("gzip -dcf '") + path + "'";
+  FILE* file = popen(command.c_str(), "r");
+  if (!file) {
+    return false;
+  }
+  char line[1024];
+  double first = -1;
+  double time = 0;
+  while (fgets(line, sizeof(line), file)) {
+    line[strcspn(line, "\r\n")] = 0;
+    char* text = line;
+    int year, month, day, hour, minute;
+    double second;
+    char* colon = strstr(line, ": ");
+    if (colon && (sscanf(line, "%d-%d-%d %d:%d:%lf", &year, &month, &day, &hour, &minute, &second) == 6)) {
+      time = hour * 3600.0 + minute * 60.0 + second;
+      text = colon + 2;
+    }
+    if (first < 0) {
+      first = time;
+    }
+    if (*text) {
+      NmeaLine nmea = { (uint64_t) ((time - first) * 1e6), text };
+      lines->push_back(nmea);
+    }
+  }
+  pclose(file);
+  return !lines->empty();
+}
+
+/**
+ * is the directory entry a data file of the logger (DATAnnnn.DAT)?
+ **/
+bool isDataFile(const dir_t* dir) {
+  return DIR_IS_FILE(dir) && !strncmp((const char*) dir->name, "DATA", 4) &&
+         !strncmp((const char*) dir->name + 8, "DAT", 3);
+}
+
+/**
+ * names of the data files on the card, sorted.
+ **/
+std::vector<std::string> dataFiles() {
+  std::vector<std::string> names;
+  dir_t dir;
+  SdBaseFile* root = sd.vwd();
+  root->rewind();
+  while (root->readDir(&dir) > 0) {
+    if (isDataFile(&dir)) {
+      names.push_back(std::string((const char*) dir.name, 8) + "." + std::string((const char*) dir.name + 8, 3));
+    }
+  }
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+/**
+ * is the file a binary data file (outputs bit 4)? The file is behind the header then.
+ **/
+bool isBinaryFile(SdFile* file) {
+  char header[5];
+  char id[5];
+  strcpy_P(id, BINARY_FILE_ID);
+  if ((file->read(header, 5) == 5) && !memcmp(header, id, 4) && (header[4] == BINARY_FILE_VERSION)) {
+    return true;
+  }
+  file->rewind();
+  return false;
+}
+
+/**
+ * reading the next record of a binary data file (see osmdecode), the time delta is skipped.
+ * false at the end of the data (end of the file or channel 0, the rest of a preallocated file).
+ **/
+bool readRecord(SdFile* file, uint8_t* channel, std::string* payload) {
+  int c;
+  do {
+    c = file->read();
+  } while (c >= 0x80);
+  uint8_t channelLength[2];
+  if ((c < 0) || (file->read(channelLength, 2) != 2) || (channelLength[0] == 0)) {
+    return false;
+  }
+  payload->resize(channelLength[1]);
+  if ((channelLength[1] > 0) && (file->read(&(*payload)[0], channelLength[1]) != channelLength[1])) {
+    return false;
+  }
+  *channel = channelLength[0];
+  return true;
+}
+
+/**
+ * the logged lines of a channel (the data after the timestamp and the marker or the payload of the binary
+ * record) in all data files. A preallocated file after a power fail ends with zeros.
+ * The times are the timestamps of the text lines in ms, there are none for a binary file.
+ **/
+void readLogged(char channel, std::vector<std::string>* logged, std::vector<uint32_t>* times) {
+  std::vector<std::string> names = dataFiles();
+  for (size_t i = 0; i < names.size(); i++) {
+    SdFile file;
+    if (!file.open(names[i].c_str(), O_READ)) {
+      continue;
+    }
+    if (isBinaryFile(&file)) {
+      uint8_t recordChannel;
+      std::string payload;
+      while (readRecord(&file, &recordChannel, &payload)) {
+        if (!(recordChannel & BINARY_NMEA_FLAG) && ((recordChannel & ~CHANNEL_INVALID_FLAG) == channel)) {
+          logged->push_back(payload);
+        }
+      }
+      file.close();
+      continue;
+    }
+    std::string line;
+    int c;
+    while (((c = file.read()) > 0)) {
+      if (c == '\n') {
+        // timestamp;marker;data
+        size_t marker = line.find(';') + 1;
+        if ((marker > 0) && (line.size() > marker + 1) && ((line[marker] & ~CHANNEL_INVALID_FLAG) == channel) &&
+            (line[marker + 1] == ';')) {
+          logged->push_back(line.substr(marker + 2));
+          unsigned int hour, minute, second, milli;
+          if (sscanf(line.c_str(), "%u:%u:%u.%u;", &hour, &minute, &second, &milli) == 4) {
+            times->push_back(((hour * 60 + minute) * 60 + second) * 1000 + milli);
+          }
+        }
+        line.clear();
+      } else if (c != '\r') {
+        line += (char) c;
+      }
+    }
+    file.close();
+  }
+}
+
+struct DataStatistic {
+  uint32_t files;
+  uint32_t bytes;
+  uint32_t records;
+};
+
+/**
+ * size and records (lines or binary records) of all data files. With a directory the files are copied there.
+ **/
+DataStatistic readDataFiles(const char* directory) {
+  DataStatistic statistic = { 0, 0, 0 };
+  std::vector<std::string> names = dataFiles();
+  for (size_t i = 0; i < names.size(); i++) {
+    SdFile file;
+    if (!file.open(names[i].c_str(), O_READ)) {
+      continue;
+    }
+    statistic.files++;
+    statistic.bytes += file.fileSize();
+    if (isBinaryFile(&file)) {
+      uint8_t channel;
+      std::string payload;
+      while (readRecord(&file, &channel, &payload)) {
+        statistic.records++;
+      }
+    } else {
+      int c;
+      while ((c = file.read()) > 0) {
+        statistic.records += (c == '\n');
+      }
+    }
+    if (directory) {
+      // the name like the logger writes it
+      std::string name = names[i];
+      std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+      std::string path = std::string(directory) + "/" + name;
+      FILE* copy = fopen(path.c_str(), "wb");
+      uint8_t buffer[512];
+      int length;
+      file.rewind();
+      while (copy && ((length = file.read(buffer, sizeof(buffer))) > 0)) {
+        fwrite(buffer, 1, length, copy);
+      }
+      if (!copy || fclose(copy)) {
+        fprintf(stderr, "can't write %s\n", path.c_str());
+      }
+    }
+    file.close();
+  }
+  return statistic;
+}
+
+struct MatchResult {
+  uint32_t logged;
+  uint32_t dropped;
+  uint32_t garbled;
+  uint32_t truncated;
+  // timestamp of the logged line - receive time of its first byte, in ms
+  uint32_t timed;
+  int32_t minTimeError;
+  int32_t maxTimeError;
+  int64_t sumTimeError;
+};
+
+/**
+ * comparing the logged lines with the sent lines in their order. A sent line, which isn't found, is dropped.
+ * A logged line, which wasn't sent, is garbled (bytes lost inside the line, 2 lines in one).
+ * A line longer than the line buffer is written in parts, the first is truncated.
+ * With the times of the logged lines (text files) the timestamps are compared with the receive times.
+ **/
+MatchResult matchLines(const std::vector<std::string>& sent, const std::vector<uint64_t>& sentTimes,
+                       const std::vector<std::string>& logged, const std::vector<uint32_t>& loggedTimes) {
+  MatchResult result = { 0, 0, 0, 0, 0, INT32_MAX, INT32_MIN, 0 };
+  bool timed = loggedTimes.size() == logged.size();
+  size_t s = 0;
+  std::string rest;
+  for (size_t i = 0; i < logged.size(); i++) {
+    const std::string& line = logged[i];
+    if (!rest.empty() && !rest.compare(0, line.size(), line)) {
+      rest.erase(0, line.size());
+      continue;
+    }
+    rest.clear();
+    size_t end = std::min(sent.size(), s + MATCH_WINDOW);
+    size_t k = s;
+    while ((k < end) && (sent[k] != line)) {
+      k++;
+    }
+    if (k == end) {
+      k = s;
+      while ((k < end) && ((line.size() >= sent[k].size()) || sent[k].compare(0, line.size(), line))) {
+        k++;
+      }
+      if (k == end) {
+        result.garbled++;
+        continue;
+      }
+      result.truncated++;
+      rest = sent[k].substr(line.size());
+    }
+    result.logged++;
+    if (timed) {
+      int32_t error = (int32_t) loggedTimes[i] - (int32_t) (sentTimes[k] / 1000);
+      result.timed++;
+      result.minTimeError = std::min(result.minTimeError, error);
+      result.maxTimeError = std::max(result.maxTimeError, error);
+      result.sumTimeError += error;
+    }
+    result.dropped += k - s;
+    s = k + 1;
+  }
+  result.dropped += sent.size() - s;
+  return result;
+}
+
+/**
+ * number of clusters of the file behind its size (the rest of the preallocation).
+ **/
+uint32_t tailClusters(const SdBaseFile& file) {
+  uint32_t clusterBytes = (uint32_t) sd.vol()->blocksPerCluster() << 9;
+  uint32_t needed = (file.fileSize() + clusterBytes - 1) / clusterBytes;
+  uint32_t eoc = (sd.vol()->fatType() == 16) ? FAT16EOC_MIN : FAT32EOC_MIN;
+  uint32_t count = 0;
+  uint32_t cluster = file.firstCluster();
+  while ((cluster >= 2) && (cluster < eoc) && (count <= sd.vol()->clusterCount())) {
+    count++;
+    if (!sd.vol()->dbgFat(cluster, &cluster)) {
+      break;
+    }
+  }
+  return (count > needed) ? count - needed : 0;
+}
+
+/**
+ * the data file after the cut off: size, zero bytes at its end (data behind the last written size) and the clusters
+ * behind its size.
+ **/
+bool checkCutFile(const char* name, uint32_t* size, uint32_t* zeros, uint32_t* tail) {
+  SdFile file;
+  if (!file.open(name, O_READ)) {
+    return false;
+  }
+  *size = file.fileSize();
+  *zeros = 0;
+  int c;
+  while ((c = file.read()) >= 0) {
+    *zeros = c ? 0 : *zeros + 1;
+  }
+  *tail = tailClusters(file);
+  return file.close();
+}
+
+/**
+ * block of the FSINFO of a FAT32 card (partition 1), 0 for FAT16.
+ **/
+uint32_t fsInfoBlock() {
+  cache_t block;
+  if ((sd.vol()->fatType() != 32) || !sd.card()->readBlock(0, block.data)) {
+    return 0;
+  }
+  uint32_t volumeStart = block.mbr.part[0].firstSector;
+  if (!sd.card()->readBlock(volumeStart, block.data)) {
+    return 0;
+  }
+  return volumeStart + block.fbs32.fat32FSInfo;
+}
+
+/**
+ * the next free cluster of the FSINFO unknown, like on a card of a formatter without it. Nothing to do on FAT16.
+ **/
+bool clearAllocHint() {
+  if (!sd.vol()->cacheClear()) {
+    return false;
+  }
+  uint32_t info = fsInfoBlock();
+  if (!info) {
+    return true;
+  }
+  cache_t block;
+  if (!sd.card()->readBlock(info, block.data)) {
+    return false;
+  }
+  block.fsinfo.nextFree = 0xFFFFFFFF;
+  return sd.card()->writeBlock(info, block.data);
+}
+
+/**
+ * time and read blocks of the free cluster count by reading the whole FAT, like newFile() did it for every file
+ * before the volume kept the count. A second volume on the card does it, the free count in the FSINFO is
+ * unknown for it and restored afterwards.
+ **/
+bool fatScan(uint64_t* time, uint32_t* blocks) {
+  if (!sd.vol()->cacheClear()) {
+    return false;
+  }
+  uint32_t info = fsInfoBlock();
+  cache_t saved;
+  if (info) {
+    cache_t unknown;
+    if (!sd.card()->readBlock(info, saved.data)) {
+      return false;
+    }
+    unknown = saved;
+    unknown.fsinfo.freeCount = 0xFFFFFFFF;
+    if (!sd.card()->writeBlock(info, unknown.data)) {
+      return false;
+    }
+  }
+  SdVolume volume;
+  bool ok = volume.init(sd.card(), 1);
+  *time = hostMicros;
+  *blocks = sdEmuCounters.blocksRead;
+  ok = ok && (volume.freeClusterCount() >= 0);
+  *time = hostMicros - *time;
+  *blocks = sdEmuCounters.blocksRead - *blocks;
+  if (info) {
+    ok = volume.cacheClear() && sd.card()->writeBlock(info, saved.data) && ok;
+  }
+  return ok;
+}
+
+/**
+ * removing the data files of an earlier run.
+ **/
+void removeDataFiles() {
+  std::vector<std::string> names = dataFiles();
+  for (size_t i = 0; i < names.size(); i++) {
+    sd.remove(names[i].c_str());
+  }
+}
+
+/**
+ * creating the empty data files data0001.dat up to the count, like from earlier starts of the logger.
+ **/
+bool createDataFiles(uint16_t count) {
+  for (uint16_t i = 1; i <= count; i++) {
+    char name[13];
+    sprintf(name, "data%04u.dat", i);
+    SdFile file;
+    if (!file.open(name, O_RDWR | O_CREAT | O_EXCL) || !file.close()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * writing config.dat like a user would do.
+ **/
+bool writeConfig(byte baudA, byte baudB, byte outputs, byte flush, byte motion, byte attitude) {
+  SdFile file;
+  sd.remove("config.dat");
+  if (!file.open("config.dat", O_RDWR | O_CREAT | O_TRUNC)) {
+    return false;
+  }
+  char text[64];
+  sprintf(text, "%u\r\n%u\r\n%u\r\n0\r\n%u\r\n%u\r\n%u\r\n", baudA, baudB, outputs, flush, motion, attitude);
+  file.write(text, strlen(text));
+  return file.close();
+}
+
+/**
+ * code of the baudrate in config.dat.
+ **/
+byte baudCode(uint32_t baud, byte max) {
+  for (byte i = 0; i <= max; i++) {
+    if (BAUDRATES[i] == baud) {
+      return i;
+    }
+  }
+  fprintf(stderr, "baudrate %lu not possible\n", (unsigned long) baud);
+  exit(1);
+}
+
+MatchResult printChannel(char channel, uint32_t baud, const ReplaySource& source, const SimChannel& rx,
+                         uint64_t loopCycles, uint64_t isrCycles, double seconds) {
+  MatchResult match = { 0, 0, 0, 0, 0, 0, 0, 0 };
+  if (baud == 0) {
+    printf("channel %c: off\n", channel);
+    return match;
+  }
+  std::vector<std::string> logged;
+  std::vector<uint32_t> times;
+  readLogged(channel, &logged, &times);
+  match = matchLines(source.sent, source.sentTimes, logged, times);
+  printf("channel %c: %lu baud, sent %lu lines (%lu bytes), logged %lu, dropped %lu, garbled %lu, truncated %lu\n",
+         channel, (unsigned long) baud, (unsigned long) source.sent.size(), (unsigned long) rx.received,
+         (unsigned long) match.logged, (unsigned long) match.dropped, (unsigned long) match.garbled,
+         (unsigned long) match.truncated);
+  double bytes = rx.received ? rx.received : 1;
+  printf("  %.1f sentences/s, %.0f cycles/byte (loop %.0f, interrupt %.0f), %lu bytes lost in the receive ring\n",
+         match.logged / seconds, (loopCycles + isrCycles) / bytes, loopCycles / bytes, isrCycles / bytes,
+         (unsigned long) rx.dropped);
+  if (match.timed > 0) {
+    printf("  timestamps - receive time of the first byte: %ld to %ld ms, average %.1f ms\n",
+           (long) match.minTimeError, (long) match.maxTimeError, (double) match.sumTimeError / match.timed);
+  }
+  return match;
+}
+
+int main(int argc, char* argv[]) {
+  uint32_t baudA = 4800;
+  uint32_t baudB = 4800;
+  uint32_t seconds = 60;
+  bool backToBack = false;
+  byte flush = DEFAULT_FLUSH_INTERVAL;
+  byte motion = 0;
+  byte attitude = 0;
+  byte outputs = 2;
+  bool powerFail = false;
+  bool cutOff = false;
+  uint32_t cutUs = 0;
+  uint16_t files = 0;
+  uint16_t unused = 0;
+  uint32_t rotation = 0;
+  bool lossless = false;
+  bool noHint = false;
+  const char* exportDirectory = NULL;
+  int opt;
+  while ((opt = getopt(argc, argv, "a:b:t:fk:i:g:r:o:cz:n:u:h:ep:s:wmylx:")) != -1) {
+    switch (opt) {
+      case 'a':
+        baudA = atol(optarg);
+        break;
+      case 'b':
+        baudB = atol(optarg);
+        break;
+      case 't':
+        seconds = atol(optarg);
+        break;
+      case 'f':
+        backToBack = true;
+        break;
+      case 'k':
+        simBlockCycles = atoi(optarg);
+        break;
+      case 'i':
+        flush = atoi(optarg);
+        break;
+      case 'g':
+        motion = atoi(optarg);
+        break;
+      case 'r':
+        attitude = atoi(optarg);
+        break;
+      case 'o':
+        outputs = atoi(optarg);
+        break;
+      case 'c':
+        powerFail = true;
+        break;
+      case 'z':
+        powerFail = true;
+        cutOff = true;
+        cutUs = atol(optarg);
+        break;
+      case 'n':
+        files = atoi(optarg);
+        break;
+      case 'u':
+        unused = atoi(optarg);
+        break;
+      case 'h':
+        rotation = atol(optarg);
+        break;
+      case 'e':
+        noHint = true;
+        break;
+      case 'p':
+        sdEmuTiming.stallPerMille = atoi(optarg);
+        break;
+      case 's':
+        sdEmuTiming.stallUs = atol(optarg) * 1000UL;
+        break;
+      case 'w':
+        sdEmuHideBusy = true;
+        break;
+      case 'm':
+        simLoopLineTime = true;
+        break;
+      case 'y':
+        simTwiBlocking = true;
+        break;
+      case 'l':
+        lossless = true;
+        break;
+      case 'x':
+        exportDirectory = optarg;
+        mkdir(exportDirectory, 0755);
+        break;
+      default:
+        fprintf(stderr, "usage: osmsim [-a baud] [-b baud] [-t seconds] [-f] [-k cycles] [-i flush seconds]\n"
+                "              [-g motion rate] [-r attitude rate] [-o outputs] [-c] [-z cut us]\n"
+                "              [-n files] [-u number] [-h seconds] [-e] [-p stalls per mille] [-s stall ms] [-w]\n"
+                "              [-m] [-y] [-l] [-x directory] image nmea file\n");
+        return 1;
+    }
+  }
+  if (optind + 1 >= argc) {
+    fprintf(stderr, "no image or NMEA file\n");
+    return 1;
+  }
+  byte codeA = baudCode(baudA, 6);
+  byte codeB = baudCode(baudB, 3);
+  std::vector<NmeaLine> lines;
+  if (!readLines(argv[optind + 1], &lines)) {
+    fprintf(stderr, "can't read %s\n", argv[optind + 1]);
+    return 1;
+  }
+  if (!sdEmuOpen(argv[optind])) {
+    fprintf(stderr, "can't open image %s\n", argv[optind]);
+    return 1;
+  }
+  simInit();
+  simFunctions[SIM_CHANNEL_A] = (void*) testSerialA;
+  simFunctions[SIM_CHANNEL_B] = (void*) testSerialB;
+  simFunctions[SIM_GYRO] = (void*) pollGyro;
+  if (!sd.begin(SD_CHIPSELECT, SPI_HALF_SPEED)) {
+    sd.initErrorPrint();
+    return 1;
+  }
+  // the files of the test are written like on a pc, the free count of the FSINFO stays valid
+  sd.vol()->freeClusterCount();
+  removeDataFiles();
+  if (!writeConfig(codeA, codeB, outputs, flush, motion, attitude)) {
+    fprintf(stderr, "can't write config.dat\n");
+    return 1;
+  }
+  if (!createDataFiles(files)) {
+    fprintf(stderr, "can't create %u data files\n", files);
+    return 1;
+  }
+  char unusedFile[13] = "";
+  if (unused > 0) {
+    sprintf(unusedFile, "data%04u.dat", unused);
+    sd.remove(unusedFile);
+  }
+  sd.vol()->syncFSInfo();
+  if (noHint && !clearAllocHint()) {
+    fprintf(stderr, "can't clear the next free cluster of the FSINFO\n");
+    return 1;
+  }
+  uint64_t scanTime = 0;
+  uint32_t scanBlocks = 0;
+  if ((rotation > 0) && !fatScan(&scanTime, &scanBlocks)) {
+    fprintf(stderr, "can't count the free clusters\n");
+    return 1;
+  }
+  simPowerOn(rotation ? (3600ULL - rotation) * 1000000ULL : 0);
+  sdEmuPowerOn();
+
+  uint64_t setupTime = hostMicros;
+  setup();
+  setupTime = hostMicros - setupTime;
+
+  // the data file is created and the receivers are started in the first pass of the loop
+  uint64_t fileTime = hostMicros;
+  uint32_t fileBlocksRead = sdEmuCounters.blocksRead;
+  loop();
+  fileTime = hostMicros - fileTime;
+  fileBlocksRead = sdEmuCounters.blocksRead - fileBlocksRead;
+  char firstFile[13] = "";
+  if (dataFile.isOpen()) {
+    strcpy(firstFile, filename);
+  }
+
+  // the full 100 ms, so the lines have the same times in runs with other options (make binary)
+  uint64_t start = (hostMicros / 100000ULL + 1) * 100000ULL;
+  uint64_t end = start + seconds * 1000000ULL;
+  ReplaySource sourceA(&lines, baudA ? baudA : 1, start, baudA ? end : start, backToBack);
+  ReplaySource sourceB(&lines, baudB ? baudB : 1, start, baudB ? end : start, backToBack);
+  simChannelA.setSource(&sourceA);
+  simChannelB.setSource(&sourceB);
+  uint64_t startCycles[SIM_CATEGORIES];
+  memcpy(startCycles, simCycles, sizeof(startCycles));
+  SdEmuCounters startCard = sdEmuCounters;
+
+  // the time of every pass of the loop, the longest ones are the latency of the logger. The pass, which opens
+  // the next data file, is the rotation.
+  std::vector<uint32_t> passTimes;
+  char rotatedFile[13] = "";
+  uint64_t rotationStart = 0;
+  uint32_t rotationTime = 0;
+  SdEmuCounters rotationCard = sdEmuCounters;
+  while (hostMicros < end + DRAIN_US) {
+    uint64_t passStart = hostMicros;
+    SdEmuCounters passCard = sdEmuCounters;
+    loop();
+    passTimes.push_back(hostMicros - passStart);
+    if (!*rotatedFile && dataFile.isOpen() && strcmp(filename, firstFile)) {
+      strcpy(rotatedFile, filename);
+      rotationStart = passStart;
+      rotationTime = hostMicros - passStart;
+      rotationCard.blocksRead = sdEmuCounters.blocksRead - passCard.blocksRead;
+      rotationCard.blocksWritten = sdEmuCounters.blocksWritten - passCard.blocksWritten;
+    }
+  }
+  uint64_t cycles[SIM_CATEGORIES];
+  uint64_t allCycles = 0;
+  for (byte i = 0; i < SIM_CATEGORIES; i++) {
+    cycles[i] = simCycles[i] - startCycles[i];
+    allCycles += cycles[i];
+  }
+  uint64_t logTime = hostMicros - start;
+  SdEmuCounters card = sdEmuCounters;
+
+  uint64_t stopTime = hostMicros;
+  if (powerFail) {
+    simVcc = POWER_FAIL_VCC;
+    if (cutOff) {
+      sdEmuCutoff = simCutoff = stopTime + cutUs;
+    }
+    while (dataFile.isOpen() && (hostMicros < stopTime + 1000000ULL)) {
+      loop();
+    }
+  } else {
+    simStopSwitch = true;
+    loop();
+  }
+  // the next start after the cut off: the card is mounted again, the state of the sketch is lost
+  bool cutOk = true;
+  uint32_t cutSize = 0, cutZeros = 0, cutTail = 0, freedTail = 0;
+  if (cutOff) {
+    sdEmuCutoff = simCutoff = ~0ULL;
+    if (!sd.begin(SD_CHIPSELECT, SPI_HALF_SPEED)) {
+      sd.initErrorPrint();
+      return 1;
+    }
+    cutOk = *firstFile && checkCutFile(firstFile, &cutSize, &cutZeros, &cutTail);
+    if (cutOk) {
+      freeFileTail(atoi(firstFile + 4));
+      uint32_t size, zeros;
+      cutOk = checkCutFile(firstFile, &size, &zeros, &freedTail) && (size == cutSize) && (cutZeros == 0) &&
+              (freedTail == 0);
+    }
+  }
+
+  printf("osmsim: %lu s, %s, %u cycles per basic block, %u stalls per mille of %lu ms, %s\n",
+         (unsigned long) seconds, backToBack ? "back to back" : "times of the file", simBlockCycles,
+         sdEmuTiming.stallPerMille, (unsigned long) (sdEmuTiming.stallUs / 1000),
+         sdEmuHideBusy ? "no logReady gating" : "logReady gating");
+  // the name of the first data file, with data9999.dat on the card the deleted one, without it the logger stops
+  // with an error
+  uint16_t expectedNumber = files + 1;
+  if (files >= 9999) {
+    expectedNumber = ((unused > 0) && (unused <= files)) ? unused : 0;
+  }
+  bool startOk = error;
+  if (expectedNumber > 0) {
+    char expected[13];
+    sprintf(expected, "data%04u.dat", expectedNumber);
+    startOk = !strcmp(firstFile, expected);
+  }
+  printf("startup: setup %.1f s, %u data files%s%s, %s after %.1f ms more, %lu blocks read, %s\n", setupTime / 1e6,
+         files, *unusedFile ? " without " : "", unusedFile, (expectedNumber > 0) ? firstFile : "no file number left",
+         fileTime / 1e3, (unsigned long) fileBlocksRead, startOk ? "ok" : "FAILED");
+  bool rotationOk = !rotation || *rotatedFile;
+  if (*rotatedFile) {
+    printf("rotation: %s after %.1f s, pass of the loop %.1f ms, %lu blocks read, %lu written\n", rotatedFile,
+           rotationStart > start ? (rotationStart - start) / 1e6 : 0.0, rotationTime / 1e3,
+           (unsigned long) rotationCard.blocksRead, (unsigned long) rotationCard.blocksWritten);
+  }
+  if (rotation > 0) {
+    printf("free count by a FAT scan: %.1f ms, %lu blocks read, %s\n", scanTime / 1e3, (unsigned long) scanBlocks,
+           rotationOk ? "ok" : "FAILED (no rotation)");
+  }
+  double sendTime = seconds;
+  MatchResult matchA = printChannel(CHANNEL_A_IDENTIFIER, baudA, sourceA, simChannelA, cycles[SIM_CHANNEL_A],
+                                    cycles[SIM_ISR_A], sendTime);
+  MatchResult matchB = printChannel(CHANNEL_B_IDENTIFIER, baudB, sourceB, simChannelB, cycles[SIM_CHANNEL_B],
+                                    cycles[SIM_ISR_B], sendTime);
+  DataStatistic data = readDataFiles(exportDirectory);
+  uint32_t loggedLines = std::max(matchA.logged + matchB.logged, (uint32_t) 1);
+  printf("data files: %lu, %lu bytes (%s), %lu records, %.0f cycles of the channels per line (loop with polling)\n",
+         (unsigned long) data.files, (unsigned long) data.bytes, (outputs & 0x04) ? "binary" : "text",
+         (unsigned long) data.records, (double) (cycles[SIM_CHANNEL_A] + cycles[SIM_CHANNEL_B]) / loggedLines);
+  double cpuTime = logTime * (double) SIM_CYCLES_PER_MICRO;
+  printf("cpu: channel A %.1f %%, channel B %.1f %%, gyro (with polling) %.1f %%, interrupts %.1f %%, rest of the loop %.1f %%\n",
+         100.0 * (cycles[SIM_CHANNEL_A] + cycles[SIM_ISR_A]) / cpuTime,
+         100.0 * (cycles[SIM_CHANNEL_B] + cycles[SIM_ISR_B]) / cpuTime, 100.0 * cycles[SIM_GYRO] / cpuTime,
+         100.0 * cycles[SIM_ISR_OTHER] / cpuTime, 100.0 * cycles[SIM_OTHER] / cpuTime);
+  printf("card: %.1f %% of the time (spi and busy), %lu blocks written, %lu stalls, busy waits %.3f s\n",
+         100.0 - 100.0 * allCycles / cpuTime, (unsigned long) (card.blocksWritten - startCard.blocksWritten),
+         (unsigned long) (card.stalls - startCard.stalls), (card.busyUs - startCard.busyUs) / 1e6);
+  if (actBlock > firstBlock) {
+    printf("block writer: FAT%u, %lu blocks streamed, max. %.1f ms per block write\n", sd.vol()->fatType(),
+           (unsigned long) (actBlock - firstBlock), maxBlockTime / 1e3);
+  } else {
+    printf("block writer: FAT%u, off\n", sd.vol()->fatType());
+  }
+  if (passTimes.empty()) {
+    passTimes.push_back(0);
+  }
+  std::sort(passTimes.begin(), passTimes.end());
+  uint64_t passSum = 0;
+  uint32_t longPasses = 0;
+  for (size_t i = 0; i < passTimes.size(); i++) {
+    passSum += passTimes[i];
+    if (passTimes[i] > LONG_PASS_US) {
+      longPasses++;
+    }
+  }
+  printf("loop: %lu passes, %.0f us average, 99.9 %% up to %.1f ms, max. %.1f ms, %lu over %u ms\n",
+         (unsigned long) passTimes.size(), (double) passSum / passTimes.size(),
+         passTimes[passTimes.size() * 999 / 1000] / 1e3, passTimes.back() / 1e3, (unsigned long) longPasses,
+         LONG_PASS_US / 1000);
+  printf("receive rings: max. wait of a byte A %.1f ms, B %.1f ms\n", simChannelA.maxWait / 1e3,
+         simChannelB.maxWait / 1e3);
+  printf("ram: max. fill of the receive rings A %u of %u bytes, B %u of %u bytes\n", simChannelA.maxFill,
+         simChannelA.ringSize() - 1, simChannelB.maxFill, simChannelB.ringSize() - 1);
+  uint32_t lostBytes = simChannelA.dropped + simChannelB.dropped;
+  uint32_t lostLines = matchA.dropped + matchA.garbled + matchB.dropped + matchB.garbled;
+  bool lossOk = !lossless || ((lostBytes == 0) && (lostLines == 0));
+  printf("lost: %lu bytes in the receive rings%s\n", (unsigned long) lostBytes,
+         lossless ? (lossOk ? ", ok" : ", FAILED") : "");
+  if (powerFail) {
+    uint32_t shutdownTime;
+    memcpy(&shutdownTime, simEeprom + EEPROM_SHUTDOWN_TIME, sizeof(shutdownTime));
+    // the time is written last, a record cut off keeps the high byte of the erased EEPROM
+    bool record = (shutdownTime >> 24) != 0xFF;
+    printf("power fail: %s, ", dataFile.isOpen() ? "data file still open" : "data file closed");
+    if (record) {
+      printf("shutdown %.1f ms\n", shutdownTime / 1e3);
+    } else {
+      printf("no shutdown record\n");
+    }
+    if (cutOff) {
+      printf("cut off: %.1f ms after the power fail, %s %lu bytes, %lu zero bytes at the end, %lu clusters behind the size,"
+             " %lu after the next start, %s\n", cutUs / 1e3, firstFile, (unsigned long) cutSize,
+             (unsigned long) cutZeros, (unsigned long) cutTail, (unsigned long) freedTail, cutOk ? "ok" : "FAILED");
+    }
+  }
+  sdEmuClose();
+  return (startOk && lossOk && cutOk && rotationOk) ? 0 : 2;
+}
@@ -0,0 +1,440 @@
+/*
+ sim.cpp - clock, cpu model, interrupts and receive channels of the logger simulation, see sim.h
+ Copyright (c) 2014 Wilfried Klaas.  All right reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ This file isn't compiled with -fsanitize-coverage, it's the hardware and costs no cycles itself.
+ */
+#include <Arduino.h>
+#include <AltSoftSerial.h>
+#include <EEPROM.h>
+#include <Wire.h>
+extern "C" {
+#include <utility/twi.h>
+}
+#include "sim.h"
+#include "../../SketchBook/OpenSeaMap/config.h"
+
+// address of the MPU6050 (AD0 low)
+#define SIM_MPU_ADDRESS 0x68
+// register of the MPU6050, which is read without incrementing the address
+#define SIM_MPU_FIFO_R_W 0x74
+
+uint8_t simBlockCycles = 6;
+uint64_t simCycles[SIM_CATEGORIES];
+uint16_t simVcc = 5000;
+bool simStopSwitch = false;
+uint64_t simCutoff = ~0ULL;
+bool simLoopLineTime = false;
+bool simTwiBlocking = false;
+void* simFunctions[SIM_GYRO + 1];
+
+volatile uint8_t SREG;
+volatile uint8_t PORTB, PORTC, PORTD;
+volatile uint8_t DDRB, DDRC, DDRD;
+volatile uint8_t ADMUX, ADCSRB;
+volatile uint16_t simAdc;
+uint8_t simEeprom[E2END + 1];
+
+EEPROMClass EEPROM;
+TwoWire Wire;
+HardwareSerial Serial;
+SimChannel simChannelA(SIM_ISR_A, USART_ISR_CYCLES);
+SimChannel simChannelB(SIM_ISR_B, ALTSOFT_ISR_CYCLES);
+
+static volatile uint8_t adcsra;
+// end of the running single conversion, 0 = none
+static uint64_t conversionEnd;
+static uint8_t category = SIM_OTHER;
+static uint8_t fraction;
+static uint64_t nextOverflow = SIM_TIMER0_US;
+static bool inInterrupt = false;
+
+extern "C" void ADC_vect(void);
+
+void simInit() {
+  memset(simEeprom, 0xFF, sizeof(simEeprom));
+  SREG = 0x80;
+}
+
+void simPowerOn(uint64_t micros) {
+  hostMicros = micros;
+  fraction = 0;
+  nextOverflow = micros + SIM_TIMER0_US;
+  conversionEnd = 0;
+}
+
+void simAddCycles(uint8_t category, uint32_t cycles) {
+  simCycles[category] += cycles;
+  uint32_t sum = fraction + cycles;
+  hostMicros += sum / SIM_CYCLES_PER_MICRO;
+  fraction = sum % SIM_CYCLES_PER_MICRO;
+}
+
+/**
+ * the timer 0 overflows until now. With ADATE and the timer 0 overflow as trigger source (ADTS 4)
+ * every overflow starts a conversion of the supply monitor, its interrupt is the ISR of the sketch.
+ **/
+static void timer0Overflows() {
+  inInterrupt = true;
+  while ((hostMicros >= nextOverflow) && (SREG & 0x80)) {
+    nextOverflow += SIM_TIMER0_US;
+    simAddCycles(SIM_ISR_OTHER, TIMER0_ISR_CYCLES);
+    uint8_t monitor = _BV(ADEN) | _BV(ADATE) | _BV(ADIE);
+    if (((adcsra & monitor) == monitor) && ((ADCSRB & 0x07) == _BV(ADTS2))) {
+      simAdc = 1126400L / simVcc;
+      uint8_t interrupted = category;
+      category = SIM_ISR_OTHER;
+      SREG &= ~0x80;
+      ADC_vect();
+      SREG |= 0x80;
+      category = interrupted;
+    }
+  }
+  inInterrupt = false;
+}
+
+/**
+ * called for every basic block of the instrumented code.
+ **/
+extern "C" void __sanitizer_cov_trace_pc(void) {
+  simAddCycles(category, simBlockCycles);
+  if ((hostMicros >= nextOverflow) && !inInterrupt) {
+    timer0Overflows();
+  }
+}
+
+/**
+ * the sketch is compiled with -finstrument-functions, the functions of the channels and the gyro
+ * have their own category. A call of a channel function, which reads no byte, is only polling,
+ * its cycles are the rest of the loop.
+ **/
+static uint64_t enterCycles;
+static uint32_t enterReads;
+
+static SimChannel* categoryChannel(uint8_t category) {
+  if (category == SIM_CHANNEL_A) {
+    return &simChannelA;
+  }
+  return (category == SIM_CHANNEL_B) ? &simChannelB : 0;
+}
+
+extern "C" void __cyg_profile_func_enter(void* function, void* caller) {
+  for (uint8_t i = SIM_CHANNEL_A; i <= SIM_GYRO; i++) {
+    if (function == simFunctions[i]) {
+      category = i;
+      enterCycles = simCycles[i];
+      SimChannel* channel = categoryChannel(i);
+      enterReads = channel ? channel->reads : 0;
+    }
+  }
+}
+
+extern "C" void __cyg_profile_func_exit(void* function, void* caller) {
+  for (uint8_t i = SIM_CHANNEL_A; i <= SIM_GYRO; i++) {
+    if (function == simFunctions[i]) {
+      SimChannel* channel = categoryChannel(i);
+      if (channel && (channel->reads == enterReads)) {
+        simCycles[SIM_OTHER] += simCycles[i] - enterCycles;
+        simCycles[i] = enterCycles;
+      }
+      category = SIM_OTHER;
+    }
+  }
+}
+
+volatile uint8_t& simAdcsra() {
+  if (adcsra & _BV(ADSC)) {
+    if (conversionEnd == 0) {
+      conversionEnd = hostMicros + ADC_CONVERSION_US;
+    } else if (hostMicros >= conversionEnd) {
+      simAdc = 1126400L / simVcc;
+      adcsra = (adcsra & ~_BV(ADSC)) | _BV(ADIF);
+      conversionEnd = 0;
+    }
+  }
+  return adcsra;
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+}
+
+int digitalRead(uint8_t pin) {
+  if (pin == SW_STOP) {
+    return simStopSwitch ? LOW : HIGH;
+  }
+  return HIGH;
+}
+
+SimChannel::SimChannel(uint8_t category, uint16_t isrCycles)
+  : received(0), dropped(0), reads(0), maxWait(0), maxFill(0), source(0), category(category), isrCycles(isrCycles),
+    active(false), buffer(defaultBuffer), size(sizeof(defaultBuffer)), head(0), tail(0), actLineTime(0),
+    lineStart(true), readLineStart(true), readLineTime(0), overflows(0) {
+}
+
+void SimChannel::setSource(SimSource* source) {
+  this->source = source;
+}
+
+void SimChannel::setRxBuffer(uint8_t* memory, uint8_t size) {
+  if ((memory != 0) && (size > 0)) {
+    buffer = memory;
+    this->size = size;
+  } else {
+    buffer = defaultBuffer;
+    this->size = sizeof(defaultBuffer);
+  }
+  head = 0;
+  tail = 0;
+}
+
+void SimChannel::begin() {
+  head = 0;
+  tail = 0;
+  lineStart = true;
+  readLineStart = true;
+  overflows = 0;
+  active = true;
+}
+
+void SimChannel::end() {
+  active = false;
+}
+
+/**
+ * the receive interrupt for every byte received until now, a byte is stored like store_char() of the core does it.
+ **/
+void SimChannel::receive() {
+  uint64_t time;
+  while ((source != 0) && source->peek(&time) && (time <= hostMicros)) {
+    uint8_t c = source->take();
+    if (!active) {
+      continue;
+    }
+    simAddCycles(category, isrCycles);
+    received++;
+    uint8_t i = head + 1;
+    if (i >= size) {
+      i = 0;
+    }
+    if (i != tail) {
+      buffer[head] = c;
+      if (lineStart) {
+        actLineTime = time / 1000;
+      }
+      lineTimes[head] = actLineTime;
+      byteTimes[head] = time;
+      head = i;
+      lineStart = (c == '\n');
+      uint8_t fill = ((unsigned int) size + head - tail) % size;
+      if (fill > maxFill) {
+        maxFill = fill;
+      }
+    } else {
+      overflows++;
+      dropped++;
+    }
+  }
+}
+
+int SimChannel::available() {
+  receive();
+  return ((unsigned int) size + head - tail) % size;
+}
+
+int SimChannel::peek() {
+  receive();
+  if (head == tail) {
+    return -1;
+  }
+  return buffer[tail];
+}
+
+int SimChannel::read() {
+  receive();
+  if (head == tail) {
+    return -1;
+  }
+  uint8_t c = buffer[tail];
+  if (readLineStart) {
+    readLineTime = simLoopLineTime ? (unsigned long) (hostMicros / 1000) : lineTimes[tail];
+  }
+  readLineStart = (c == '\n');
+  if (hostMicros - byteTimes[tail] > maxWait) {
+    maxWait = hostMicros - byteTimes[tail];
+  }
+  reads++;
+  tail = (tail + 1 >= size) ? 0 : tail + 1;
+  return c;
+}
+
+unsigned long SimChannel::lineTime() {
+  return readLineTime;
+}
+
+uint8_t SimChannel::ringSize() {
+  return size;
+}
+
+uint16_t SimChannel::overflowCount() {
+  return overflows;
+}
+
+void HardwareSerial::begin(unsigned long baud, uint8_t config) {
+  simChannelA.begin();
+}
+
+// no seatalk data in the simulation, the channel stays silent
+void HardwareSerial::beginSeaTalk() {
+}
+
+void HardwareSerial::setRxBuffer(unsigned char* memory, unsigned char size, bool nineBit) {
+  simChannelA.setRxBuffer(memory, size);
+}
+
+void HardwareSerial::end() {
+  simChannelA.end();
+}
+
+int HardwareSerial::available() {
+  return simChannelA.available();
+}
+
+int HardwareSerial::peek() {
+  return simChannelA.peek();
+}
+
+int HardwareSerial::read() {
+  return simChannelA.read();
+}
+
+void HardwareSerial::flush() {
+  fflush(stdout);
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  return fputc(c, stdout) == EOF ? 0 : 1;
+}
+
+uint8_t HardwareSerial::readDatagram(uint8_t* data, uint8_t size) {
+  return 0;
+}
+
+uint16_t HardwareSerial::datagramErrors() {
+  return 0;
+}
+
+uint16_t HardwareSerial::overflowCount() {
+  return simChannelA.overflowCount();
+}
+
+unsigned long HardwareSerial::lineTime() {
+  return simChannelA.lineTime();
+}
+
+void AltSoftSerial::begin(uint32_t baud) {
+  simChannelB.begin();
+}
+
+void AltSoftSerial::end() {
+  simChannelB.end();
+}
+
+int AltSoftSerial::peek() {
+  return simChannelB.peek();
+}
+
+int AltSoftSerial::read() {
+  return simChannelB.read();
+}
+
+int AltSoftSerial::available() {
+  return simChannelB.available();
+}
+
+void AltSoftSerial::setRxBuffer(uint8_t* memory, uint8_t size) {
+  simChannelB.setRxBuffer(memory, size);
+}
+
+uint16_t AltSoftSerial::overflowCount() {
+  return simChannelB.overflowCount();
+}
+
+unsigned long AltSoftSerial::lineTime() {
+  return simChannelB.lineTime();
+}
+
+void TwoWire::begin() {
+}
+
+// the asynchronous register read of the logger's twi.c, done by the twi interrupt after the bus time
+static uint8_t asyncState = TWI_ASYNC_IDLE;
+static uint64_t asyncEnd;
+static uint8_t asyncAddress;
+static uint8_t asyncRegister;
+static uint8_t* asyncData;
+static uint8_t asyncLength;
+
+uint32_t simTwiMicros(uint8_t count) {
+  // 9 clocks per byte
+  return ((count + 3) * 9UL * 1000000UL) / TWI_FREQ;
+}
+
+void twi_init(void) {
+  asyncState = TWI_ASYNC_IDLE;
+}
+
+void twi_disable(void) {
+  asyncState = TWI_ASYNC_IDLE;
+}
+
+uint8_t twi_readRegisterAsync(uint8_t address, uint8_t reg, uint8_t* data, uint8_t length) {
+  if ((length == 0) || (asyncState == TWI_ASYNC_REGISTER) || (asyncState == TWI_ASYNC_DATA)) {
+    return 0;
+  }
+  asyncAddress = address;
+  asyncRegister = reg;
+  asyncData = data;
+  asyncLength = length;
+  asyncEnd = hostMicros + simTwiMicros(length);
+  asyncState = TWI_ASYNC_DATA;
+  if (simTwiBlocking) {
+    simAddCycles(category, simTwiMicros(length) * SIM_CYCLES_PER_MICRO);
+  }
+  return 1;
+}
+
+uint8_t twi_asyncStatus(void) {
+  if ((asyncState == TWI_ASYNC_DATA) && (hostMicros >= asyncEnd)) {
+    simAddCycles(SIM_ISR_OTHER, (asyncLength + 3) * TWI_ISR_CYCLES);
+    if (asyncAddress == SIM_MPU_ADDRESS) {
+      for (uint8_t i = 0; i < asyncLength; i++) {
+        asyncData[i] = simMpuRead(asyncRegister == SIM_MPU_FIFO_R_W ? asyncRegister : asyncRegister + i);
+      }
+      asyncState = TWI_ASYNC_DONE;
+    } else {
+      asyncState = TWI_ASYNC_ERROR;
+    }
+  }
+  uint8_t state = asyncState;
+  if ((state == TWI_ASYNC_DONE) || (state == TWI_ASYNC_ERROR)) {
+    asyncState = TWI_ASYNC_IDLE;
+  }
+  return state;
+}
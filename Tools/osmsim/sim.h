@@ -0,0 +1,150 @@
+/*
+ sim.h - clock, cpu model and receive channels of the logger simulation
+ Copyright (c) 2014 Wilfried Klaas.  All right reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ The logger (OpenSeaMap.ino), SdFat and osmfunctions.h run on the pc. Their code is compiled with
+ -fsanitize-coverage=trace-pc, every executed basic block costs simBlockCycles cycles of the 16 MHz avr.
+ Together with the card emulator (Tools/sdemu/Sd2Card.cpp), which adds the time on the spi bus and the
+ busy time of the card, this is the time of the logger (hostMicros, millis(), micros()).
+ The interrupts of the serial channels and the TWI aren't simulated instruction by instruction, they are
+ stubs with a fixed cost per byte (*_ISR_CYCLES), estimated from the code of the real interrupts.
+ The ADC interrupt of the sketch runs with the timer 0 overflow, like on the logger.
+ */
+#ifndef osmsim_sim_h
+#define osmsim_sim_h
+#include <stdint.h>
+
+#define SIM_CYCLES_PER_MICRO (F_CPU / 1000000L)
+// timer 0 overflow of the core (prescaler 64), starts the ADC of the supply monitor
+#define SIM_TIMER0_US 1024
+#define TIMER0_ISR_CYCLES 80
+// USART receive interrupt: prologue, store_char(), line time (millis()), epilogue
+#define USART_ISR_CYCLES 90
+// AltSoftSerial: about 5 edges of a NMEA byte (input capture) and the end of the byte (compare B)
+#define ALTSOFT_ISR_CYCLES 400
+// TWI interrupt per transferred byte
+#define TWI_ISR_CYCLES 80
+// conversion time of the ADC (13 ADC clocks with prescaler 128)
+#define ADC_CONVERSION_US 104
+
+// where the cycles are spent, the channels and the gyro are the functions of the sketch (sim.cpp)
+enum SimCategory {
+  SIM_OTHER,
+  SIM_CHANNEL_A,
+  SIM_CHANNEL_B,
+  SIM_GYRO,
+  SIM_ISR_A,
+  SIM_ISR_B,
+  SIM_ISR_OTHER,
+  SIM_CATEGORIES
+};
+
+extern uint64_t hostMicros;
+extern uint8_t simBlockCycles;
+extern uint64_t simCycles[SIM_CATEGORIES];
+// supply voltage in mV and the stop switch
+extern uint16_t simVcc;
+extern bool simStopSwitch;
+// time of the power loss (empty gold cap) in µs, the eeprom keeps no writes after it
+extern uint64_t simCutoff;
+// lineTime() of the channels is the millis() of the first read of a line, like the loop took it before the
+// receive interrupts did (the time of the first byte of the line)
+extern bool simLoopLineTime;
+// the asynchronous TWI transfers wait for the bus in the call, like the blocking transfers of the Wire library
+// the logger used before (the cpu waits in the gyro category)
+extern bool simTwiBlocking;
+// the functions of the sketch for the categories
+extern void* simFunctions[SIM_GYRO + 1];
+
+// erased eeprom, interrupts enabled (init() of the core)
+void simInit();
+// the logger is switched on, its time starts at micros (with sdEmuPowerOn() for the card). The time of the files
+// written to the card before isn't the time of the logger (e.g. 9999 data files are more than an hour).
+void simPowerOn(uint64_t micros);
+// cycles of the cpu, the clock is advanced by them
+void simAddCycles(uint8_t category, uint32_t cycles);
+
+// bytes of a receive channel
+class SimSource {
+ public:
+  virtual ~SimSource() {}
+  // receive time (end of the stop bit, in µs) of the next byte, false if there is none
+  virtual bool peek(uint64_t* time) = 0;
+  virtual uint8_t take() = 0;
+};
+
+/**
+ * receive ring of a serial channel, filled by the (not simulated) receive interrupt.
+ * The bytes received since the last access are taken into the ring when the sketch looks at it, that's the
+ * same as the interrupt does: a byte is dropped, if the ring is full at its receive time.
+ * The ring is the memory the sketch gives with setRxBuffer(), like in the real libraries.
+ **/
+class SimChannel {
+ public:
+  SimChannel(uint8_t category, uint16_t isrCycles);
+  void setSource(SimSource* source);
+  void setRxBuffer(uint8_t* memory, uint8_t size);
+  void begin();
+  void end();
+  int available();
+  int peek();
+  int read();
+  unsigned long lineTime();
+  uint16_t overflowCount();
+  // bytes received while the channel was active and the dropped ones of them
+  uint32_t received;
+  uint32_t dropped;
+  // bytes read by the sketch
+  uint32_t reads;
+  // max. time of a byte in the ring in µs, from its receive time until the sketch reads it
+  uint32_t maxWait;
+  // max. bytes in the ring at the same time and the size of the ring (one byte stays free)
+  uint8_t maxFill;
+  uint8_t ringSize();
+
+ private:
+  void receive();
+  SimSource* source;
+  uint8_t category;
+  uint16_t isrCycles;
+  bool active;
+  uint8_t defaultBuffer[16];
+  uint8_t* buffer;
+  uint8_t size;
+  uint8_t head;
+  uint8_t tail;
+  // receive time (millis) of the line of every byte in the ring
+  unsigned long lineTimes[256];
+  // receive time (µs) of every byte in the ring
+  uint64_t byteTimes[256];
+  unsigned long actLineTime;
+  bool lineStart;
+  bool readLineStart;
+  unsigned long readLineTime;
+  uint16_t overflows;
+};
+
+extern SimChannel simChannelA;
+extern SimChannel simChannelB;
+
+// registers of the MPU6050 (mpu6050.cpp)
+uint8_t simMpuRead(uint8_t reg);
+void simMpuWrite(uint8_t reg, uint8_t value);
+// time on the I2C bus for count bytes (with start, address and register)
+uint32_t simTwiMicros(uint8_t count);
+
+#endif
@@ -0,0 +1,36 @@
+/*
+ sketchhost.h - the sketch on the pc, included by ino2cpp.sh after the includes of the sketch
+ Copyright (c) 2014 Wilfried Klaas.  All right reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ A long has 64 bits on the pc, but 32 on the avr. The eeprom layout of the logger (config.h) needs the 4 bytes.
+ */
+#ifndef sketchhost_h
+#define sketchhost_h
+
+template <> inline int EEPROM_writeStruct(int address, const unsigned long& value) {
+  uint32_t avrValue = value;
+  return EEPROM_writeStruct(address, avrValue);
+}
+
+template <> inline int EEPROM_readStruct(int address, unsigned long& value) {
+  uint32_t avrValue;
+  int count = EEPROM_readStruct(address, avrValue);
+  value = avrValue;
+  return count;
+}
+
+#endif
@@ -0,0 +1,175 @@
+/*
+ Arduino.h - the part of the Arduino core the SdFat library needs, for the card emulator on the pc
+ Copyright (c) 2014 Wilfried Klaas.  All right reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ millis() and micros() are the emulated time (hostMicros), which is advanced by the card emulator
+ (Sd2Card.cpp) for every transfer and busy time, and by the program for the time between its writes.
+ Serial writes to stdout.
+ */
+#ifndef Arduino_h
+#define Arduino_h
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// flash strings are normal strings
+#ifndef PGM_P
+#define PGM_P const char*
+#endif
+#ifndef PSTR
+#define PSTR(s) (s)
+#endif
+#ifndef pgm_read_byte
+#define pgm_read_byte(p) (*(const uint8_t*) (p))
+#endif
+#ifndef pgm_read_word
+#define pgm_read_word(p) (*(const uint16_t*) (p))
+#endif
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+#ifndef strcpy_P
+#define strcpy_P strcpy
+#define strlen_P strlen
+#define sprintf_P sprintf
+#endif
+
+typedef bool boolean;
+typedef uint8_t byte;
+typedef uint16_t word;
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+// emulated time in µs
+extern uint64_t hostMicros;
+
+inline unsigned long micros() {
+  return (unsigned long) hostMicros;
+}
+
+inline unsigned long millis() {
+  return (unsigned long) (hostMicros / 1000);
+}
+
+inline void delay(unsigned long ms) {
+  hostMicros += ms * 1000ULL;
+}
+
+class __FlashStringHelper;
+#define F(s) ((const __FlashStringHelper*) (s))
+
+class Print {
+ public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size) {
+    size_t n = 0;
+    while (size--) {
+      n += write(*buffer++);
+    }
+    return n;
+  }
+  size_t write(const char* s) {
+    return write((const uint8_t*) s, strlen(s));
+  }
+  size_t print(const __FlashStringHelper* s) {
+    return write((const char*) s);
+  }
+  size_t print(const char* s) {
+    return write(s);
+  }
+  size_t print(char c) {
+    return write((uint8_t) c);
+  }
+  size_t print(unsigned long n, int base = DEC) {
+    char buffer[8 * sizeof(long) + 1];
+    char* p = buffer + sizeof(buffer) - 1;
+    *p = 0;
+    do {
+      byte digit = n % base;
+      *--p = digit < 10 ? '0' + digit : 'A' + digit - 10;
+      n /= base;
+    } while (n);
+    return write(p);
+  }
+  size_t print(long n, int base = DEC) {
+    if ((base == DEC) && (n < 0)) {
+      return print('-') + print((unsigned long) -n, base);
+    }
+    return print((unsigned long) n, base);
+  }
+  size_t print(unsigned char n, int base = DEC) {
+    return print((unsigned long) n, base);
+  }
+  size_t print(int n, int base = DEC) {
+    return print((long) n, base);
+  }
+  size_t print(unsigned int n, int base = DEC) {
+    return print((unsigned long) n, base);
+  }
+  size_t println() {
+    return write("\r\n");
+  }
+  template <typename T> size_t println(T value) {
+    return print(value) + println();
+  }
+  template <typename T> size_t println(T value, int base) {
+    return print(value, base) + println();
+  }
+};
+
+class Stream : public Print {
+ public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  virtual void flush() {}
+};
+
+// stdout as serial port, there is nothing to read
+class HostSerial : public Stream {
+ public:
+  void begin(unsigned long) {}
+  size_t write(uint8_t c) {
+    return fputc(c, stdout) == EOF ? 0 : 1;
+  }
+  using Print::write;
+  int available() {
+    return 0;
+  }
+  int read() {
+    return -1;
+  }
+  int peek() {
+    return -1;
+  }
+  void flush() {
+    fflush(stdout);
+  }
+};
+
+// the logger simulation (Tools/osmsim) has its own Serial, the receiver of channel A
+#ifndef HOST_HARDWARE_SERIAL
+extern HostSerial Serial;
+#endif
+
+#endif
@@ -0,0 +1,286 @@
+/*
+ Sd2Card.cpp - emulated sd card for the SdFat library on the pc, the blocks are in a disk image file
+ Copyright (c) 2014 Wilfried Klaas.  All right reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#define _FILE_OFFSET_BITS 64
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <Sd2Card.h>
+
+#ifndef FALLOC_FL_PUNCH_HOLE
+#define FALLOC_FL_KEEP_SIZE 0x01
+#define FALLOC_FL_PUNCH_HOLE 0x02
+#endif
+
+uint64_t hostMicros = 0;
+
+// a cheap card, 4 MB allocation units. The crc time is the library's CRC_CCITT on a 16 MHz avr.
+SdEmuTiming sdEmuTiming = {
+  50, 300, USE_SD_CRC == 1 ? 3000 : USE_SD_CRC == 2 ? 500 : 0, 800, 2500, 10000, 8192, 200000, 0
+};
+SdEmuCounters sdEmuCounters;
+bool sdEmuHideBusy = false;
+uint64_t sdEmuCutoff = ~0ULL;
+
+static int imageFile = -1;
+static uint32_t imageBlocks = 0;
+// end of the busy time of the last write, erase block of the last write
+static uint64_t busyUntil = 0;
+static uint32_t lastEraseBlock = 0xFFFFFFFF;
+static uint32_t stallRandom = 1;
+
+//------------------------------------------------------------------------------
+bool sdEmuOpen(const char* path) {
+  sdEmuClose();
+  size_t length = strlen(path);
+  if ((length > 3) && !strcmp(path + length - 3, ".gz")) {
+    char command[512];
+    snprintf(command, sizeof(command), "gzip -dc '%s'", path);
+    FILE* packed = popen(command, "r");
+    FILE* image = tmpfile();
+    if (!packed || !image) {
+      return false;
+    }
+    static char buffer[65536];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), packed)) > 0) {
+      fwrite(buffer, 1, n, image);
+    }
+    bool ok = (pclose(packed) == 0) && (fflush(image) == 0);
+    imageFile = dup(fileno(image));
+    fclose(image);
+    if (!ok) {
+      sdEmuClose();
+      return false;
+    }
+  } else {
+    imageFile = open(path, O_RDWR);
+  }
+  if (imageFile < 0) {
+    return false;
+  }
+  struct stat status;
+  fstat(imageFile, &status);
+  imageBlocks = status.st_size >> 9;
+  memset(&sdEmuCounters, 0, sizeof(sdEmuCounters));
+  busyUntil = 0;
+  lastEraseBlock = 0xFFFFFFFF;
+  stallRandom = 1;
+  return true;
+}
+//------------------------------------------------------------------------------
+void sdEmuPowerOn() {
+  busyUntil = 0;
+}
+//------------------------------------------------------------------------------
+void sdEmuClose() {
+  if (imageFile >= 0) {
+    close(imageFile);
+  }
+  imageFile = -1;
+  imageBlocks = 0;
+}
+//------------------------------------------------------------------------------
+void sdEmuNoLatency() {
+  memset(&sdEmuTiming, 0, sizeof(sdEmuTiming));
+}
+//------------------------------------------------------------------------------
+bool Sd2Card::begin(uint8_t chipSelectPin, uint8_t sckDivisor) {
+  m_errorCode = 0;
+  m_sckDivisor = sckDivisor;
+  if (imageFile < 0) {
+    error(SD_CARD_ERROR_CMD0);
+    return false;
+  }
+  type(imageBlocks > 4194304 ? SD_CARD_TYPE_SDHC : SD_CARD_TYPE_SD2);
+  return true;
+}
+//------------------------------------------------------------------------------
+/** time of one block on the bus: token, 512 bytes, crc and the crc calculation */
+uint32_t Sd2Card::blockTransfer() {
+  return (515UL * m_sckDivisor) / 2 + sdEmuTiming.crcUs;
+}
+//------------------------------------------------------------------------------
+uint32_t Sd2Card::cardSize() {
+  return imageBlocks;
+}
+//------------------------------------------------------------------------------
+bool Sd2Card::erase(uint32_t firstBlock, uint32_t lastBlock) {
+  if ((lastBlock < firstBlock) || (lastBlock >= imageBlocks)) {
+    error(SD_CARD_ERROR_ERASE);
+    return false;
+  }
+  waitNotBusy();
+  hostMicros += 3 * sdEmuTiming.commandUs;
+  if (hostMicros >= sdEmuCutoff) {
+    return true;
+  }
+  off_t offset = (off_t) firstBlock << 9;
+  off_t length = (off_t) (lastBlock - firstBlock + 1) << 9;
+  if (fallocate(imageFile, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, length)) {
+    static const uint8_t zero[512] = {0};
+    for (uint32_t i = firstBlock; i <= lastBlock; i++) {
+      if (!writeImage(i, zero, 0)) {
+        error(SD_CARD_ERROR_ERASE);
+        return false;
+      }
+    }
+  }
+  sdEmuCounters.erases++;
+  uint32_t eraseBlocks = 1;
+  if (sdEmuTiming.eraseBlockSize) {
+    eraseBlocks += (lastBlock - firstBlock) / sdEmuTiming.eraseBlockSize;
+  }
+  busyUntil = hostMicros + eraseBlocks * sdEmuTiming.eraseBlockUs;
+  return true;
+}
+//------------------------------------------------------------------------------
+/** one byte on the bus, true if the card is still programming */
+bool Sd2Card::isBusy() {
+  hostMicros += m_sckDivisor / 2 + 1;
+  return !sdEmuHideBusy && (hostMicros < busyUntil);
+}
+//------------------------------------------------------------------------------
+/** the card is busy after a written block, longer in another erase block and sometimes much longer */
+void Sd2Card::programmed(uint32_t blockNumber, uint32_t programUs) {
+  if (sdEmuTiming.eraseBlockSize) {
+    uint32_t eraseBlock = blockNumber / sdEmuTiming.eraseBlockSize;
+    if (eraseBlock != lastEraseBlock) {
+      lastEraseBlock = eraseBlock;
+      sdEmuCounters.eraseBlockChanges++;
+      programUs += sdEmuTiming.eraseBlockUs;
+    }
+  }
+  stallRandom = stallRandom * 1103515245UL + 12345;
+  if (((stallRandom >> 16) % 1000) < sdEmuTiming.stallPerMille) {
+    sdEmuCounters.stalls++;
+    programUs += sdEmuTiming.stallUs;
+  }
+  busyUntil = hostMicros + programUs;
+}
+//------------------------------------------------------------------------------
+bool Sd2Card::readBlock(uint32_t blockNumber, uint8_t* dst) {
+  waitNotBusy();
+  hostMicros += sdEmuTiming.commandUs;
+  if (!readImage(blockNumber, dst)) {
+    error(SD_CARD_ERROR_CMD17);
+    return false;
+  }
+  return true;
+}
+//------------------------------------------------------------------------------
+bool Sd2Card::readData(uint8_t *dst) {
+  if (!readImage(m_block, dst)) {
+    error(SD_CARD_ERROR_READ);
+    return false;
+  }
+  m_block++;
+  return true;
+}
+//------------------------------------------------------------------------------
+bool Sd2Card::readImage(uint32_t blockNumber, uint8_t* dst) {
+  if ((blockNumber >= imageBlocks) || (pread(imageFile, dst, 512, (off_t) blockNumber << 9) != 512)) {
+    return false;
+  }
+  hostMicros += sdEmuTiming.readUs + blockTransfer();
+  sdEmuCounters.blocksRead++;
+  return true;
+}
+//------------------------------------------------------------------------------
+bool Sd2Card::readStart(uint32_t blockNumber) {
+  waitNotBusy();
+  hostMicros += sdEmuTiming.commandUs;
+  m_block = blockNumber;
+  return true;
+}
+//------------------------------------------------------------------------------
+bool Sd2Card::readStop() {
+  hostMicros += sdEmuTiming.commandUs;
+  return true;
+}
+//------------------------------------------------------------------------------
+/** the library waits in every command, until the card is ready */
+void Sd2Card::waitNotBusy() {
+  if (hostMicros < busyUntil) {
+    sdEmuCounters.busyUs += busyUntil - hostMicros;
+    hostMicros = busyUntil;
+  }
+}
+//------------------------------------------------------------------------------
+/** like the library without CHECK_PROGRAMMING, the card is still busy on return */
+bool Sd2Card::writeBlock(uint32_t blockNumber, const uint8_t* src) {
+  waitNotBusy();
+  hostMicros += sdEmuTiming.commandUs;
+  if (!writeImage(blockNumber, src, sdEmuTiming.singleProgramUs)) {
+    error(SD_CARD_ERROR_CMD24);
+    return false;
+  }
+  sdEmuCounters.singleWrites++;
+  programmed(blockNumber, sdEmuTiming.singleProgramUs);
+  return true;
+}
+//------------------------------------------------------------------------------
+bool Sd2Card::writeData(const uint8_t* src) {
+  waitNotBusy();
+  if (!writeImage(m_block, src, sdEmuTiming.programUs)) {
+    error(SD_CARD_ERROR_WRITE_MULTIPLE);
+    return false;
+  }
+  programmed(m_block, sdEmuTiming.programUs);
+  m_block++;
+  return true;
+}
+//------------------------------------------------------------------------------
+/** a block, which isn't programmed before the cut off, is lost */
+bool Sd2Card::writeImage(uint32_t blockNumber, const uint8_t* src, uint32_t programUs) {
+  if (blockNumber >= imageBlocks) {
+    return false;
+  }
+  if ((hostMicros + blockTransfer() + programUs <= sdEmuCutoff) &&
+      (pwrite(imageFile, src, 512, (off_t) blockNumber << 9) != 512)) {
+    return false;
+  }
+  hostMicros += blockTransfer();
+  sdEmuCounters.blocksWritten++;
+  return true;
+}
+//------------------------------------------------------------------------------
+/** pre erase (ACMD23) and write multiple (CMD25) */
+bool Sd2Card::writeStart(uint32_t blockNumber, uint32_t eraseCount) {
+  waitNotBusy();
+  hostMicros += 3 * sdEmuTiming.commandUs;
+  if (blockNumber >= imageBlocks) {
+    error(SD_CARD_ERROR_CMD25);
+    return false;
+  }
+  m_block = blockNumber;
+  if (eraseCount > 1) {
+    sdEmuCounters.preErased += eraseCount;
+    if (sdEmuTiming.eraseBlockSize) {
+      busyUntil = hostMicros + (1 + (eraseCount - 1) / sdEmuTiming.eraseBlockSize) * sdEmuTiming.eraseBlockUs;
+    }
+  }
+  return true;
+}
+//------------------------------------------------------------------------------
+/** the stop token, the library waits until the last block is programmed */
+bool Sd2Card::writeStop() {
+  waitNotBusy();
+  hostMicros += sdEmuTiming.commandUs;
+  return true;
+}
@@ -0,0 +1,220 @@
+/*
+ Sd2Card.h - emulated sd card for the SdFat library on the pc, the blocks are in a disk image file
+ Copyright (c) 2014 Wilfried Klaas.  All right reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ Same interface as the Sd2Card of the library, so SdVolume, SdBaseFile and SdFat are compiled unchanged,
+ this directory just comes first in the include path. The card is opened with sdEmuOpen() before begin().
+
+ Time model (all in µs of hostMicros, see Arduino.h):
+ - every byte on the bus takes 8 * sckDivisor / 16 µs (16 MHz cpu), a block is 512 bytes, token and crc
+ - every command takes commandUs, a read waits readUs for the data token
+ - with USE_SD_CRC the crc of every block costs crcUs of cpu time
+ - after a written block the card is busy for programUs (multi block write) or singleProgramUs (writeBlock).
+   Like the real card the next access waits for this, only isBusy() doesn't (unless sdEmuHideBusy).
+ - a write into another erase block (allocation unit) than the last write costs eraseBlockUs more
+ - the pre erase of a multi block write (writeStart) costs eraseBlockUs per erase block of the count, like erase()
+ - stallPerMille of the written blocks take stallUs more (wear leveling, garbage collection)
+ After sdEmuCutoff (power lost) the card takes no more writes, a block is only written, if it's transferred and
+ programmed before.
+ */
+#ifndef SpiCard_h
+#define SpiCard_h
+#include <Arduino.h>
+#include <SdFatConfig.h>
+#include <SdInfo.h>
+// the constants of the library's Sd2Card.h
+//------------------------------------------------------------------------------
+/** Set SCK to max rate of F_CPU/2. */
+uint8_t const SPI_FULL_SPEED = 2;
+/** Set SCK rate to F_CPU/3 for Due */
+uint8_t const SPI_DIV3_SPEED = 3;
+/** Set SCK rate to F_CPU/4. */
+uint8_t const SPI_HALF_SPEED = 4;
+/** Set SCK rate to F_CPU/6 for Due */
+uint8_t const SPI_DIV6_SPEED = 6;
+/** Set SCK rate to F_CPU/8. */
+uint8_t const SPI_QUARTER_SPEED = 8;
+/** Set SCK rate to F_CPU/16. */
+uint8_t const SPI_EIGHTH_SPEED = 16;
+/** Set SCK rate to F_CPU/32. */
+uint8_t const SPI_SIXTEENTH_SPEED = 32;
+//------------------------------------------------------------------------------
+/** init timeout ms */
+uint16_t const SD_INIT_TIMEOUT = 2000;
+/** erase timeout ms */
+uint16_t const SD_ERASE_TIMEOUT = 10000;
+/** read timeout ms */
+uint16_t const SD_READ_TIMEOUT = 300;
+/** write time out ms */
+uint16_t const SD_WRITE_TIMEOUT = 600;
+//------------------------------------------------------------------------------
+// SD card errors
+/** timeout error for command CMD0 (initialize card in SPI mode) */
+uint8_t const SD_CARD_ERROR_CMD0 = 0X1;
+/** CMD8 was not accepted - not a valid SD card*/
+uint8_t const SD_CARD_ERROR_CMD8 = 0X2;
+/** card returned an error response for CMD12 (stop multiblock read) */
+uint8_t const SD_CARD_ERROR_CMD12 = 0X3;
+/** card returned an error response for CMD17 (read block) */
+uint8_t const SD_CARD_ERROR_CMD17 = 0X4;
+/** card returned an error response for CMD18 (read multiple block) */
+uint8_t const SD_CARD_ERROR_CMD18 = 0X5;
+/** card returned an error response for CMD24 (write block) */
+uint8_t const SD_CARD_ERROR_CMD24 = 0X6;
+/**  WRITE_MULTIPLE_BLOCKS command failed */
+uint8_t const SD_CARD_ERROR_CMD25 = 0X7;
+/** card returned an error response for CMD58 (read OCR) */
+uint8_t const SD_CARD_ERROR_CMD58 = 0X8;
+/** SET_WR_BLK_ERASE_COUNT failed */
+uint8_t const SD_CARD_ERROR_ACMD23 = 0X9;
+/** ACMD41 initialization process timeout */
+uint8_t const SD_CARD_ERROR_ACMD41 = 0XA;
+/** card returned a bad CSR version field */
+uint8_t const SD_CARD_ERROR_BAD_CSD = 0XB;
+/** erase block group command failed */
+uint8_t const SD_CARD_ERROR_ERASE = 0XC;
+/** card not capable of single block erase */
+uint8_t const SD_CARD_ERROR_ERASE_SINGLE_BLOCK = 0XD;
+/** Erase sequence timed out */
+uint8_t const SD_CARD_ERROR_ERASE_TIMEOUT = 0XE;
+/** card returned an error token instead of read data */
+uint8_t const SD_CARD_ERROR_READ = 0XF;
+/** read CID or CSD failed */
+uint8_t const SD_CARD_ERROR_READ_REG = 0X10;
+/** timeout while waiting for start of read data */
+uint8_t const SD_CARD_ERROR_READ_TIMEOUT = 0X11;
+/** card did not accept STOP_TRAN_TOKEN */
+uint8_t const SD_CARD_ERROR_STOP_TRAN = 0X12;
+/** card returned an error token as a response to a write operation */
+uint8_t const SD_CARD_ERROR_WRITE = 0X13;
+/** attempt to write protected block zero */
+uint8_t const SD_CARD_ERROR_WRITE_BLOCK_ZERO = 0X14;  // REMOVE - not used
+/** card did not go ready for a multiple block write */
+uint8_t const SD_CARD_ERROR_WRITE_MULTIPLE = 0X15;
+/** card returned an error to a CMD13 status check after a write */
+uint8_t const SD_CARD_ERROR_WRITE_PROGRAMMING = 0X16;
+/** timeout occurred during write programming */
+uint8_t const SD_CARD_ERROR_WRITE_TIMEOUT = 0X17;
+/** incorrect rate selected */
+uint8_t const SD_CARD_ERROR_SCK_RATE = 0X18;
+/** init() not called */
+uint8_t const SD_CARD_ERROR_INIT_NOT_CALLED = 0X19;
+/** card returned an error for CMD59 (CRC_ON_OFF) */
+uint8_t const SD_CARD_ERROR_CMD59 = 0X1A;
+/** invalid read CRC */
+uint8_t const SD_CARD_ERROR_READ_CRC = 0X1B;
+/** SPI DMA error */
+uint8_t const SD_CARD_ERROR_SPI_DMA = 0X1C;
+//------------------------------------------------------------------------------
+// card types
+/** Standard capacity V1 SD card */
+uint8_t const SD_CARD_TYPE_SD1  = 1;
+/** Standard capacity V2 SD card */
+uint8_t const SD_CARD_TYPE_SD2  = 2;
+/** High Capacity SD card */
+uint8_t const SD_CARD_TYPE_SDHC = 3;
+//------------------------------------------------------------------------------
+/** chip select of the logger, not used by the emulator */
+uint8_t const SD_CHIP_SELECT_PIN = 10;
+
+// timing of the emulated card, see above
+struct SdEmuTiming {
+  uint16_t commandUs;
+  uint16_t readUs;
+  uint16_t crcUs;
+  uint32_t programUs;
+  uint32_t singleProgramUs;
+  uint32_t eraseBlockUs;
+  // size of an erase block in blocks, 0 = no erase blocks
+  uint32_t eraseBlockSize;
+  uint32_t stallUs;
+  uint16_t stallPerMille;
+};
+
+// counters of the emulated card since sdEmuOpen()
+struct SdEmuCounters {
+  uint32_t blocksRead;
+  uint32_t blocksWritten;
+  uint32_t singleWrites;
+  uint32_t eraseBlockChanges;
+  uint32_t stalls;
+  uint32_t erases;
+  // blocks pre erased by writeStart()
+  uint32_t preErased;
+  // time spent waiting for the busy card
+  uint64_t busyUs;
+};
+
+extern SdEmuTiming sdEmuTiming;
+extern SdEmuCounters sdEmuCounters;
+// isBusy() always reports a ready card, the next access waits for it (a logger, which doesn't ask the card)
+extern bool sdEmuHideBusy;
+// time of the power loss in µs of hostMicros, no cut off by default
+extern uint64_t sdEmuCutoff;
+
+// opening the image, a .gz image is unpacked into a temporary file, so the image itself stays unchanged
+bool sdEmuOpen(const char* path);
+void sdEmuClose();
+// the card is idle at the start of the logger, hostMicros starts at 0 again (osmsim prepares the card before)
+void sdEmuPowerOn();
+// no latency at all, only the blocks
+void sdEmuNoLatency();
+
+/**
+ * \class Sd2Card
+ * \brief Emulated SD card, see above.
+ */
+class Sd2Card {
+ public:
+  Sd2Card() : m_errorCode(SD_CARD_ERROR_INIT_NOT_CALLED), m_sckDivisor(SPI_FULL_SPEED), m_type(0) {}
+  bool begin(uint8_t chipSelectPin = SD_CHIP_SELECT_PIN,
+            uint8_t sckDivisor = SPI_FULL_SPEED);
+  uint32_t cardSize();
+  bool erase(uint32_t firstBlock, uint32_t lastBlock);
+  bool eraseSingleBlockEnable() {return true;}
+  void error(uint8_t code) {m_errorCode = code;}
+  int errorCode() const {return m_errorCode;}
+  int errorData() const {return 0;}
+  bool init(uint8_t sckDivisor = SPI_FULL_SPEED,
+            uint8_t chipSelectPin = SD_CHIP_SELECT_PIN) {
+    return begin(chipSelectPin, sckDivisor);
+  }
+  bool isBusy();
+  bool readBlock(uint32_t block, uint8_t* dst);
+  bool readData(uint8_t *dst);
+  bool readStart(uint32_t blockNumber);
+  bool readStop();
+  uint8_t sckDivisor() {return m_sckDivisor;}
+  int type() const {return m_type;}
+  bool writeBlock(uint32_t blockNumber, const uint8_t* src);
+  bool writeData(const uint8_t* src);
+  bool writeStart(uint32_t blockNumber, uint32_t eraseCount);
+  bool writeStop();
+
+ private:
+  uint32_t blockTransfer();
+  void programmed(uint32_t blockNumber, uint32_t programUs);
+  bool readImage(uint32_t blockNumber, uint8_t* dst);
+  void type(uint8_t value) {m_type = value;}
+  void waitNotBusy();
+  bool writeImage(uint32_t blockNumber, const uint8_t* src, uint32_t programUs);
+  uint8_t m_errorCode;
+  uint8_t m_sckDivisor;
+  uint8_t m_type;
+  uint32_t m_block;
+};
+#endif  // SpiCard_h
@@ -0,0 +1,220 @@
+/*
+ mkfat32.cpp - creating an empty FAT32 image of a sd card for the emulated card (Sd2Card.cpp)
+ Copyright (c) 2014 Wilfried Klaas.  All right reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ The image of the test folder is FAT16, its root directory has only 512 entries. A SDHC card is FAT32
+ with a root directory without limit. The image is formatted like a new card: one partition at 4 MB,
+ 32 kB clusters (-c, smaller for small cards, FAT32 needs 65525 clusters at least), 2 FATs, FSINFO with the
+ free count. Only the written blocks use space on the disk.
+ -f fills the percent of the clusters from the start of the card with the files fill0000.dat ... (1 GB each, their
+ data isn't written), like a card full of old logs. The next free cluster of the FSINFO is the first behind them.
+
+ build: g++ -O2 -I../../SketchBook/libraries/SdFat -o mkfat32 mkfat32.cpp
+ usage: mkfat32 [-s MB] [-c cluster kB] [-f percent] image
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <SdFatStructs.h>
+
+// the partition starts at 4 MB like on a new card (erase block alignment)
+#define PARTITION_START 8192
+#define RESERVED_BLOCKS 32
+// max. size of a fill file
+#define FILL_FILE_MB 1024
+
+// the block types of the image (cache_t of SdVolume.h)
+union block_t {
+  mbr_t mbr;
+  fat32_boot_t fbs32;
+  fat32_fsinfo_t fsinfo;
+  uint32_t fat32[128];
+  dir_t dir[16];
+};
+
+FILE* image;
+
+bool writeBlock(uint32_t block, const void* data) {
+  return (fseek(image, (long) block * 512, SEEK_SET) == 0) && (fwrite(data, 512, 1, image) == 1);
+}
+
+int main(int argc, char* argv[]) {
+  uint32_t megabytes = 4096;
+  uint8_t blocksPerCluster = 64;
+  uint8_t percent = 0;
+  int opt;
+  while ((opt = getopt(argc, argv, "s:c:f:")) != -1) {
+    switch (opt) {
+      case 's':
+        megabytes = atol(optarg);
+        break;
+      case 'c':
+        blocksPerCluster = atoi(optarg) * 2;
+        break;
+      case 'f':
+        percent = atoi(optarg);
+        break;
+      default:
+        fprintf(stderr, "usage: mkfat32 [-s MB] [-c cluster kB] [-f percent] image\n");
+        return 1;
+    }
+  }
+  if (optind >= argc) {
+    fprintf(stderr, "no image file\n");
+    return 1;
+  }
+  if ((blocksPerCluster == 0) || (blocksPerCluster & (blocksPerCluster - 1))) {
+    fprintf(stderr, "the cluster size must be 1, 2, 4 ... 64 kB\n");
+    return 1;
+  }
+  uint32_t totalBlocks = megabytes * 2048UL;
+  uint32_t partitionBlocks = totalBlocks - PARTITION_START;
+  // the FAT has 4 bytes for every cluster and the 2 reserved entries
+  uint32_t fatBlocks = 1;
+  uint32_t clusters;
+  for (;;) {
+    clusters = (partitionBlocks - RESERVED_BLOCKS - 2 * fatBlocks) / blocksPerCluster;
+    uint32_t needed = ((clusters + 2) * 4 + 511) / 512;
+    if (needed <= fatBlocks) {
+      break;
+    }
+    fatBlocks = needed;
+  }
+  if (clusters < 65525) {
+    fprintf(stderr, "%lu MB is too small for FAT32 with %u kB clusters\n", (unsigned long) megabytes,
+            blocksPerCluster / 2);
+    return 1;
+  }
+  // the fill files use the clusters from 3 on (the root directory is cluster 2), the directory has one cluster
+  uint32_t used = (uint64_t) (clusters - 1) * std::min(percent, (uint8_t) 100) / 100;
+  uint32_t fileClusters = FILL_FILE_MB * 2048UL / blocksPerCluster;
+  uint32_t files = (used + fileClusters - 1) / fileClusters;
+  if (files > blocksPerCluster * 16UL) {
+    fprintf(stderr, "%lu fill files don't fit into the root directory\n", (unsigned long) files);
+    return 1;
+  }
+
+  image = fopen(argv[optind], "w+b");
+  if (!image || ftruncate(fileno(image), (off_t) totalBlocks * 512)) {
+    fprintf(stderr, "can't create %s\n", argv[optind]);
+    return 1;
+  }
+  block_t block;
+  bool ok = true;
+
+  memset(&block, 0, sizeof(block));
+  part_t* part = &block.mbr.part[0];
+  part->type = 0x0C;
+  part->firstSector = PARTITION_START;
+  part->totalSectors = partitionBlocks;
+  block.mbr.mbrSig0 = BOOTSIG0;
+  block.mbr.mbrSig1 = BOOTSIG1;
+  ok &= writeBlock(0, &block);
+
+  memset(&block, 0, sizeof(block));
+  fat32_boot_t* fbs = &block.fbs32;
+  memcpy(fbs->jump, "\xEB\x58\x90", 3);
+  memcpy(fbs->oemId, "OSMLOG  ", 8);
+  fbs->bytesPerSector = 512;
+  fbs->sectorsPerCluster = blocksPerCluster;
+  fbs->reservedSectorCount = RESERVED_BLOCKS;
+  fbs->fatCount = 2;
+  fbs->mediaType = 0xF8;
+  fbs->sectorsPerTrack = 63;
+  fbs->headCount = 255;
+  fbs->hidddenSectors = PARTITION_START;
+  fbs->totalSectors32 = partitionBlocks;
+  fbs->sectorsPerFat32 = fatBlocks;
+  fbs->fat32RootCluster = 2;
+  fbs->fat32FSInfo = 1;
+  fbs->fat32BackBootBlock = 6;
+  fbs->driveNumber = 0x80;
+  fbs->bootSignature = EXTENDED_BOOT_SIG;
+  fbs->volumeSerialNumber = 0x20141006;
+  memcpy(fbs->volumeLabel, "OSMLOGGER  ", 11);
+  memcpy(fbs->fileSystemType, "FAT32   ", 8);
+  fbs->bootSectorSig0 = BOOTSIG0;
+  fbs->bootSectorSig1 = BOOTSIG1;
+  ok &= writeBlock(PARTITION_START, &block);
+  ok &= writeBlock(PARTITION_START + 6, &block);
+
+  memset(&block, 0, sizeof(block));
+  block.fsinfo.leadSignature = FSINFO_LEAD_SIG;
+  block.fsinfo.structSignature = FSINFO_STRUCT_SIG;
+  // the root directory uses cluster 2
+  block.fsinfo.freeCount = clusters - 1 - used;
+  block.fsinfo.nextFree = 3 + used;
+  block.fsinfo.tailSignature[2] = BOOTSIG0;
+  block.fsinfo.tailSignature[3] = BOOTSIG1;
+  ok &= writeBlock(PARTITION_START + 1, &block);
+  ok &= writeBlock(PARTITION_START + 7, &block);
+
+  // media type, end of chain and the root directory in the first block of both FATs, then the chains of the
+  // fill files, the rest of the FATs reads as zero (free)
+  uint32_t fatStart = PARTITION_START + RESERVED_BLOCKS;
+  uint32_t lastUsed = 2 + used;
+  for (uint32_t i = 0; i <= lastUsed / 128; i++) {
+    memset(&block, 0, sizeof(block));
+    for (uint32_t j = 0; j < 128; j++) {
+      uint32_t cluster = i * 128 + j;
+      if (cluster == 0) {
+        block.fat32[j] = 0x0FFFFFF8;
+      } else if (cluster <= 2) {
+        block.fat32[j] = FAT32EOC;
+      } else if (cluster <= lastUsed) {
+        block.fat32[j] = (((cluster - 2) % fileClusters) && (cluster < lastUsed)) ? cluster + 1 : FAT32EOC;
+      }
+    }
+    ok &= writeBlock(fatStart + i, &block);
+    ok &= writeBlock(fatStart + fatBlocks + i, &block);
+  }
+
+  // the root directory with the fill files, the unused blocks of the image read as zero
+  uint32_t rootStart = fatStart + 2 * fatBlocks;
+  for (uint32_t i = 0; i < blocksPerCluster; i++) {
+    memset(&block, 0, sizeof(block));
+    for (uint32_t j = 0; j < 16; j++) {
+      uint32_t file = i * 16 + j;
+      if (file < files) {
+        dir_t* dir = &block.dir[j];
+        char name[13];
+        sprintf(name, "FILL%04luDAT", (unsigned long) file);
+        memcpy(dir->name, name, 11);
+        dir->attributes = DIR_ATT_ARCHIVE;
+        uint32_t first = 3 + file * fileClusters;
+        dir->firstClusterHigh = first >> 16;
+        dir->firstClusterLow = first & 0xFFFF;
+        dir->fileSize = std::min(fileClusters, used - file * fileClusters) * blocksPerCluster * 512UL;
+      }
+    }
+    ok &= writeBlock(rootStart + i, &block);
+  }
+  ok &= fclose(image) == 0;
+  if (!ok) {
+    fprintf(stderr, "can't write %s\n", argv[optind]);
+    return 1;
+  }
+  printf("%s: %lu MB, %lu clusters of %u kB, FAT %lu blocks, %lu clusters used by %lu fill files\n", argv[optind],
+         (unsigned long) megabytes, (unsigned long) clusters, blocksPerCluster / 2, (unsigned long) fatBlocks,
+         (unsigned long) used, (unsigned long) files);
+  return 0;
+}
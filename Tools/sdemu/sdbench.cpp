@@ -0,0 +1,311 @@
+/*
+ sdbench.cpp - write benchmark of the logger's data file on the emulated sd card
+ Copyright (c) 2014 Wilfried Klaas.  All right reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ The lines of a NMEA file are written like the logger does it: hh:mm:ss.SSS;A; line CR LF into data0000.dat,
+ with the block writer of the logger (blockwriter.h of the sketch: preallocated contiguous file, multi
+ block write) or as a normal file, flushed every flush interval. The SdFat library is
+ the one of the logger, the card is emulated by Sd2Card.cpp of this directory.
+ The lines come at the baudrate, the time between them is the time of the logger waiting for data.
+ Output is the time the card needed (bytes per second of card time), the counters of the card and the
+ histograms of the time of the single line writes and of the flushes (syncDataFile() of the block writer).
+ At the end the file is read back and compared.
+
+ build: g++ -O2 -DARDUINO=105 -I. -I../../SketchBook/libraries/SdFat -o sdbench sdbench.cpp Sd2Card.cpp \
+          ../../SketchBook/libraries/SdFat/{SdFat,SdVolume,SdBaseFile,SdBaseFilePrint,SdFile,SdFatErrorPrint}.cpp
+ usage: sdbench [-m block|file] [-b baud] [-t seconds] [-f flush seconds] [-d spi divisor]
+                [-p stalls per mille] [-s stall ms] [-e erase block kB] [-n] image [nmea file]
+ The image is e.g. ../../test/image.dd.gz (unpacked into a temporary file), the NMEA file
+ e.g. ../../test/20130629_135830.nmea.gz. Without a NMEA file a fixed RMC sentence is written.
+ -n switches off the latency model of the card, only the time on the spi bus is left.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <SdFat.h>
+
+#include <string>
+#include <vector>
+
+#include "../../SketchBook/OpenSeaMap/osmfunctions.h"
+
+#define HISTOGRAM_SIZE 13
+
+// upper limits of the histogram classes in µs, the last class is everything above
+static const uint32_t histogramLimits[HISTOGRAM_SIZE - 1] = {
+  100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000
+};
+
+HostSerial Serial;
+SdFat sd;
+SdFile dataFile;
+boolean error = false;
+
+// the block writer of the logger
+#include "../../SketchBook/OpenSeaMap/blockwriter.h"
+
+uint32_t fileHash = 2166136261UL;
+
+/**
+ * FNV-1a of all written bytes, for the compare at the end.
+ **/
+uint32_t hashBytes(uint32_t hash, const uint8_t* data, size_t count) {
+  while (count--) {
+    hash = (hash ^ *data++) * 16777619UL;
+  }
+  return hash;
+}
+
+/**
+ * class of a time in µs in the histograms.
+ **/
+byte histogramClass(uint32_t time) {
+  byte i = 0;
+  while ((i < HISTOGRAM_SIZE - 1) && (time >= histogramLimits[i])) {
+    i++;
+  }
+  return i;
+}
+
+/**
+ * writing data with logWrite() of the logger, the bytes are hashed for the compare.
+ **/
+void benchWrite(const void* data, byte count) {
+  fileHash = hashBytes(fileHash, (const uint8_t*) data, count);
+  logWrite(data, count);
+}
+
+/**
+ * creating the data file like openDataFile() of the logger, with a fixed name.
+ **/
+bool openDataFile(bool preallocate, uint32_t size) {
+  resetBlockWriter();
+  if (preallocate) {
+    return dataFile.createContiguous(sd.vwd(), "data0000.dat", size) && startBlockWriter();
+  }
+  return dataFile.open("data0000.dat", O_RDWR | O_CREAT | O_TRUNC);
+}
+
+/**
+ * reading the lines of the NMEA file, without CR LF.
+ **/
+bool readLines(const char* path, std::vector<std::string>* lines) {
+  std::string command = std::string("gzip -dcf '") + path + "'";
+  FILE* file = popen(command.c_str(), "r");
+  if (!file) {
+    return false;
+  }
+  char line[256];
+  while (fgets(line, sizeof(line), file)) {
+    size_t length = strcspn(line, "\r\n");
+    if (length > 0) {
+      lines->push_back(std::string(line, length));
+    }
+  }
+  pclose(file);
+  return !lines->empty();
+}
+
+/**
+ * comparing the file with the hash of the written bytes.
+ **/
+bool verifyDataFile(uint32_t* size) {
+  SdFile file;
+  if (!file.open("data0000.dat", O_READ)) {
+    return false;
+  }
+  *size = file.fileSize();
+  uint32_t hash = 2166136261UL;
+  uint8_t buffer[512];
+  int n;
+  while ((n = file.read(buffer, sizeof(buffer))) > 0) {
+    hash = hashBytes(hash, buffer, n);
+  }
+  file.close();
+  return hash == fileHash;
+}
+
+int main(int argc, char* argv[]) {
+  bool preallocate = true;
+  uint32_t baud = 4800;
+  uint32_t seconds = 3600;
+  uint32_t flushInterval = 60;
+  uint8_t divisor = SPI_HALF_SPEED;
+  bool latency = true;
+  int opt;
+  while ((opt = getopt(argc, argv, "m:b:t:f:d:p:s:e:n")) != -1) {
+    switch (opt) {
+      case 'm':
+        preallocate = strcmp(optarg, "file") != 0;
+        break;
+      case 'b':
+        baud = atol(optarg);
+        break;
+      case 't':
+        seconds = atol(optarg);
+        break;
+      case 'f':
+        flushInterval = atol(optarg);
+        break;
+      case 'd':
+        divisor = atoi(optarg);
+        break;
+      case 'p':
+        sdEmuTiming.stallPerMille = atoi(optarg);
+        break;
+      case 's':
+        sdEmuTiming.stallUs = atol(optarg) * 1000UL;
+        break;
+      case 'e':
+        sdEmuTiming.eraseBlockSize = atol(optarg) * 2;
+        break;
+      case 'n':
+        latency = false;
+        break;
+      default:
+        fprintf(stderr, "usage: sdbench [-m block|file] [-b baud] [-t seconds] [-f flush seconds] [-d spi divisor]\n"
+                "               [-p stalls per mille] [-s stall ms] [-e erase block kB] [-n] image [nmea file]\n");
+        return 1;
+    }
+  }
+  if (optind >= argc) {
+    fprintf(stderr, "no image file\n");
+    return 1;
+  }
+  if (!latency) {
+    sdEmuNoLatency();
+  }
+  std::vector<std::string> lines;
+  if (optind + 1 < argc) {
+    if (!readLines(argv[optind + 1], &lines)) {
+      fprintf(stderr, "can't read %s\n", argv[optind + 1]);
+      return 1;
+    }
+  } else {
+    lines.push_back("$GPRMC,135830.00,A,5132.1234,N,00712.5678,E,5.2,231.4,290613,,,A*6C");
+  }
+  if (!sdEmuOpen(argv[optind])) {
+    fprintf(stderr, "can't open image %s\n", argv[optind]);
+    return 1;
+  }
+  if (!sd.begin(SD_CHIP_SELECT_PIN, divisor)) {
+    sd.initErrorPrint();
+    return 1;
+  }
+  sd.remove("data0000.dat");
+
+  // one hour of data like the logger (initSerials), a longer run gets the whole time
+  uint32_t size = (baud / 5) * (seconds > 3600 ? seconds : 3600UL);
+  if (size < 1024UL * 1024UL) {
+    size = 1024UL * 1024UL;
+  }
+  SdEmuCounters start = sdEmuCounters;
+  uint64_t cardTime = 0;
+  uint64_t time = hostMicros;
+  if (!openDataFile(preallocate, size)) {
+    fprintf(stderr, "can't create the data file\n");
+    return 1;
+  }
+  uint64_t openTime = hostMicros - time;
+  cardTime += openTime;
+
+  uint32_t histogram[HISTOGRAM_SIZE] = {0};
+  uint32_t flushHistogram[HISTOGRAM_SIZE] = {0};
+  uint32_t flushes = 0;
+  uint64_t flushSum = 0;
+  uint32_t maxLine = 0, maxFlush = 0, writes = 0;
+  uint64_t bytes = 0;
+  uint64_t end = hostMicros + seconds * 1000000ULL;
+  uint64_t nextFlush = hostMicros + flushInterval * 1000000ULL;
+  uint64_t logStart = hostMicros;
+  size_t next = 0;
+  while (hostMicros < end) {
+    const std::string& line = lines[next];
+    next = (next + 1) % lines.size();
+    // receiving the line
+    hostMicros += (line.size() + 2) * 10000000ULL / baud;
+
+    time = hostMicros;
+    advanceTimeStamp((uint32_t) ((hostMicros - logStart) / 1000));
+    benchWrite(timeStampText, TIMESTAMP_LENGTH);
+    benchWrite("A;", 2);
+    benchWrite(line.data(), line.size());
+    benchWrite("\r\n", 2);
+    uint32_t lineTime = hostMicros - time;
+    cardTime += lineTime;
+    bytes += TIMESTAMP_LENGTH + 2 + line.size() + 2;
+    writes++;
+    histogram[histogramClass(lineTime)]++;
+    if (lineTime > maxLine) {
+      maxLine = lineTime;
+    }
+
+    if (hostMicros >= nextFlush) {
+      time = hostMicros;
+      syncDataFile();
+      uint32_t flushTime = hostMicros - time;
+      cardTime += flushTime;
+      flushHistogram[histogramClass(flushTime)]++;
+      flushes++;
+      flushSum += flushTime;
+      if (flushTime > maxFlush) {
+        maxFlush = flushTime;
+      }
+      nextFlush += flushInterval * 1000000ULL;
+    }
+  }
+  time = hostMicros;
+  closeDataFile();
+  uint64_t closeTime = hostMicros - time;
+  cardTime += closeTime;
+  SdEmuCounters counters = sdEmuCounters;
+
+  uint32_t fileSize = 0;
+  bool ok = verifyDataFile(&fileSize) && !error && (fileSize == bytes);
+
+  printf("%s, %lu baud, %lu s, flush %lu s, spi divisor %u, %s\n", preallocate ? "block writer" : "normal file",
+         (unsigned long) baud, (unsigned long) seconds, (unsigned long) flushInterval, divisor,
+         latency ? "latency model" : "no latency");
+  printf("written: %llu bytes, %lu lines, card time %.3f s (%.1f %% of the logging time)\n",
+         (unsigned long long) bytes, (unsigned long) writes, cardTime / 1e6, 100.0 * cardTime / (end - logStart));
+  printf("throughput: %.0f bytes/s of card time\n", cardTime ? bytes * 1e6 / cardTime : 0.0);
+  printf("open %.1f ms, close %.1f ms, max. line %.1f ms, %lu flushes, mean %.1f ms, max. %.1f ms\n",
+         openTime / 1e3, closeTime / 1e3, maxLine / 1e3, (unsigned long) flushes,
+         flushes ? flushSum / 1e3 / flushes : 0.0, maxFlush / 1e3);
+  printf("card: %lu blocks read, %lu written (%lu single), %lu erase block changes, %lu stalls, %lu erases, "
+         "%lu blocks pre erased, busy waits %.3f s\n",
+         (unsigned long) (counters.blocksRead - start.blocksRead),
+         (unsigned long) (counters.blocksWritten - start.blocksWritten),
+         (unsigned long) (counters.singleWrites - start.singleWrites),
+         (unsigned long) (counters.eraseBlockChanges - start.eraseBlockChanges),
+         (unsigned long) (counters.stalls - start.stalls), (unsigned long) (counters.erases - start.erases),
+         (unsigned long) (counters.preErased - start.preErased), (counters.busyUs - start.busyUs) / 1e6);
+  printf("write time:          lines   flushes\n");
+  for (byte i = 0; i < HISTOGRAM_SIZE; i++) {
+    if (i < HISTOGRAM_SIZE - 1) {
+      printf("  < %7.1f ms %9lu %9lu\n", histogramLimits[i] / 1e3, (unsigned long) histogram[i],
+             (unsigned long) flushHistogram[i]);
+    } else {
+      printf(" >= %7.1f ms %9lu %9lu\n", histogramLimits[i - 1] / 1e3, (unsigned long) histogram[i],
+             (unsigned long) flushHistogram[i]);
+    }
+  }
+  printf("verify: %s (file size %lu)\n", ok ? "ok" : "FAILED", (unsigned long) fileSize);
+  sdEmuClose();
+  return ok ? 0 : 2;
+}
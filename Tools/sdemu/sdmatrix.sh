@@ -0,0 +1,103 @@
+#!/bin/bash
+# sdmatrix.sh
+#
+# Purpose:
+#   o write benchmark of the SdFat options of SdFatConfig.h on the emulated card (sdbench)
+#   o every combination of USE_SEPARATE_FAT_CACHE, USE_MULTI_BLOCK_SD_IO, USE_SD_CRC and the spi divisors
+#   o bytes/s of card time and the longest write (line or flush) of the logger's append a line workload
+#   o flash and SRAM of the library on the logger (sdsize.cpp), only if avr-g++ is installed
+#
+# Usage:
+#   sdmatrix.sh [options]
+#    -m <mode>   - block (block writer) or file (normal file, default)
+#    -b <baud>   - baudrate of the channel (38400)
+#    -t <s>      - logging time in seconds (600)
+#    -p <n>      - written blocks with a 200 ms stall per mille (1)
+#    -i <image>  - disk image (../../test/image.dd.gz)
+#    -n <file>   - NMEA file (../../test/20130629_135830.nmea.gz)
+#    -d <list>   - spi divisors ("2 4 8", the logger uses 4)
+#
+# Background:
+#   o USE_SD_CRC is only the crc time in the emulator (see Sd2Card.h), the card itself is never wrong
+#   o USE_MULTI_BLOCK_SD_IO is only used for reads and writes of 1024 bytes and more at once
+#   o the flash and SRAM are of the whole program, the differences between the rows are the cost of the options
+#
+cd `dirname $0`
+
+MODE=file
+BAUD=38400
+TIME=600
+STALLS=1
+IMAGE=../../test/image.dd.gz
+NMEA=../../test/20130629_135830.nmea.gz
+DIVISORS="2 4 8"
+SDFAT=../../SketchBook/libraries/SdFat
+AVR=../../SketchBook/hardware/OSMLogger/avr
+
+while getopts "m:b:t:p:i:n:d:" opt; do
+  case $opt in
+    m) MODE=$OPTARG ;;
+    b) BAUD=$OPTARG ;;
+    t) TIME=$OPTARG ;;
+    p) STALLS=$OPTARG ;;
+    i) IMAGE=$OPTARG ;;
+    n) NMEA=$OPTARG ;;
+    d) DIVISORS=$OPTARG ;;
+    *) sed -n '2,20p' $0; exit 1 ;;
+  esac
+done
+
+BUILD=`mktemp -d`
+trap "rm -rf $BUILD" EXIT
+
+# the image is unpacked only once
+if [ "${IMAGE%.gz}" != "$IMAGE" ] ; then
+  gzip -dc $IMAGE > $BUILD/image.dd || exit 1
+  IMAGE=$BUILD/image.dd
+fi
+
+# avr build of sdsize.cpp, prints "flash sram"
+function avrsize {
+  if ! which avr-g++ > /dev/null ; then
+    echo "- -"
+    return
+  fi
+  local flags="-Os -w -mmcu=atmega328p -DF_CPU=16000000L -DARDUINO=105 -ffunction-sections -fdata-sections $1"
+  local dir=$BUILD/avr$2
+  mkdir -p $dir
+  for src in $AVR/cores/oseam/*.c ; do
+    avr-gcc -c $flags -I$AVR/cores/oseam -I$AVR/variants/oseam $src -o $dir/`basename $src`.o
+  done
+  for src in $AVR/cores/oseam/*.cpp $SDFAT/*.cpp sdsize.cpp ; do
+    avr-g++ -c $flags -fno-exceptions -I$AVR/cores/oseam -I$AVR/variants/oseam -I$SDFAT $src -o $dir/`basename $src`.o
+  done
+  avr-gcc -Os -mmcu=atmega328p -Wl,--gc-sections -o $dir/sdsize.elf $dir/*.o -lm
+  avr-size $dir/sdsize.elf | awk 'NR == 2 {print $1 + $2, $2 + $3}'
+}
+
+echo "$MODE, $BAUD baud, $TIME s, $STALLS stalls per mille"
+printf "%-10s %-10s %-6s %-8s %10s %10s %8s %6s\n" fatcache multiblock crc divisor bytes/s "max. ms" flash sram
+for fatcache in 0 1 ; do
+  for multiblock in 0 1 ; do
+    for crc in 0 1 2 ; do
+      flags="-DUSE_SEPARATE_FAT_CACHE=$fatcache -DUSE_MULTI_BLOCK_SD_IO=$multiblock -DUSE_SD_CRC=$crc"
+      bench=$BUILD/sdbench$fatcache$multiblock$crc
+      g++ -O2 -DARDUINO=105 $flags -I. -I$SDFAT -o $bench sdbench.cpp Sd2Card.cpp \
+        $SDFAT/{SdFat,SdVolume,SdBaseFile,SdBaseFilePrint,SdFile,SdFatErrorPrint}.cpp || exit 1
+      size=`avrsize "$flags" $fatcache$multiblock$crc`
+      for divisor in $DIVISORS ; do
+        # every run on the same empty card
+        cp $IMAGE $BUILD/work.dd
+        $bench -m $MODE -b $BAUD -t $TIME -p $STALLS -d $divisor $BUILD/work.dd $NMEA > $BUILD/result.txt
+        if [ $? -ne 0 ] ; then
+          echo "sdbench failed: $flags -d $divisor"
+          cat $BUILD/result.txt
+          exit 1
+        fi
+        throughput=`awk '/^throughput:/ {print $2}' $BUILD/result.txt`
+        maxtime=`awk '/max. line/ {line = $9; flush = $13; print (line > flush) ? line : flush}' $BUILD/result.txt`
+        printf "%-10s %-10s %-6s %-8s %10s %10s %8s %6s\n" $fatcache $multiblock $crc $divisor $throughput $maxtime $size
+      done
+    done
+  done
+done
@@ -0,0 +1,19 @@
+/*
+ sdsize.cpp - the append a line workload of the logger for the avr, only to measure flash and SRAM of the
+ SdFat options (sdmatrix.sh). Built with the core of the logger (SketchBook/hardware/OSMLogger/avr).
+ */
+#include <SdFat.h>
+
+SdFat sd;
+SdFile dataFile;
+
+void setup() {
+  if (sd.begin(SD_CHIP_SELECT_PIN, SPI_HALF_SPEED) && dataFile.open("data0000.dat", O_RDWR | O_CREAT | O_AT_END)) {
+    dataFile.write("00:00:00.000;A;$GPRMC\r\n", 23);
+    dataFile.sync();
+    dataFile.close();
+  }
+}
+
+void loop() {
+}
@@ -0,0 +1,362 @@
+/*
+ attitudetest.cpp - test of the fixed point attitude filter of the logger against a double reference
+ Copyright (c) 2014 Wilfried Klaas.  All right reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ attitudeUpdate() of osmfunctions.h gets the samples of a MPU6050 (2g, 250 degree/s, with the noise of the low
+ pass the logger sets for the rate and a gyro bias) on a boat in a sea state: roll, pitch and heave are sine waves, the acc is gravity plus the heave
+ acceleration in the tilted sensor. The same filter in double (atan2, sin, sqrt of the libm, no rounding)
+ gets the same samples. The difference of the POSMATT values (1/10 degree, cm) of both is the error of the
+ fixed point math, it has to be below MAX_ANGLE_ERROR and MAX_HEAVE_ERROR. The difference to the true
+ motion is printed too, that's the error of the filter itself.
+ For every motion rate of the logger (4..100) the cycles of attitudeUpdate() on the avr are estimated:
+ the basic blocks (blockcount.h) plus the calls of the 32 bit library functions of avr-gcc,
+ which are no blocks of their own (AVR_*_CYCLES, counted from the code of attitudeUpdate()).
+
+ build: g++ -Os -fsanitize-coverage=trace-pc -o attitudetest attitudetest.cpp
+ usage: attitudetest [-s seed] [-t seconds]
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "blockcount.h"
+#include "../../SketchBook/OpenSeaMap/osmfunctions.h"
+
+// max. difference to the double filter: 1/10 degree, cm
+#define MAX_ANGLE_ERROR 2
+#define MAX_HEAVE_ERROR 5
+// the start isn't compared, leak times of the heave integrators
+#define START_LEAK_TIMES 10
+
+// the 32 bit library calls of one attitudeUpdate() and their cycles on the avr (libgcc, with MUL)
+#define AVR_MULSI3 20
+#define AVR_MULSI3_CYCLES 24
+#define AVR_DIVMODSI4 7
+#define AVR_DIVMODSI4_CYCLES 650
+// variable 32 bit shifts (shift, leak) are a loop of about 6 cycles per bit
+#define AVR_SHIFT_CYCLES 6
+
+#define ACC_SCALE 16384.0
+#define GYRO_SCALE 131.0
+#define GRAVITY 9.807
+// noise density of the MPU6050: g / sqrt(Hz), degree/s / sqrt(Hz)
+#define ACC_NOISE 400e-6
+#define GYRO_NOISE 0.005
+
+uint32_t randomState = 1;
+
+uint32_t nextRandom() {
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+  return randomState;
+}
+
+// normal distributed noise (Box-Muller)
+double noise(double sigma) {
+  double u = (nextRandom() + 1.0) / 4294967297.0;
+  double v = (nextRandom() + 1.0) / 4294967297.0;
+  return sigma * sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+double degrees(double radians) {
+  return radians * 180 / M_PI;
+}
+
+double radians(double degrees) {
+  return degrees * M_PI / 180;
+}
+
+double wrap(double angle) {
+  while (angle > 180) {
+    angle -= 360;
+  }
+  while (angle < -180) {
+    angle += 360;
+  }
+  return angle;
+}
+
+/**
+ * the motion of the boat: roll and pitch (degree) around a mounting offset, heave (m).
+ **/
+struct SeaState {
+  const char* name;
+  double rollOffset;
+  double rollAmplitude;
+  double rollPeriod;
+  double pitchOffset;
+  double pitchAmplitude;
+  double pitchPeriod;
+  double heaveAmplitude;
+  double heavePeriod;
+};
+
+struct Motion {
+  double roll;
+  double pitch;
+  double heave;
+  double rollRate;
+  double pitchRate;
+  double heaveAcceleration;
+};
+
+Motion motionAt(const SeaState& sea, double time) {
+  Motion motion;
+  double wr = 2 * M_PI / sea.rollPeriod;
+  double wp = 2 * M_PI / sea.pitchPeriod;
+  double wh = 2 * M_PI / sea.heavePeriod;
+  motion.roll = wrap(sea.rollOffset + sea.rollAmplitude * sin(wr * time));
+  motion.rollRate = sea.rollAmplitude * wr * cos(wr * time);
+  motion.pitch = sea.pitchOffset + sea.pitchAmplitude * sin(wp * time);
+  motion.pitchRate = sea.pitchAmplitude * wp * cos(wp * time);
+  motion.heave = sea.heaveAmplitude * sin(wh * time);
+  motion.heaveAcceleration = -sea.heaveAmplitude * wh * wh * sin(wh * time);
+  return motion;
+}
+
+void putValue(uint8_t* sample, uint8_t axis, double value) {
+  long raw = lround(value);
+  int16_t clipped = raw > 32767 ? 32767 : (raw < -32768 ? -32768 : raw);
+  sample[axis * 2] = (uint16_t) clipped >> 8;
+  sample[axis * 2 + 1] = clipped & 0xFF;
+}
+
+/**
+ * the sensor: the bandwidth of the low pass (the DLPF of initGyro() in the sketch) and the gyro bias.
+ **/
+struct Sensor {
+  double accNoise;
+  double gyroNoise;
+  double gyroBias;
+};
+
+Sensor sensorFor(uint8_t rate) {
+  double bandwidth = 5;
+  if (rate >= 84) {
+    bandwidth = 42;
+  } else if (rate >= 40) {
+    bandwidth = 20;
+  } else if (rate >= 20) {
+    bandwidth = 10;
+  }
+  Sensor sensor;
+  sensor.accNoise = ACC_NOISE * sqrt(bandwidth) * ACC_SCALE;
+  sensor.gyroNoise = GYRO_NOISE * sqrt(bandwidth) * GYRO_SCALE;
+  sensor.gyroBias = noise(0.5);
+  return sensor;
+}
+
+/**
+ * the FIFO sample of the MPU6050: the specific force (gravity and heave, up in the sensor) and the rates.
+ **/
+void makeSample(uint8_t* sample, const Motion& motion, const Sensor& sensor) {
+  double force = (GRAVITY + motion.heaveAcceleration) / GRAVITY * ACC_SCALE;
+  double roll = radians(motion.roll);
+  double pitch = radians(motion.pitch);
+  putValue(sample, 0, -force * sin(pitch) + noise(sensor.accNoise));
+  putValue(sample, 1, force * sin(roll) * cos(pitch) + noise(sensor.accNoise));
+  putValue(sample, 2, force * cos(roll) * cos(pitch) + noise(sensor.accNoise));
+  putValue(sample, 3, (motion.rollRate + sensor.gyroBias) * GYRO_SCALE + noise(sensor.gyroNoise));
+  putValue(sample, 4, (motion.pitchRate - sensor.gyroBias) * GYRO_SCALE + noise(sensor.gyroNoise));
+  putValue(sample, 5, noise(sensor.gyroNoise));
+}
+
+/**
+ * the filter of attitudeUpdate() in double: degree, g, m/s, m.
+ **/
+struct Reference {
+  double roll;
+  double pitch;
+  double gravity;
+  double velocity;
+  double heave;
+  double rate;
+  double correction;
+  double leak;
+  bool started;
+};
+
+void referenceStart(Reference* reference, uint8_t rate) {
+  memset(reference, 0, sizeof(Reference));
+  reference->rate = rate;
+  reference->correction = 1.0 / (1 << log2floor(rate));
+  reference->leak = 1.0 / (1 << log2floor(32 * rate));
+}
+
+void referenceUpdate(Reference* reference, const uint8_t* sample) {
+  double acc[3];
+  for (uint8_t i = 0; i < 3; i++) {
+    acc[i] = motionValue(sample, i) / ACC_SCALE;
+  }
+  double accRoll = degrees(atan2(acc[1], acc[2]));
+  double accPitch = degrees(atan2(-acc[0], sqrt(acc[1] * acc[1] + acc[2] * acc[2])));
+  if (!reference->started) {
+    reference->roll = accRoll;
+    reference->pitch = accPitch;
+    reference->gravity = 1;
+    reference->started = true;
+    return;
+  }
+  reference->roll += motionValue(sample, 3) / GYRO_SCALE / reference->rate;
+  reference->pitch += motionValue(sample, 4) / GYRO_SCALE / reference->rate;
+  reference->roll = wrap(reference->roll + wrap(accRoll - reference->roll) * reference->correction);
+  reference->pitch += (accPitch - reference->pitch) * reference->correction;
+
+  double roll = radians(reference->roll);
+  double pitch = radians(reference->pitch);
+  double up = -acc[0] * sin(pitch) + acc[1] * sin(roll) * cos(pitch) + acc[2] * cos(roll) * cos(pitch);
+  reference->gravity += (up - reference->gravity) * reference->leak;
+  double vertical = up - reference->gravity;
+  reference->velocity += vertical * GRAVITY / reference->rate;
+  reference->velocity -= reference->velocity * reference->leak;
+  reference->heave += reference->velocity / reference->rate;
+  reference->heave -= reference->heave * reference->leak;
+}
+
+/**
+ * max. and rms of a difference.
+ **/
+struct Error {
+  double max;
+  double sum;
+  unsigned long count;
+};
+
+void addError(Error* error, double difference) {
+  difference = fabs(difference);
+  if (difference > error->max) {
+    error->max = difference;
+  }
+  error->sum += difference * difference;
+  error->count++;
+}
+
+double rms(const Error& error) {
+  return error.count ? sqrt(error.sum / error.count) : 0;
+}
+
+unsigned long failures = 0;
+
+/**
+ * one sea state with one motion rate. The start isn't compared: the heave needs some leak times (20..32 s)
+ * to forget the start values, the fixed point one a little bit longer (the mean of its vertical acc has
+ * a bias of about 0.001 g from the sine approximation, which the gravity mean has to learn first).
+ **/
+void runSeaState(const SeaState& sea, uint8_t rate, double seconds) {
+  Attitude attitude;
+  Reference reference;
+  attitudeStart(&attitude, rate);
+  referenceStart(&reference, rate);
+  Sensor sensor = sensorFor(rate);
+  Error roll = { 0 }, pitch = { 0 }, heave = { 0 };
+  Error trueRoll = { 0 }, truePitch = { 0 }, trueHeave = { 0 };
+  unsigned long samples = seconds * rate;
+  unsigned long settled = START_LEAK_TIMES << attitude.leak;
+  for (unsigned long i = 0; i < samples; i++) {
+    Motion motion = motionAt(sea, (double) i / rate);
+    uint8_t sample[MOTION_SAMPLE_SIZE];
+    makeSample(sample, motion, sensor);
+    attitudeUpdate(&attitude, sample);
+    referenceUpdate(&reference, sample);
+    if (i < settled) {
+      continue;
+    }
+    addError(&roll, wrap(attitudeRoll(&attitude) / 10.0 - reference.roll) * 10);
+    addError(&pitch, attitudePitch(&attitude) - reference.pitch * 10);
+    addError(&heave, attitudeHeave(&attitude) - reference.heave * 100);
+    addError(&trueRoll, wrap(reference.roll - motion.roll) * 10);
+    addError(&truePitch, (reference.pitch - motion.pitch) * 10);
+    addError(&trueHeave, (reference.heave - motion.heave) * 100);
+  }
+  bool ok = (roll.max <= MAX_ANGLE_ERROR) && (pitch.max <= MAX_ANGLE_ERROR) && (heave.max <= MAX_HEAVE_ERROR);
+  printf("  %-8s %3u/s: fixed - double max (rms) roll %.1f (%.2f), pitch %.1f (%.2f), heave %.1f (%.2f);"
+         " double - true rms %.1f, %.1f, %.1f%s\n", sea.name, rate, roll.max, rms(roll), pitch.max, rms(pitch),
+         heave.max, rms(heave), rms(trueRoll), rms(truePitch), rms(trueHeave), ok ? "" : " FAILED");
+  failures += !ok;
+}
+
+/**
+ * cycles of one attitudeUpdate() on the avr, estimated.
+ **/
+void measureCycles(uint8_t rate) {
+  const SeaState sea = { "cycles", 5, 20, 7, 0, 5, 5, 1.5, 9 };
+  Attitude attitude;
+  attitudeStart(&attitude, rate);
+  Sensor sensor = sensorFor(rate);
+  unsigned long samples = 60UL * rate;
+  unsigned long blocks = 0;
+  for (unsigned long i = 0; i < samples; i++) {
+    uint8_t sample[MOTION_SAMPLE_SIZE];
+    makeSample(sample, motionAt(sea, (double) i / rate), sensor);
+    countedBlocks = 0;
+    countBlocks = true;
+    attitudeUpdate(&attitude, sample);
+    countBlocks = false;
+    blocks += countedBlocks;
+  }
+  double blockCycles = (double) blocks * BLOCK_CYCLES / samples;
+  double libraryCycles = AVR_MULSI3 * AVR_MULSI3_CYCLES + AVR_DIVMODSI4 * AVR_DIVMODSI4_CYCLES
+      + (2 * attitude.shift + 3 * attitude.leak) * AVR_SHIFT_CYCLES;
+  double cycles = blockCycles + libraryCycles;
+  printf("  %3u/s: %4.0f cycles blocks + %4.0f library = %4.0f cycles (%3.0f us), %.1f %% cpu\n", rate, blockCycles,
+         libraryCycles, cycles, cycles / 16, 100.0 * cycles * rate / 16e6);
+}
+
+int main(int argc, char* argv[]) {
+  double seconds = 900;
+  int opt;
+  while ((opt = getopt(argc, argv, "s:t:")) != -1) {
+    switch (opt) {
+      case 's':
+        randomState = strtoul(optarg, NULL, 0) | 1;
+        break;
+      case 't':
+        seconds = atof(optarg);
+        break;
+      default:
+        fprintf(stderr, "usage: attitudetest [-s seed] [-t seconds]\n");
+        return 1;
+    }
+  }
+  if (seconds <= 10 * 32 + 60) {
+    fprintf(stderr, "at least 380 s\n");
+    return 1;
+  }
+  // name, roll offset, amplitude, period, pitch offset, amplitude, period, heave amplitude, period
+  const SeaState seaStates[] = {
+    { "harbour", 0, 1, 5, 0, 0.5, 4, 0.05, 4 },
+    { "tilted", 12, 3, 6, -8, 2, 5, 0.3, 6 },
+    { "moderate", 0, 15, 6, 2, 5, 4, 1, 8 },
+    { "heavy", 0, 40, 9, 0, 12, 7, 3, 11 },
+    { "upside", 175, 10, 6, 0, 5, 5, 0.5, 7 },
+  };
+  const uint8_t rates[] = { 4, 10, 25, 50, 100 };
+  printf("sea states (%.0f s):\n", seconds);
+  for (size_t n = 0; n < sizeof(seaStates) / sizeof(seaStates[0]); n++) {
+    for (size_t i = 0; i < sizeof(rates); i++) {
+      runSeaState(seaStates[n], rates[i], seconds);
+    }
+  }
+  printf("cycles of attitudeUpdate() on the avr:\n");
+  for (size_t i = 0; i < sizeof(rates); i++) {
+    measureCycles(rates[i]);
+  }
+  printf("attitude: %s\n", failures ? "FAILED" : "ok");
+  return failures ? 2 : 0;
+}
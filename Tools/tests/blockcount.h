@@ -0,0 +1,16 @@
+/**
+ * counting the executed basic blocks of the code compiled with -fsanitize-coverage=trace-pc, as an estimate
+ * of the avr cycles like in the logger simulation (osmsim/sim.h): every block costs BLOCK_CYCLES cycles.
+ * The blocks are only counted while countBlocks is set. Both are volatile, the compiler doesn't know,
+ * that the callback reads and writes them.
+ **/
+#define BLOCK_CYCLES 6
+
+volatile bool countBlocks = false;
+volatile unsigned long countedBlocks = 0;
+
+extern "C" __attribute__((no_sanitize_coverage)) void __sanitizer_cov_trace_pc(void) {
+  if (countBlocks) {
+    countedBlocks++;
+  }
+}
@@ -0,0 +1,250 @@
+/*
+ nmeachecktest.cpp - cycles of the streaming NMEA check of the logger against the checks at the line end
+ Copyright (c) 2014 Wilfried Klaas.  All right reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ Every line of the test data (up to the line buffer of the logger) and a copy with one changed byte are checked
+ by three versions, the cycles on the avr are estimated by the basic blocks (blockcount.h):
+ o old: checkNMEAData() of the sketch before the streaming check, strlen() in every step of the loop
+ o end: checkNMEAData() of osmfunctions.h, one pass over the line at the line feed
+ o stream: nmeaCheckByte() for every received byte, nmeaCheckResult() at the line feed
+ The verdicts of end and stream have to be the same for every line (old has the wrong values of the hex
+ digits A-F, its differences are only counted). The work at the line feed, when the line goes to the card,
+ has to be less with the streaming check than with both others.
+
+ build: g++ -Os -fsanitize-coverage=trace-pc -o nmeachecktest nmeachecktest.cpp
+ usage: nmeachecktest [nmea file]
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "blockcount.h"
+#include "../../SketchBook/OpenSeaMap/osmfunctions.h"
+
+// the line buffer of the logger (MAX_NMEA_BUFFER), longer lines are not used
+#define LINE_BUFFER 80
+
+/**
+ * strlen() of the avr libc, a call in every step of the old loop (the compiler doesn't know, that it's pure).
+ **/
+__attribute__((noipa)) size_t avrStrlen(const char* data) {
+  const char* end = data;
+  while (*end) {
+    end++;
+  }
+  return end - data;
+}
+
+/**
+ * checkNMEAData() of the sketch before the streaming check.
+ **/
+__attribute__((noipa)) bool oldCheckNMEAData(uint8_t* myBuffer) {
+  char* data = (char*) myBuffer;
+  if (avrStrlen(data) == 0) {
+    return false;
+  }
+  if (data[0] != '$') {
+    return false;
+  }
+  bool inCrc = false;
+  uint8_t crc = 0;
+  uint8_t fileCrc = 0;
+  uint8_t index = 0;
+  for (uint8_t i = 1; i < avrStrlen(data); i++) {
+    char value = data[i];
+    if ((value < 0x20) || (value > 0x80)) {
+      return false;
+    }
+    if (inCrc) {
+      if (index < 2) {
+        if (value >= '0' && value <= '9') {
+          fileCrc = value - '0';
+        }
+        if (value >= 'A' && value <= 'F') {
+          fileCrc = value - 'A';
+        }
+        if (index == 0) {
+          fileCrc = fileCrc << 4;
+        }
+        index++;
+      }
+    } else {
+      if (value != '*') {
+        crc ^= value;
+      } else {
+        inCrc = true;
+      }
+    }
+  }
+
+  if (fileCrc != crc) {
+    return false;
+  }
+  return true;
+}
+
+__attribute__((noipa)) bool endCheck(const uint8_t* data, uint16_t length) {
+  return checkNMEAData(data, length);
+}
+
+__attribute__((noipa)) void streamByte(NMEACheck* check, uint8_t value) {
+  nmeaCheckByte(check, value);
+}
+
+__attribute__((noipa)) bool streamResult(const NMEACheck* check) {
+  return nmeaCheckResult(check);
+}
+
+struct Cycles {
+  unsigned long lines;
+  unsigned long long total;
+  unsigned long max;
+};
+
+void addCycles(Cycles* cycles, unsigned long blocks) {
+  unsigned long value = blocks * BLOCK_CYCLES;
+  cycles->lines++;
+  cycles->total += value;
+  if (value > cycles->max) {
+    cycles->max = value;
+  }
+}
+
+void printCycles(const char* name, const Cycles* cycles) {
+  printf("%-26s %8.1f %8lu\n", name, (double) cycles->total / cycles->lines, cycles->max);
+}
+
+/**
+ * reading the lines of the NMEA file (time: line), like osmsim.
+ **/
+bool readLines(const char* path, std::vector<std::string>* lines) {
+  std::string command = std::string("gzip -dcf '") + path + "'";
+  FILE* file = popen(command.c_str(), "r");
+  if (!file) {
+    return false;
+  }
+  char line[1024];
+  while (fgets(line, sizeof(line), file)) {
+    line[strcspn(line, "\r\n")] = 0;
+    char* text = strstr(line, ": ");
+    text = text ? text + 2 : line;
+    size_t length = strlen(text);
+    if ((length > 0) && (length <= LINE_BUFFER)) {
+      lines->push_back(text);
+    }
+  }
+  return (pclose(file) == 0) && !lines->empty();
+}
+
+int main(int argc, char* argv[]) {
+  const char* path = argc > 1 ? argv[1] : "../test/20130629_135830.nmea.gz";
+  std::vector<std::string> lines;
+  if (!readLines(path, &lines)) {
+    fprintf(stderr, "can't read %s\n", path);
+    return 1;
+  }
+
+  Cycles oldCycles = { 0, 0, 0 };
+  Cycles endCycles = { 0, 0, 0 };
+  Cycles streamLine = { 0, 0, 0 };
+  Cycles streamByteCycles = { 0, 0, 0 };
+  Cycles streamEnd = { 0, 0, 0 };
+  unsigned long checked = 0;
+  unsigned long valid = 0;
+  unsigned long differences = 0;
+  unsigned long oldDifferences = 0;
+  for (size_t i = 0; i < lines.size(); i++) {
+    for (int changed = 0; changed < 2; changed++) {
+      uint8_t buffer[LINE_BUFFER + 1];
+      uint16_t length = lines[i].size();
+      memcpy(buffer, lines[i].data(), length);
+      buffer[length] = 0;
+      if (changed) {
+        // one bit of a byte somewhere in the line, the checksum too
+        buffer[(i * 7) % length] ^= 1 << (i % 7);
+      }
+
+      countedBlocks = 0;
+      countBlocks = true;
+      bool oldOk = oldCheckNMEAData(buffer);
+      countBlocks = false;
+      addCycles(&oldCycles, countedBlocks);
+
+      countedBlocks = 0;
+      countBlocks = true;
+      bool endOk = endCheck(buffer, length);
+      countBlocks = false;
+      addCycles(&endCycles, countedBlocks);
+
+      NMEACheck check;
+      nmeaCheckStart(&check);
+      unsigned long lineBlocks = 0;
+      for (uint16_t j = 0; j < length; j++) {
+        countedBlocks = 0;
+        countBlocks = true;
+        streamByte(&check, buffer[j]);
+        countBlocks = false;
+        addCycles(&streamByteCycles, countedBlocks);
+        lineBlocks += countedBlocks;
+      }
+      countedBlocks = 0;
+      countBlocks = true;
+      bool streamOk = streamResult(&check);
+      countBlocks = false;
+      addCycles(&streamEnd, countedBlocks);
+      addCycles(&streamLine, lineBlocks + countedBlocks);
+
+      checked++;
+      if (endOk) {
+        valid++;
+      }
+      if (streamOk != endOk) {
+        differences++;
+        if (differences <= 5) {
+          printf("different verdict (end %d, stream %d): %s\n", endOk, streamOk, (char*) buffer);
+        }
+      }
+      if (oldOk != endOk) {
+        oldDifferences++;
+      }
+    }
+  }
+
+  double averageLength = 0;
+  for (size_t i = 0; i < lines.size(); i++) {
+    averageLength += lines[i].size();
+  }
+  averageLength /= lines.size();
+  printf("%lu lines (%lu valid), %.1f bytes per line\n", checked, valid, averageLength);
+  printf("cycles                      average      max\n");
+  printCycles("old, at the line feed", &oldCycles);
+  printCycles("end, at the line feed", &endCycles);
+  printCycles("stream, per byte", &streamByteCycles);
+  printCycles("stream, at the line feed", &streamEnd);
+  printCycles("stream, per line", &streamLine);
+  bool verdictOk = differences == 0;
+  bool cyclesOk = (streamEnd.max < endCycles.total / endCycles.lines) &&
+                  (streamEnd.max < oldCycles.total / oldCycles.lines);
+  printf("verdicts of end and stream: %lu different, %s (old: %lu different)\n", differences,
+         verdictOk ? "ok" : "FAILED", oldDifferences);
+  printf("work at the line feed: %s\n", cyclesOk ? "ok" : "FAILED");
+  bool ok = verdictOk && cyclesOk;
+  printf("nmeacheck: %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 2;
+}
@@ -0,0 +1,282 @@
+/*
+ nmeascantest.cpp - differential test and benchmark of the vectorized NMEA check and line end search
+ Copyright (c) 2014 Wilfried Klaas.  All right reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ The SSE2 and AVX2 versions of osmconvert (osmconvert/nmeascan.h) are compared with checkNMEAData() and
+ the streaming check nmeaCheckByte() of the logger (osmfunctions.h):
+ o every length from 0 to 300, around the 16 and 32 byte steps of the vector loops and the tail
+ o valid sentences and sentences with one fault: a control character, a character above 0x7F, 0x7F,
+   an additional *, a wrong or lower case checksum, a missing $, a character after the checksum
+ o random bytes from the characters of a sentence
+ Every sentence is in its own buffer of exactly its length, so a build with -fsanitize=address finds
+ reads behind the sentence. The line end search is compared with memchr on random buffers.
+ Then the time of every version for one sentence of the test data size (about 70 characters) is measured.
+
+ build: g++ -O2 -o nmeascantest nmeascantest.cpp
+ usage: nmeascantest [-s seed] [-n random sentences]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "../../SketchBook/OpenSeaMap/osmfunctions.h"
+#include "../osmconvert/nmeascan.h"
+
+#define MAX_LENGTH 300
+
+uint32_t randomState = 1;
+
+uint32_t nextRandom() {
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+  return randomState;
+}
+
+struct Scanner {
+  const char* name;
+  NMEACheckFunction check;
+  LineEndFunction lineEnd;
+};
+
+std::vector<Scanner> scanners;
+
+/**
+ * the streaming check of the logger as a check function.
+ **/
+bool checkNMEAStreaming(const uint8_t* data, uint16_t length) {
+  NMEACheck check;
+  nmeaCheckStart(&check);
+  for (uint16_t i = 0; i < length; i++) {
+    nmeaCheckByte(&check, data[i]);
+  }
+  return nmeaCheckResult(&check);
+}
+
+/**
+ * * and the xor of everything after the first character as 2 hex digits.
+ **/
+std::string checksum(const std::string& text) {
+  uint8_t crc = 0;
+  for (size_t i = 1; i < text.size(); i++) {
+    crc ^= text[i];
+  }
+  char digits[4];
+  sprintf(digits, "*%02X", crc);
+  return digits;
+}
+
+/**
+ * a valid sentence of the length (at least 4): $, printable characters without *, * and the checksum.
+ **/
+std::string validSentence(uint16_t length) {
+  std::string sentence = "$";
+  while (sentence.size() < (size_t) length - 3) {
+    char value = 0x20 + nextRandom() % 0x5F;
+    sentence += value == '*' ? ',' : value;
+  }
+  return sentence + checksum(sentence);
+}
+
+unsigned long checks = 0;
+unsigned long valid = 0;
+unsigned long failures = 0;
+
+/**
+ * checking the sentence with every version, the result of checkNMEAData() is the reference.
+ **/
+void check(const std::string& sentence) {
+  // an own buffer of the exact length, memcpy(0) of an empty string is fine
+  uint8_t* data = (uint8_t*) malloc(sentence.size() ? sentence.size() : 1);
+  memcpy(data, sentence.data(), sentence.size());
+  bool expected = checkNMEAData(data, sentence.size());
+  bool ok = checkNMEAStreaming(data, sentence.size()) == expected;
+  for (size_t i = 0; i < scanners.size(); i++) {
+    ok &= scanners[i].check(data, sentence.size()) == expected;
+  }
+  free(data);
+  checks++;
+  valid += expected;
+  if (!ok) {
+    if (failures < 10) {
+      printf("  length %u (%s): %s\n", (unsigned) sentence.size(), expected ? "ok" : "wrong", sentence.c_str());
+    }
+    failures++;
+  }
+}
+
+/**
+ * the valid sentence and the sentence with one fault at every position. The faults between $ and * are
+ * checked with the right checksum too, so only the character can make the sentence wrong.
+ **/
+void checkFaults(uint16_t length) {
+  std::string sentence = validSentence(length);
+  check(sentence);
+  const char faults[] = { 0x00, 0x0A, 0x0D, 0x1F, 0x7F, (char) 0x80, (char) 0xFF, '*', '$', 'a' };
+  for (size_t position = 0; position < sentence.size(); position++) {
+    for (size_t i = 0; i < sizeof(faults); i++) {
+      std::string faulty = sentence;
+      faulty[position] = faults[i];
+      check(faulty);
+      if (position < sentence.size() - 3) {
+        std::string body = faulty.substr(0, sentence.size() - 3);
+        check(body + checksum(body));
+      }
+    }
+    std::string changed = sentence;
+    changed[position] ^= 1 << (nextRandom() % 7);
+    check(changed);
+  }
+  std::string lowerCase = sentence;
+  for (size_t i = sentence.size() - 2; i < sentence.size(); i++) {
+    lowerCase[i] = tolower(lowerCase[i]);
+  }
+  check(lowerCase);
+  check(sentence + "0");
+  check(sentence.substr(0, sentence.size() - 1));
+}
+
+/**
+ * a random sentence: valid, valid with a random character or random characters of a sentence.
+ **/
+std::string randomSentence() {
+  const char characters[] = "$*,.0123456789ABCDEFGPRMCa\r\x7F\x80";
+  uint16_t length = nextRandom() % MAX_LENGTH;
+  std::string sentence;
+  uint32_t kind = nextRandom() % 4;
+  if (kind > 0) {
+    sentence = validSentence(length < 4 ? 4 : length);
+    if (kind > 1) {
+      sentence[nextRandom() % sentence.size()] = characters[nextRandom() % (sizeof(characters) - 1)];
+    }
+    return sentence;
+  }
+  for (uint16_t i = 0; i < length; i++) {
+    sentence += characters[nextRandom() % (sizeof(characters) - 1)];
+  }
+  return sentence;
+}
+
+/**
+ * the line end search of every version against memchr, at every offset of a random buffer.
+ **/
+void checkLineEnds() {
+  for (int n = 0; n < 2000; n++) {
+    size_t size = nextRandom() % 200;
+    char* buffer = (char*) malloc(size ? size : 1);
+    uint32_t newLines = nextRandom() % 4;
+    for (size_t i = 0; i < size; i++) {
+      buffer[i] = (nextRandom() % 64) < newLines ? '\n' : 'A' + nextRandom() % 26;
+    }
+    for (size_t start = 0; start <= size; start++) {
+      const char* expected = findLineEndScalar(buffer + start, buffer + size);
+      for (size_t i = 0; i < scanners.size(); i++) {
+        checks++;
+        if (scanners[i].lineEnd(buffer + start, buffer + size) != expected) {
+          if (failures < 10) {
+            printf("  %s: wrong line end in %u bytes from %u\n", scanners[i].name, (unsigned) size, (unsigned) start);
+          }
+          failures++;
+        }
+      }
+    }
+    free(buffer);
+  }
+}
+
+double seconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+int main(int argc, char* argv[]) {
+  unsigned long count = 1000000;
+  int opt;
+  while ((opt = getopt(argc, argv, "s:n:")) != -1) {
+    switch (opt) {
+      case 's':
+        randomState = strtoul(optarg, NULL, 0) | 1;
+        break;
+      case 'n':
+        count = strtoul(optarg, NULL, 0);
+        break;
+      default:
+        fprintf(stderr, "usage: nmeascantest [-s seed] [-n random sentences]\n");
+        return 1;
+    }
+  }
+  Scanner scalar = { "scalar", checkNMEAData, findLineEndScalar };
+  scanners.push_back(scalar);
+#ifdef NMEASCAN_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse2")) {
+    Scanner sse2 = { "sse2", checkNMEADataSSE2, findLineEndSSE2 };
+    scanners.push_back(sse2);
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    Scanner avx2 = { "avx2", checkNMEADataAVX2, findLineEndAVX2 };
+    scanners.push_back(avx2);
+  }
+#endif
+  printf("versions:");
+  for (size_t i = 0; i < scanners.size(); i++) {
+    printf(" %s", scanners[i].name);
+  }
+  printf("\n");
+
+  printf("every length with faults\n");
+  for (int i = 0; i < 4; i++) {
+    check(std::string("$*00").substr(0, i));
+  }
+  for (uint16_t length = 4; length <= MAX_LENGTH; length++) {
+    checkFaults(length);
+  }
+  printf("random sentences\n");
+  for (unsigned long i = 0; i < count; i++) {
+    check(randomSentence());
+  }
+  printf("line ends\n");
+  checkLineEnds();
+  printf("%lu checks (%lu valid sentences), %lu wrong\n", checks, valid, failures);
+
+  // sentences like the test data: 60 to 82 characters, one buffer for all
+  std::vector<std::string> sentences;
+  size_t total = 0;
+  for (int i = 0; i < 1000; i++) {
+    sentences.push_back(validSentence(60 + nextRandom() % 23));
+    total += sentences.back().size();
+  }
+  printf("benchmark (%lu sentences of %.1f characters):\n", count, (double) total / sentences.size());
+  for (size_t n = 0; n < scanners.size(); n++) {
+    unsigned long ok = 0;
+    double start = seconds();
+    for (unsigned long i = 0; i < count; i++) {
+      const std::string& sentence = sentences[i % sentences.size()];
+      ok += scanners[n].check((const uint8_t*) sentence.data(), sentence.size());
+    }
+    double time = seconds() - start;
+    printf("  %-6s %5.1f ns, %6.0f MB/s%s\n", scanners[n].name, time * 1e9 / count,
+           count * (double) total / sentences.size() / time / 1e6, ok == count ? "" : " (wrong)");
+  }
+  printf("nmeascan: %s\n", failures ? "FAILED" : "ok");
+  return failures ? 2 : 0;
+}
@@ -0,0 +1,410 @@
+/*
+ seatalktest.cpp - fuzz test and bus load benchmark of the seatalk mode of the serial core
+ Copyright (c) 2014 Wilfried Klaas.  All right reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ The receive interrupt and readDatagram() of the logger's core (cores/oseam/HardwareSerial.cpp) are compiled
+ into this program, the registers of the USART are variables. A random SeaTalk bus goes byte by byte through
+ the interrupt, with the faults of a real bus:
+ o collisions: a datagram breaks off and the next command byte follows
+ o lost bytes and bytes with a parity error (the interrupt drops them)
+ o data bytes without a command byte, a wrong length in the attribute byte
+ The datagrams read are compared with a simple framer of the bytes the interrupt gets. With a reader after
+ every byte they have to be the same, datagram by datagram with the receive time of the command byte.
+ With a slow reader the missing ones have to be counted as datagram errors (full receive ring).
+ Then the bus runs at full load (datagrams back to back, 4800 baud, 11 bits per byte) with one readDatagram()
+ every n ms like the loop of the logger: datagrams per second, losses and the cycles of the interrupt and
+ readDatagram() (basic blocks, see blockcount.h).
+
+ build: g++ -Os -fsanitize-coverage=trace-pc -o seatalktest seatalktest.cpp
+ usage: seatalktest [-s seed] [-n datagrams] [-r ring size]
+ The ring size is the share of channel A of the receive arena (143 bytes with NMEA at 4800 baud on channel B).
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "blockcount.h"
+
+// the parts of Arduino.h, wiring_private.h and Stream.h the serial core needs, their own headers are skipped
+#define Arduino_h
+#define WiringPrivate_h
+#define Stream_h
+
+typedef uint8_t byte;
+#define RAMEND 0x8FF
+#define F_CPU 16000000UL
+#define _BV(bit) (1 << (bit))
+#define bit_is_clear(sfr, bit) (!((sfr) & _BV(bit)))
+#define sbi(sfr, bit) ((sfr) |= _BV(bit))
+#define cbi(sfr, bit) ((sfr) &= ~_BV(bit))
+#define lowByte(w) ((uint8_t) ((w) & 0xff))
+
+volatile uint8_t SREG;
+#define cli() (SREG &= ~0x80)
+#define ISR(vector) extern "C" void vector(void)
+
+unsigned long hostMillis = 0;
+unsigned long millis() {
+  return hostMillis;
+}
+
+// USART0 of the ATmega328P
+volatile uint8_t usart[6];
+#define UBRR0H usart[0]
+#define UBRR0L usart[1]
+#define UCSR0A usart[2]
+#define UCSR0B usart[3]
+#define UCSR0C usart[4]
+#define UDR0 usart[5]
+#define RXCIE0 7
+#define TXC0 6
+#define UDRIE0 5
+#define RXEN0 4
+#define TXEN0 3
+#define UPE0 2
+#define U2X0 1
+#define TXB80 0
+#define USART_RX_vect usartReceive
+#define USART_UDRE_vect usartDataEmpty
+
+class Print {
+ public:
+  size_t write(const char* str) {
+    return 0;
+  }
+  size_t write(const uint8_t* buffer, size_t size) {
+    return 0;
+  }
+};
+
+class Stream : public Print {
+};
+
+#include "../../SketchBook/hardware/OSMLogger/avr/cores/oseam/HardwareSerial.cpp"
+
+// 4800 baud, start bit, 8 data bits, 9th bit, stop bit
+#define BYTE_US (11 * 1000000.0 / 4800)
+
+struct WireByte {
+  uint8_t value;
+  bool command;
+  bool parityError;
+};
+
+struct Datagram {
+  std::vector<uint8_t> data;
+  unsigned long time;
+};
+
+uint32_t randomState = 1;
+
+uint32_t nextRandom() {
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+  return randomState;
+}
+
+bool chance(uint32_t perMille) {
+  return (nextRandom() % 1000) < perMille;
+}
+
+/**
+ * a random datagram: command byte, attribute byte (low nibble: 3 + n bytes), n + 1 data bytes.
+ **/
+std::vector<uint8_t> randomDatagram() {
+  std::vector<uint8_t> data;
+  data.push_back(nextRandom());
+  uint8_t attribute = nextRandom();
+  data.push_back(attribute);
+  for (uint8_t i = 0; i < (attribute & 0x0F) + 1; i++) {
+    data.push_back(nextRandom());
+  }
+  return data;
+}
+
+/**
+ * the bytes of the bus. With faults the bus has collisions, lost bytes, parity errors, bytes without a
+ * command byte and wrong lengths.
+ **/
+std::vector<WireByte> makeBus(unsigned long count, bool faults) {
+  std::vector<WireByte> bus;
+  for (unsigned long n = 0; n < count; n++) {
+    std::vector<uint8_t> data = randomDatagram();
+    if (faults && chance(20)) {
+      data[1] ^= 1 + nextRandom() % 15;
+    }
+    size_t length = data.size();
+    if (faults && chance(50)) {
+      length = 1 + nextRandom() % (length - 1);
+    }
+    size_t lost = (faults && chance(20)) ? nextRandom() % length : length;
+    size_t parity = (faults && chance(20)) ? nextRandom() % length : length;
+    for (size_t i = 0; i < length; i++) {
+      if (i != lost) {
+        WireByte wire = { data[i], i == 0, i == parity };
+        bus.push_back(wire);
+      }
+    }
+    if (faults && chance(20)) {
+      for (uint32_t i = nextRandom() % 3; i < 3; i++) {
+        WireByte wire = { (uint8_t) nextRandom(), false, false };
+        bus.push_back(wire);
+      }
+    }
+  }
+  return bus;
+}
+
+/**
+ * the reference: framing of the bytes, which the interrupt gets (without parity errors).
+ * Returns the count of started, but not completed datagrams.
+ **/
+unsigned long frame(const std::vector<WireByte>& bus, std::vector<Datagram>* datagrams) {
+  unsigned long errors = 0;
+  Datagram actual;
+  size_t length = 0;
+  for (size_t i = 0; i < bus.size(); i++) {
+    if (bus[i].parityError) {
+      continue;
+    }
+    if (bus[i].command) {
+      if (!actual.data.empty()) {
+        errors++;
+      }
+      actual.data.clear();
+      actual.time = (unsigned long) (i * BYTE_US / 1000);
+    } else if (actual.data.empty()) {
+      continue;
+    }
+    actual.data.push_back(bus[i].value);
+    if (actual.data.size() == 2) {
+      length = 3 + (bus[i].value & 0x0F);
+    }
+    if ((actual.data.size() >= 2) && (actual.data.size() == length)) {
+      datagrams->push_back(actual);
+      actual.data.clear();
+    }
+  }
+  return errors;
+}
+
+/**
+ * one byte of the bus through the receive interrupt.
+ **/
+void receive(const WireByte& wire) {
+  UCSR0A = wire.parityError ? _BV(UPE0) : 0;
+  UCSR0B = (UCSR0B & ~0x02) | (wire.command ? 0x02 : 0);
+  UDR0 = wire.value;
+  usartReceive();
+}
+
+void startSeaTalk(uint8_t* ring, uint8_t ringSize) {
+  Serial.end();
+  Serial.setRxBuffer(ring, ringSize, false);
+  Serial.beginSeaTalk();
+}
+
+/**
+ * reading one datagram, false if there is none.
+ **/
+bool readOne(Datagram* datagram) {
+  uint8_t data[SEATALK_MAX_DATAGRAM];
+  uint8_t length = Serial.readDatagram(data, sizeof(data));
+  if (length == 0) {
+    return false;
+  }
+  datagram->data.assign(data, data + length);
+  datagram->time = Serial.lineTime();
+  return true;
+}
+
+unsigned long failures = 0;
+
+void fail(const char* text, unsigned long value) {
+  if (failures < 10) {
+    printf("  %s %lu\n", text, value);
+  }
+  failures++;
+}
+
+/**
+ * the reader gets every datagram after its last byte, all have to be like the reference.
+ **/
+void testFastReader(const std::vector<WireByte>& bus, uint8_t* ring, uint8_t ringSize) {
+  std::vector<Datagram> expected;
+  unsigned long expectedErrors = frame(bus, &expected);
+  startSeaTalk(ring, ringSize);
+  size_t next = 0;
+  for (size_t i = 0; i < bus.size(); i++) {
+    hostMillis = (unsigned long) (i * BYTE_US / 1000);
+    receive(bus[i]);
+    Datagram datagram;
+    while (readOne(&datagram)) {
+      if (next >= expected.size()) {
+        fail("datagram too much at byte", i);
+      } else if (datagram.data != expected[next].data) {
+        fail("wrong datagram at byte", i);
+      } else if (datagram.time != expected[next].time) {
+        fail("wrong line time at byte", i);
+      }
+      next++;
+    }
+  }
+  if (next != expected.size()) {
+    fail("datagrams missing:", expected.size() - next);
+  }
+  if (Serial.datagramErrors() != (uint16_t) expectedErrors) {
+    fail("wrong datagram errors:", Serial.datagramErrors());
+  }
+  if (Serial.overflowCount() != 0) {
+    fail("overflows:", Serial.overflowCount());
+  }
+  printf("fast reader: %lu bytes, %lu datagrams, %lu errors of the bus\n", (unsigned long) bus.size(),
+         (unsigned long) expected.size(), expectedErrors);
+}
+
+/**
+ * the reader is slow, the ring runs over. The datagrams read have to be in the reference in the same order,
+ * every missing one has to be counted as datagram error.
+ **/
+void testSlowReader(const std::vector<WireByte>& bus, uint8_t* ring, uint8_t ringSize) {
+  std::vector<Datagram> expected;
+  unsigned long expectedErrors = frame(bus, &expected);
+  startSeaTalk(ring, ringSize);
+  size_t next = 0;
+  unsigned long read = 0;
+  size_t readAt = 0;
+  for (size_t i = 0; i < bus.size(); i++) {
+    receive(bus[i]);
+    if (i < readAt) {
+      continue;
+    }
+    readAt = i + nextRandom() % 200;
+    Datagram datagram;
+    for (uint32_t n = nextRandom() % 4; n > 0 && readOne(&datagram); n--) {
+      while ((next < expected.size()) && (expected[next].data != datagram.data)) {
+        next++;
+      }
+      if (next == expected.size()) {
+        fail("datagram not in the reference at byte", i);
+        break;
+      }
+      next++;
+      read++;
+    }
+  }
+  Datagram datagram;
+  while (readOne(&datagram)) {
+    read++;
+  }
+  // the datagram errors are 16 bit, they only have to be right modulo 65536
+  unsigned long lost = expected.size() - read;
+  if ((uint16_t) (Serial.datagramErrors() - expectedErrors) != (uint16_t) lost) {
+    fail("datagrams not counted:", (uint16_t) (lost - (Serial.datagramErrors() - expectedErrors)));
+  }
+  printf("slow reader: %lu datagrams, %lu read, %lu lost in the full ring\n", (unsigned long) expected.size(), read,
+         lost);
+}
+
+/**
+ * full bus load, one readDatagram() every interval like the loop of the logger.
+ **/
+void benchmark(const std::vector<WireByte>& bus, unsigned long count, uint8_t* ring, uint8_t ringSize,
+               unsigned long intervalMs) {
+  startSeaTalk(ring, ringSize);
+  unsigned long read = 0;
+  unsigned long isrBlocks = 0;
+  unsigned long readBlocks = 0;
+  double nextRead = 0;
+  for (size_t i = 0; i < bus.size(); i++) {
+    double time = i * BYTE_US / 1000;
+    hostMillis = (unsigned long) time;
+    countedBlocks = 0;
+    countBlocks = true;
+    receive(bus[i]);
+    countBlocks = false;
+    isrBlocks += countedBlocks;
+    if (time >= nextRead) {
+      uint8_t data[SEATALK_MAX_DATAGRAM];
+      countedBlocks = 0;
+      countBlocks = true;
+      uint8_t length = Serial.readDatagram(data, sizeof(data));
+      countBlocks = false;
+      if (length > 0) {
+        readBlocks += countedBlocks;
+        read++;
+      }
+      nextRead += intervalMs;
+    }
+  }
+  uint8_t data[SEATALK_MAX_DATAGRAM];
+  unsigned long left = 0;
+  while (Serial.readDatagram(data, sizeof(data)) > 0) {
+    left++;
+  }
+  double seconds = bus.size() * BYTE_US / 1e6;
+  double isrCycles = (double) isrBlocks * BLOCK_CYCLES / bus.size();
+  printf("  %4lu ms: %5.1f datagrams/s read, %5.1f %% lost, interrupt %.0f cycles/byte (%.2f %% cpu), "
+         "readDatagram %.0f cycles\n", intervalMs, read / seconds, 100.0 * (count - read - left) / count, isrCycles,
+         100.0 * isrCycles * bus.size() / seconds / F_CPU, read ? (double) readBlocks * BLOCK_CYCLES / read : 0.0);
+}
+
+int main(int argc, char* argv[]) {
+  unsigned long count = 100000;
+  unsigned int ringSize = 143;
+  int opt;
+  while ((opt = getopt(argc, argv, "s:n:r:")) != -1) {
+    switch (opt) {
+      case 's':
+        randomState = strtoul(optarg, NULL, 0) | 1;
+        break;
+      case 'n':
+        count = strtoul(optarg, NULL, 0);
+        break;
+      case 'r':
+        ringSize = atoi(optarg);
+        break;
+      default:
+        fprintf(stderr, "usage: seatalktest [-s seed] [-n datagrams] [-r ring size]\n");
+        return 1;
+    }
+  }
+  if ((ringSize <= SEATALK_MAX_DATAGRAM) || (ringSize > 255)) {
+    fprintf(stderr, "ring size %u not possible\n", ringSize);
+    return 1;
+  }
+  static uint8_t ring[255];
+
+  std::vector<WireByte> bus = makeBus(count, true);
+  testFastReader(bus, ring, ringSize);
+  testSlowReader(bus, ring, ringSize);
+
+  std::vector<WireByte> fullLoad = makeBus(count, false);
+  printf("full bus load (%.0f bytes/s, %.1f datagrams/s), ring %u bytes, one readDatagram() every\n",
+         1e6 / BYTE_US, count * 1e6 / BYTE_US / fullLoad.size(), ringSize);
+  const unsigned long intervals[] = { 1, 10, 50, 100, 200, 400 };
+  for (size_t i = 0; i < sizeof(intervals) / sizeof(intervals[0]); i++) {
+    benchmark(fullLoad, count, ring, ringSize, intervals[i]);
+  }
+  printf("seatalk: %s\n", failures ? "FAILED" : "ok");
+  return failures ? 2 : 0;
+}
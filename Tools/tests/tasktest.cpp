@@ -0,0 +1,151 @@
+/*
+ tasktest.cpp - test of the task scheduler of the logger with a simulated clock
+ Copyright (c) 2014 Wilfried Klaas.  All right reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ runTasks() of osmfunctions.h runs the task table of the logger (serial, gyro, second, file, statistic) for
+ one simulated hour. Every task costs µs of the simulated clock, the file task flushes every minute (120 ms),
+ once the card stalls for 2.5 s in the serial task. Checked are:
+ o the runs of the periodic tasks (lost to the stall only) and their misses (one per task, the stall)
+ o no pass runs more than one background task
+ o the gap between two runs of the second task (the phase is kept, period + deadline at most)
+ o the max. runtime of the flush above 65 ms (it was saturated at 65535 µs)
+ o the 16 bit time of the last run over the overrun of millis() (49.7 days)
+
+ build: g++ -O2 -o tasktest tasktest.cpp
+ usage: tasktest
+ */
+#include <stdio.h>
+
+#include "../../SketchBook/OpenSeaMap/osmfunctions.h"
+
+// costs of the tasks in µs
+#define SERIAL_US 150
+#define GYRO_US 40
+#define SECOND_US 900
+#define FILE_US 200
+#define FLUSH_US 120000
+#define STATISTIC_US 3000
+#define STALL_US 2500000
+// the stall in the serial task, seconds after the start
+#define STALL_AT 1800
+#define HOUR_US 3600000000ULL
+
+uint64_t clockUs;
+uint32_t passes;
+uint32_t backgroundPass;
+uint32_t backgroundTwice;
+uint32_t secondRuns;
+uint32_t fileRuns;
+uint32_t statisticRuns;
+uint64_t lastSecond;
+uint64_t maxSecondGap;
+bool stalled;
+// the clock of the test starts so, that millis() runs over in the hour
+uint64_t clockStart;
+
+unsigned long testMicros() {
+  return (unsigned long) (uint32_t) clockUs;
+}
+
+unsigned long testMillis() {
+  return (unsigned long) (uint32_t) (clockUs / 1000);
+}
+
+void background() {
+  if (backgroundPass == passes) {
+    backgroundTwice++;
+  }
+  backgroundPass = passes;
+}
+
+void taskSerial(unsigned long now) {
+  clockUs += SERIAL_US;
+  if (!stalled && (clockUs - clockStart >= STALL_AT * 1000000ULL)) {
+    stalled = true;
+    clockUs += STALL_US;
+  }
+}
+
+void taskGyro(unsigned long now) {
+  clockUs += GYRO_US;
+}
+
+void taskSecond(unsigned long now) {
+  if (secondRuns > 0) {
+    uint64_t gap = clockUs - lastSecond;
+    // the gap of the stall isn't counted
+    if ((gap > maxSecondGap) && (gap < STALL_US)) {
+      maxSecondGap = gap;
+    }
+  }
+  lastSecond = clockUs;
+  secondRuns++;
+  clockUs += SECOND_US;
+}
+
+void taskFile(unsigned long now) {
+  background();
+  fileRuns++;
+  clockUs += (fileRuns % 60) ? FILE_US : FLUSH_US;
+}
+
+void taskStatistic(unsigned long now) {
+  background();
+  statisticRuns++;
+  clockUs += STATISTIC_US;
+}
+
+int main(int argc, char* argv[]) {
+  Task tasks[] = {
+    // the table of the logger (OpenSeaMap.ino)
+    { taskSerial, 0, 0, 0 },
+    { taskGyro, 0, 0, 0 },
+    { taskSecond, 1000, 100, 0 },
+    { taskFile, 1000, 1000, TASK_BACKGROUND },
+    { taskStatistic, 60000U, 1000, TASK_BACKGROUND }
+  };
+  const uint8_t count = sizeof(tasks) / sizeof(tasks[0]);
+  // 30 minutes before the overrun of millis()
+  clockStart = clockUs = (0x100000000ULL - 1800000ULL) * 1000ULL;
+  taskStart(tasks, count, testMillis());
+  while (clockUs - clockStart < HOUR_US) {
+    passes++;
+    runTasks(tasks, count, testMillis(), testMicros);
+    // the rest of the loop
+    clockUs += 10;
+  }
+
+  // the first runs are 1 s and 60 s after the start. The runs of 1800, 1801 and 1802 s are replaced by one at
+  // 1802.5 s with a miss, the phase starts new from there, so the last run moves behind the end of the hour.
+  // The statistic of 1800 s is late too.
+  bool runsOk = (secondRuns == 3597) && (fileRuns == 3597) && (statisticRuns == 59);
+  bool missesOk = (tasks[2].misses == 1) && (tasks[3].misses == 1) && (tasks[4].misses == 1);
+  bool gapOk = maxSecondGap <= 1100000ULL;
+  bool runtimeOk = (tasks[3].maxRuntime >= FLUSH_US) && (tasks[0].maxRuntime >= STALL_US);
+  printf("%lu passes in the hour (%.0f passes/s), %lu with two background tasks\n", (unsigned long) passes,
+         passes / 3600.0, (unsigned long) backgroundTwice);
+  printf("runs: second %lu, file %lu, statistic %lu, %s\n", (unsigned long) secondRuns, (unsigned long) fileRuns,
+         (unsigned long) statisticRuns, runsOk ? "ok" : "FAILED");
+  printf("misses: second %u, file %u, statistic %u, %s\n", tasks[2].misses, tasks[3].misses, tasks[4].misses,
+         missesOk ? "ok" : "FAILED");
+  printf("max. gap of the second task %.1f ms, %s\n", maxSecondGap / 1e3, gapOk ? "ok" : "FAILED");
+  printf("max. runtime: serial %lu us, file %lu us, %s\n", (unsigned long) tasks[0].maxRuntime,
+         (unsigned long) tasks[3].maxRuntime, runtimeOk ? "ok" : "FAILED");
+  bool ok = runsOk && missesOk && gapOk && runtimeOk && (backgroundTwice == 0);
+  printf("tasks: %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 2;
+}
@@ -0,0 +1,235 @@
+/*
+ timestamptest.cpp - test and benchmark of the incremental timestamp of the logger
+ Copyright (c) 2014 Wilfried Klaas.  All right reserved.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ advanceTimeStamp() of osmfunctions.h is compared with the sprintf timestamp the logger wrote before
+ (hours, minutes, seconds, millis of the 32 bit millis() value, hours modulo 24):
+ o a walk over the whole millis() range with random steps, until after the overrun at 49.7 days
+ o every millisecond around the hour, the 16 bit seconds (18:12:16), 24 hour and millis() overrun boundaries,
+   forward and backward
+ o random times with random steps forward and backward, small and above the minute of the full calculation
+ Then the time of both for one timestamp is measured, with the steps of lines at 4800 baud on one channel and
+ on two channels (every second timestamp is a step back, the line started before the one written last).
+
+ build: g++ -O2 -o timestamptest timestamptest.cpp
+ usage: timestamptest [-s seed] [-n benchmark timestamps]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../../SketchBook/OpenSeaMap/osmfunctions.h"
+
+// the format of the sprintf timestamp (messages.h)
+#define TIMESTAMP "%02d:%02d:%02d.%03u;"
+
+// a little bit of random for the steps, independent of the libc
+uint32_t randomState = 1;
+
+uint32_t nextRandom() {
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+  return randomState;
+}
+
+/**
+ * the timestamp like the logger wrote it with sprintf (the 32 bit calculation of the avr).
+ **/
+void referenceTimeStamp(char* text, uint32_t time) {
+  uint16_t mil = time % 1000L;
+  int32_t div = time / 1000L;
+  uint8_t sec = div % 60L;
+  uint8_t minute = (div / 60L) % 60L;
+  uint8_t hour = (div / 3600L) % 24L;
+  sprintf(text, TIMESTAMP, hour, minute, sec, mil);
+}
+
+unsigned long checks = 0;
+unsigned long failures = 0;
+
+/**
+ * advancing the timestamp and comparing it with the reference.
+ **/
+void check(uint32_t time, uint32_t last) {
+  char expected[TIMESTAMP_LENGTH + 1];
+  referenceTimeStamp(expected, time);
+  advanceTimeStamp(time);
+  checks++;
+  if (strcmp(timeStampText, expected) != 0) {
+    if (failures < 10) {
+      printf("  %lu ms after %lu ms: %s, expected %s\n", (unsigned long) time, (unsigned long) last, timeStampText,
+             expected);
+    }
+    failures++;
+  }
+}
+
+/**
+ * checking every millisecond around the boundary, starting with a full calculation.
+ **/
+void checkBoundary(uint32_t boundary) {
+  uint32_t time = boundary - 2000;
+  setTimeStamp(time);
+  for (int i = 0; i < 4000; i++) {
+    check(time + 1, time);
+    time++;
+  }
+}
+
+/**
+ * checking every millisecond backwards around the boundary.
+ **/
+void checkBoundaryBack(uint32_t boundary) {
+  uint32_t time = boundary + 2000;
+  setTimeStamp(time);
+  for (int i = 0; i < 4000; i++) {
+    check(time - 1, time);
+    time--;
+  }
+}
+
+/**
+ * a random step: mostly the distance of lines, sometimes nothing, a long pause or a step back.
+ **/
+int32_t randomStep() {
+  uint32_t kind = nextRandom() % 100;
+  if (kind < 5) {
+    return 0;
+  }
+  if (kind < 85) {
+    return nextRandom() % 1000;
+  }
+  if (kind < 95) {
+    return nextRandom() % 65000;
+  }
+  if (kind < 97) {
+    return 59990 + nextRandom() % 20;
+  }
+  if (kind < 98) {
+    return -(int32_t) (59990 + nextRandom() % 20);
+  }
+  if (kind < 99) {
+    return -(int32_t) (nextRandom() % 1000);
+  }
+  return -(int32_t) (nextRandom() % 100000);
+}
+
+double seconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+char referenceText[TIMESTAMP_LENGTH + 1];
+
+const char* sprintfStamp(uint32_t time) {
+  referenceTimeStamp(referenceText, time);
+  return referenceText;
+}
+
+const char* advanceStamp(uint32_t time) {
+  advanceTimeStamp(time);
+  return timeStampText;
+}
+
+/**
+ * ns per timestamp: a 80 character line at 4800 baud every 167 ms (about 6 hours of data for the default count).
+ * With two channels the line of channel B started 60 ms before the line of channel A, which was written before.
+ **/
+double benchmark(const char* (*stamp)(uint32_t), bool twoChannels, unsigned long count, uint32_t* sum) {
+  setTimeStamp(0);
+  uint32_t time = 0;
+  double start = seconds();
+  for (unsigned long i = 0; i < count; i++) {
+    if (twoChannels && (i & 1)) {
+      *sum += stamp(time - 60)[7];
+    } else {
+      time += 167;
+      *sum += stamp(time)[7];
+    }
+  }
+  return (seconds() - start) * 1e9 / count;
+}
+
+int main(int argc, char* argv[]) {
+  unsigned long count = 10000000;
+  int opt;
+  while ((opt = getopt(argc, argv, "s:n:")) != -1) {
+    switch (opt) {
+      case 's':
+        randomState = strtoul(optarg, NULL, 0) | 1;
+        break;
+      case 'n':
+        count = strtoul(optarg, NULL, 0);
+        break;
+      default:
+        fprintf(stderr, "usage: timestamptest [-s seed] [-n benchmark timestamps]\n");
+        return 1;
+    }
+  }
+
+  // the whole millis() range, steps of 0 to 2 s
+  printf("walk over the millis() range\n");
+  uint64_t walk = 0;
+  setTimeStamp(0);
+  while (walk < 0x100000000ULL + 86400000ULL) {
+    uint32_t last = walk;
+    walk += nextRandom() % 2000;
+    check((uint32_t) walk, last);
+  }
+
+  printf("boundaries\n");
+  for (uint32_t hour = 1; hour <= 48; hour++) {
+    checkBoundary(hour * 3600000UL);
+    checkBoundaryBack(hour * 3600000UL);
+  }
+  checkBoundary(65536000UL);
+  checkBoundary(65536000UL + 86400000UL);
+  checkBoundary(0);
+  checkBoundaryBack(65536000UL);
+  checkBoundaryBack(65536000UL + 86400000UL);
+  checkBoundaryBack(0xFFFFFFFFUL - 2000);
+
+  printf("random steps\n");
+  uint32_t time = nextRandom();
+  setTimeStamp(time);
+  for (unsigned long i = 0; i < 1000000; i++) {
+    uint32_t last = time;
+    if ((nextRandom() % 1000) == 0) {
+      time = nextRandom();
+    } else {
+      time += randomStep();
+    }
+    check(time, last);
+  }
+  printf("%lu timestamps checked, %lu wrong\n", checks, failures);
+
+  uint32_t sum = 0;
+  double sprintfOne = benchmark(sprintfStamp, false, count, &sum);
+  double advanceOne = benchmark(advanceStamp, false, count, &sum);
+  double sprintfTwo = benchmark(sprintfStamp, true, count, &sum);
+  double advanceTwo = benchmark(advanceStamp, true, count, &sum);
+  printf("benchmark (%lu timestamps, checksum %lu):\n", count, (unsigned long) sum);
+  printf("  one channel: sprintf %.1f ns, advanceTimeStamp %.1f ns, %.1f times faster\n", sprintfOne, advanceOne,
+         advanceOne > 0 ? sprintfOne / advanceOne : 0.0);
+  printf("  two channels: sprintf %.1f ns, advanceTimeStamp %.1f ns, %.1f times faster\n", sprintfTwo, advanceTwo,
+         advanceTwo > 0 ? sprintfTwo / advanceTwo : 0.0);
+  printf("timestamp: %s\n", failures ? "FAILED" : "ok");
+  return failures ? 2 : 0;
+}
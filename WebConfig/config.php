@@ -12,11 +12,27 @@
  }
  $outputGyro = $_POST["outputGyro"];
  $outputVcc =  $_POST["outputVcc"];
- $output = $outputGyro + $outputVcc;
+ $outputBinary =  $_POST["outputBinary"];
+ $output = $outputGyro + $outputVcc + $outputBinary;
  $vesselid =  $_POST["vesselid"];
  $vesselid = sprintf("%'08x",$vesselid);
+ $flush = $_POST["flush"];
+ if (!$flush) {
+   $flush = "60";
+ }
+ $motion = $_POST["motion"];
+ if (!$motion) {
+   $motion = "0";
+ }
+ $attitude = $_POST["attitude"];
+ if (!$attitude) {
+   $attitude = "0";
+ }
  echo "$seatalk$baud_a\r\n";
  echo "$baud_b\r\n";
  echo "$output\r\n";
  echo "$vesselid\r\n";
+ echo "$flush\r\n";
+ echo "$motion\r\n";
+ echo "$attitude\r\n";
 ?>
@@ -86,7 +86,8 @@ unzip this archive to a empty sd card. Then start the MCS_OpenSeaMap_Logger.exe
 		<td valign="top">&nbsp;</td>
 		<td>
 		  <input type="checkbox" name="outputGyro" value="2" checked="checked"/>write Gyrodata * (1)<br>
-		  <input type="checkbox" name="outputVcc" value="1"/>write board supply (2)
+		  <input type="checkbox" name="outputVcc" value="1"/>write board supply (2)<br>
+		  <input type="checkbox" name="outputBinary" value="4"/>binary data file (3)
 		</td>
 		<td valign="top">(*) Default. Here you can de/activate special logger features.</td>
 	</tr>
@@ -98,6 +99,30 @@ unzip this archive to a empty sd card. Then start the MCS_OpenSeaMap_Logger.exe
 		</td>
 		<td valign="top">(optional) If your vessel is registered at the OpenSeaMap depth webbsite, you can enter here your vessel id.<br/> This will be stored into the logger.</td>
 	</tr>
+	<tr>
+		<td valign="top"><b>Flush interval</b></td>
+		<td valign="top">Seconds:</td>
+		<td>
+		  <input type="number" name="flush" value="60" min="1" max="250" onkeypress='return isNumberKey(event)'/>
+		</td>
+		<td valign="top">(*) Default 60. Every interval the logger writes all pending data to the sd card.<br/> Shorter intervals lose less data on a power failure.</td>
+	</tr>
+	<tr>
+		<td valign="top"><b>Motion rate</b></td>
+		<td valign="top">Samples/s:</td>
+		<td>
+		  <input type="number" name="motion" value="0" min="0" max="100" onkeypress='return isNumberKey(event)'/>
+		</td>
+		<td valign="top">(*) Default 0, gyro and acc once a second. 4..100 samples per second of gyro and acc for heave and roll correction (needs gyro output).<br/> Use it with the binary data file, the text messages are big.</td>
+	</tr>
+	<tr>
+		<td valign="top"><b>Attitude rate</b></td>
+		<td valign="top">Messages/s:</td>
+		<td>
+		  <input type="number" name="attitude" value="0" min="0" max="100" onkeypress='return isNumberKey(event)'/>
+		</td>
+		<td valign="top">(*) Default 0, off. Roll, pitch and heave (POSMATT) are calculated by the logger from the motion samples, up to the motion rate.<br/> The motion samples are not written then.</td>
+	</tr>
 </table>
 	<br/>
 	<input type="submit" class="submit button" name="add" value="Create" />
@@ -106,6 +131,7 @@ unzip this archive to a empty sd card. Then start the MCS_OpenSeaMap_Logger.exe
 <br>
 (1) you can deactivate the writing of gyro data. This saves space on the sd card, but the data may be useless.<br>
 (2) you can activate the writing of special NMEA Messages for the board supply. Should be activated only in case of a support request.<br>
+(3) the logger writes a compact binary data file instead of text lines. This saves space on the sd card. The file must be converted with the osmdecode tool before uploading.<br>
 
 
 <div id="footer">